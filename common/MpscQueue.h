@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+namespace AxiomCommon {
+
+    // A fixed-capacity, lock-free queue that any number of threads can push to, and a single thread can pop from.
+    // Neither pushing nor popping allocates, so it's safe to use from the audio thread.
+    template<class Item, size_t Capacity>
+    class MpscQueue {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        MpscQueue() {
+            for (size_t i = 0; i < Capacity; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // pushes an item to the back of the queue, returning false if the queue is full
+        bool push(Item item) {
+            auto pos = enqueuePos.load(std::memory_order_relaxed);
+            while (true) {
+                auto &cell = cells[pos & (Capacity - 1)];
+                auto sequence = cell.sequence.load(std::memory_order_acquire);
+                auto diff = (intptr_t) sequence - (intptr_t) pos;
+
+                if (diff == 0) {
+                    // the cell is free, try to claim it
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.item = std::move(item);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    // the consumer hasn't popped this cell yet
+                    return false;
+                } else {
+                    // another producer claimed the cell first
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // pops an item from the front of the queue, if there is one. Must only be called from one thread at a time.
+        std::optional<Item> pop() {
+            auto &cell = cells[dequeuePos & (Capacity - 1)];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            if ((intptr_t) sequence - (intptr_t)(dequeuePos + 1) < 0) {
+                return std::nullopt;
+            }
+
+            auto item = std::move(cell.item);
+            cell.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+            dequeuePos++;
+            return item;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            Item item;
+        };
+
+        std::array<Cell, Capacity> cells;
+        std::atomic<size_t> enqueuePos = 0;
+        size_t dequeuePos = 0;
+    };
+}
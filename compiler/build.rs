@@ -0,0 +1,47 @@
+use std::collections::hash_map::DefaultHasher;
+use std::env;
+use std::fs;
+use std::hash::{Hash, Hasher};
+use std::path::{Path, PathBuf};
+
+// Files whose contents decide what code is generated, and how it's linked with the runtime. Objects
+// in the code cache are only loaded by builds with the same ID, so any change to these invalidates
+// them.
+const BUILD_ID_SOURCES: &[&str] = &["src", "llvmmaxim", "Cargo.toml", "Cargo.lock"];
+
+fn collect_files(path: &Path, files: &mut Vec<PathBuf>) {
+    if path.is_dir() {
+        if let Ok(entries) = fs::read_dir(path) {
+            for entry in entries.filter_map(|entry| entry.ok()) {
+                collect_files(&entry.path(), files);
+            }
+        }
+    } else if path.is_file() {
+        files.push(path.to_path_buf());
+    }
+}
+
+fn main() {
+    let mut files = Vec::new();
+    for source in BUILD_ID_SOURCES {
+        println!("cargo:rerun-if-changed={}", source);
+        collect_files(Path::new(source), &mut files);
+    }
+
+    // sorted so the ID doesn't depend on the order the file system lists directories in
+    files.sort();
+
+    let mut hasher = DefaultHasher::new();
+    for file in &files {
+        file.hash(&mut hasher);
+        fs::read(file).unwrap_or_default().hash(&mut hasher);
+    }
+
+    // a different LLVM or target generates different code from the same sources
+    for var in &["TARGET", "PROFILE", "LLVM_SYS_60_PREFIX"] {
+        println!("cargo:rerun-if-env-changed={}", var);
+        env::var(var).unwrap_or_default().hash(&mut hasher);
+    }
+
+    println!("cargo:rustc-env=MAXIM_BUILD_ID={:016x}", hasher.finish());
+}
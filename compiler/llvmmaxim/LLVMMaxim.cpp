@@ -1,8 +1,12 @@
 #include <llvm-c/Core.h>
 #include <llvm-c/OrcBindings.h>
 #include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassManagerBuilder.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
 #include "OrcJit.h"
 
@@ -19,7 +23,26 @@ extern "C" {
 int __umoddi3(int a, int b);
 
 LLVMTargetMachineRef LLVMAxiomSelectTarget() {
-    return wrap(llvm::EngineBuilder().selectTarget());
+    // Code is only ever run on the machine it's compiled on, so it can use every feature of the host CPU (such as
+    // AVX2 or AVX-512) instead of the baseline for the architecture.
+    std::vector<std::string> features;
+    llvm::StringMap<bool> hostFeatures;
+    if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+        for (const auto &feature : hostFeatures) {
+            features.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+        }
+    }
+
+    return wrap(llvm::EngineBuilder().setMCPU(llvm::sys::getHostCPUName()).setMAttrs(features).selectTarget());
+}
+
+// Optimizer utilities
+void LLVMAxiomPassManagerBuilderSetVectorize(LLVMPassManagerBuilderRef builder, bool loopVectorize,
+                                             bool slpVectorize) {
+    // these aren't exposed by the C API, and are off by default
+    auto passManagerBuilder = llvm::unwrap(builder);
+    passManagerBuilder->LoopVectorize = loopVectorize;
+    passManagerBuilder->SLPVectorize = slpVectorize;
 }
 
 // Builder utilities
@@ -70,9 +93,6 @@ OrcJit *LLVMAxiomOrcCreateInstance(LLVMTargetMachineRef targetMachine) {
     jit->addBuiltin("sincosf", (uint64_t) &SINCOSF);
     jit->addBuiltin("expf", (uint64_t) & ::expf);
     jit->addBuiltin("fmodf", (uint64_t) & ::fmodf);
-    jit->addBuiltin("rand", (uint64_t) & ::rand);
-    jit->addBuiltin("realloc", (uint64_t) & ::realloc);
-    jit->addBuiltin("free", (uint64_t) & ::free);
     jit->addBuiltin("memset", (uint64_t) & ::memset);
     jit->addBuiltin("__umoddi3", (uint64_t) & ::__umoddi3);
 
@@ -91,6 +111,11 @@ LLVMOrcModuleHandle LLVMAxiomOrcAddModule(OrcJit *jit, LLVMSharedModuleRef modul
     return jit->addModule(std::move(*unwrap(module)));
 }
 
+LLVMOrcModuleHandle LLVMAxiomOrcAddObjectFile(OrcJit *jit, const char *data, size_t size) {
+    // the caller keeps ownership of the data, the JIT needs a copy that lives as long as the object
+    return jit->addObject(llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(data, size)));
+}
+
 void LLVMAxiomOrcRemoveModule(OrcJit *jit, LLVMOrcModuleHandle handle) {
     jit->removeModule(handle);
 }
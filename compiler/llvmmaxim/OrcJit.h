@@ -5,10 +5,13 @@
 #include <llvm/ExecutionEngine/Orc/IRTransformLayer.h>
 #include <llvm/ExecutionEngine/Orc/LambdaResolver.h>
 #include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
-#include <llvm/ExecutionEngine/SectionMemoryManager.h>
 #include <llvm/IR/Mangler.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <unordered_map>
 
+#include "PooledMemoryManager.h"
+
 namespace llvm {
     class Module;
 }
@@ -21,7 +24,7 @@ private:
 public:
     explicit OrcJit(llvm::TargetMachine &targetMachine)
         : dataLayout(targetMachine.createDataLayout()),
-          objectLayer([]() { return std::make_shared<llvm::SectionMemoryManager>(); }),
+          objectLayer([this]() { return std::make_shared<PooledMemoryManager>(memoryPools); }),
           compileLayer(objectLayer, llvm::orc::SimpleCompiler(targetMachine)) {}
 
     using ModuleKey = unsigned;
@@ -36,20 +39,18 @@ public:
     void addBuiltin(llvm::StringRef name, llvm::JITTargetAddress address) { builtins.emplace(mangle(name), address); }
 
     ModuleKey addModule(std::shared_ptr<llvm::Module> module) {
-        auto resolver = llvm::orc::createLambdaResolver(
-            [&](const std::string &name) {
-                if (auto sym = compileLayer.findSymbol(name, false)) return sym;
-                return llvm::JITSymbol(nullptr);
-            },
-            [&](const std::string &name) {
-                auto builtinAddress = builtins.find(name);
-                if (builtinAddress != builtins.end()) {
-                    return llvm::JITSymbol(builtinAddress->second, llvm::JITSymbolFlags::Exported);
-                }
-                return llvm::JITSymbol(nullptr);
-            });
+        auto handle = llvm::cantFail(compileLayer.addModule(std::move(module), createResolver()));
+        return createKey(std::move(handle));
+    }
 
-        auto handle = llvm::cantFail(compileLayer.addModule(std::move(module), std::move(resolver)));
+    // Objects are linked into the same layer modules are compiled to, so their handles can be removed
+    // with removeModule and their symbols are visible to (and can see) every other module.
+    ModuleKey addObject(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+        auto object = llvm::cantFail(llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef()));
+        auto owningObject = std::make_shared<llvm::object::OwningBinary<llvm::object::ObjectFile>>(
+            std::move(object), std::move(buffer));
+
+        auto handle = llvm::cantFail(objectLayer.addObject(std::move(owningObject), createResolver()));
         return createKey(std::move(handle));
     }
 
@@ -67,6 +68,8 @@ public:
 
 private:
     llvm::DataLayout dataLayout;
+    // Declared before the object layer, so the pools outlive every object allocated from them.
+    MemoryPools memoryPools;
     ObjectLayer objectLayer;
     CompileLayer compileLayer;
     std::unordered_map<std::string, llvm::JITTargetAddress> builtins;
@@ -74,6 +77,21 @@ private:
     std::vector<CompileLayer::ModuleHandleT> genericHandles;
     std::vector<unsigned> freeHandleIndexes;
 
+    std::shared_ptr<llvm::JITSymbolResolver> createResolver() {
+        return llvm::orc::createLambdaResolver(
+            [this](const std::string &name) {
+                if (auto sym = compileLayer.findSymbol(name, false)) return sym;
+                return llvm::JITSymbol(nullptr);
+            },
+            [this](const std::string &name) {
+                auto builtinAddress = builtins.find(name);
+                if (builtinAddress != builtins.end()) {
+                    return llvm::JITSymbol(builtinAddress->second, llvm::JITSymbolFlags::Exported);
+                }
+                return llvm::JITSymbol(nullptr);
+            });
+    }
+
     unsigned createKey(CompileLayer::ModuleHandleT handle) {
         unsigned newHandle;
         if (!freeHandleIndexes.empty()) {
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <llvm/ExecutionEngine/RTDyldMemoryManager.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/Memory.h>
+#include <llvm/Support/Process.h>
+#include <map>
+#include <vector>
+
+#if defined(AXIOM_JIT_HUGE_PAGES) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// A set of large mappings that sections of JIT'd objects are allocated from, so code and data from different objects
+// ends up packed together instead of each object getting its own pages. Ranges freed when an object is removed are
+// coalesced and reused by later objects.
+class MemoryPool {
+public:
+    struct Range {
+        uint8_t *base;
+        size_t size;
+    };
+
+    // Memory is mapped with `flags` and changed to `finalFlags` once an object has been loaded into it. Ranges are
+    // allocated in multiples of the granularity, which must be a power of two. Pools that change protection need to
+    // use the page size, since protection can only be changed for whole pages.
+    MemoryPool(unsigned flags, unsigned finalFlags, size_t granularity, bool useHugePages)
+        : flags(flags), finalFlags(finalFlags), granularity(granularity), useHugePages(useHugePages) {}
+
+    MemoryPool(const MemoryPool &) = delete;
+
+    MemoryPool &operator=(const MemoryPool &) = delete;
+
+    ~MemoryPool() {
+        for (auto &slab : slabs) {
+            llvm::sys::Memory::releaseMappedMemory(slab);
+        }
+    }
+
+    unsigned getFlags() const { return flags; }
+
+    unsigned getFinalFlags() const { return finalFlags; }
+
+    bool changesProtection() const { return flags != finalFlags; }
+
+    Range allocate(size_t size) {
+        size = llvm::alignTo(size, granularity);
+
+        // the lowest free range is used, to keep allocations packed towards the start of the pool
+        for (auto freeRange = freeRanges.begin(); freeRange != freeRanges.end(); ++freeRange) {
+            if (freeRange->second < size) continue;
+
+            auto base = freeRange->first;
+            auto remainingSize = freeRange->second - size;
+            freeRanges.erase(freeRange);
+            if (remainingSize > 0) {
+                freeRanges.emplace(base + size, remainingSize);
+            }
+            return {base, size};
+        }
+
+        auto slab = allocateSlab(size);
+        auto base = (uint8_t *) slab.base();
+        if (slab.size() > size) {
+            release({base + size, slab.size() - size});
+        }
+        return {base, size};
+    }
+
+    void release(Range range) {
+        auto inserted = freeRanges.emplace(range.base, range.size).first;
+
+        // merge with the ranges either side, if they're adjacent
+        auto next = std::next(inserted);
+        if (next != freeRanges.end() && inserted->first + inserted->second == next->first) {
+            inserted->second += next->second;
+            freeRanges.erase(next);
+        }
+        if (inserted != freeRanges.begin()) {
+            auto previous = std::prev(inserted);
+            if (previous->first + previous->second == inserted->first) {
+                previous->second += inserted->second;
+                freeRanges.erase(inserted);
+            }
+        }
+    }
+
+private:
+    static constexpr size_t SLAB_SIZE = 16 * 1024 * 1024;
+
+    unsigned flags;
+    unsigned finalFlags;
+    size_t granularity;
+    bool useHugePages;
+    std::vector<llvm::sys::MemoryBlock> slabs;
+    std::map<uint8_t *, size_t> freeRanges;
+
+    llvm::sys::MemoryBlock allocateSlab(size_t minSize) {
+        std::error_code ec;
+
+        // new slabs are placed near the last one if possible, so the pool stays compact
+        auto nearBlock = slabs.empty() ? nullptr : &slabs.back();
+        auto slab = llvm::sys::Memory::allocateMappedMemory(std::max(minSize, SLAB_SIZE), nearBlock, flags, ec);
+        if (ec) {
+            llvm::report_fatal_error("Failed to allocate JIT memory: " + ec.message());
+        }
+
+#if defined(AXIOM_JIT_HUGE_PAGES) && defined(__linux__)
+        if (useHugePages) {
+            ::madvise(slab.base(), slab.size(), MADV_HUGEPAGE);
+        }
+#else
+        (void) useHugePages;
+#endif
+
+        slabs.push_back(slab);
+        return slab;
+    }
+};
+
+struct MemoryPools {
+    MemoryPool code;
+    MemoryPool readOnlyData;
+    MemoryPool readWriteData;
+
+    MemoryPools()
+#ifdef AXIOM_JIT_HUGE_PAGES
+        // Code is never reprotected, so objects can share pages and the pool can be backed by huge pages. This gives
+        // up keeping code unwritable in exchange for fewer iTLB misses.
+        : code(RWX, RWX, 64, true),
+#else
+        : code(RW, RX, llvm::sys::Process::getPageSize(), false),
+#endif
+          readOnlyData(RW, R, llvm::sys::Process::getPageSize(), false),
+          // writable data is never reprotected, so objects only need to be kept on separate cache lines
+          readWriteData(RW, RW, 64, false) {
+    }
+
+private:
+    static constexpr unsigned R = llvm::sys::Memory::MF_READ;
+    static constexpr unsigned RW = llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_WRITE;
+    static constexpr unsigned RX = llvm::sys::Memory::MF_READ | llvm::sys::Memory::MF_EXEC;
+    static constexpr unsigned RWX = RW | llvm::sys::Memory::MF_EXEC;
+};
+
+// The memory manager for a single object in the object layer. The total size of each kind of section is known before
+// any are allocated, so each kind gets one range from its pool and sections are placed in it one after another.
+class PooledMemoryManager : public llvm::RTDyldMemoryManager {
+public:
+    explicit PooledMemoryManager(MemoryPools &pools)
+        : code(pools.code), readOnlyData(pools.readOnlyData), readWriteData(pools.readWriteData) {}
+
+    ~PooledMemoryManager() override {
+        code.release();
+        readOnlyData.release();
+        readWriteData.release();
+    }
+
+    bool needsToReserveAllocationSpace() override { return true; }
+
+    void reserveAllocationSpace(uintptr_t codeSize, uint32_t codeAlign, uintptr_t readOnlyDataSize,
+                                uint32_t readOnlyDataAlign, uintptr_t readWriteDataSize,
+                                uint32_t readWriteDataAlign) override {
+        code.reserve(codeSize, codeAlign);
+        readOnlyData.reserve(readOnlyDataSize, readOnlyDataAlign);
+        readWriteData.reserve(readWriteDataSize, readWriteDataAlign);
+    }
+
+    uint8_t *allocateCodeSection(uintptr_t size, unsigned alignment, unsigned, llvm::StringRef) override {
+        return code.allocate(size, alignment);
+    }
+
+    uint8_t *allocateDataSection(uintptr_t size, unsigned alignment, unsigned, llvm::StringRef,
+                                 bool isReadOnly) override {
+        return isReadOnly ? readOnlyData.allocate(size, alignment) : readWriteData.allocate(size, alignment);
+    }
+
+    bool finalizeMemory(std::string *errMsg) override {
+        if (!code.finalize(errMsg) || !readOnlyData.finalize(errMsg) || !readWriteData.finalize(errMsg)) {
+            return true;
+        }
+
+        for (const auto &range : code.ranges) {
+            llvm::sys::Memory::InvalidateInstructionCache(range.base, range.size);
+        }
+        return false;
+    }
+
+private:
+    // The ranges one kind of section has been allocated in. A new range is only needed if a section is allocated
+    // that wasn't included in the reserved space, such as the GOT on ELF.
+    struct Sections {
+        MemoryPool &pool;
+        std::vector<MemoryPool::Range> ranges;
+        uint8_t *next = nullptr;
+        uint8_t *end = nullptr;
+
+        explicit Sections(MemoryPool &pool) : pool(pool) {}
+
+        void reserve(uintptr_t size, uint32_t alignment) {
+            if (size == 0) return;
+
+            // ranges are only aligned to the pool's granularity, so leave room to align the first section
+            auto range = pool.allocate(size + std::max<uint32_t>(alignment, 1) - 1);
+            ranges.push_back(range);
+            next = range.base;
+            end = range.base + range.size;
+        }
+
+        uint8_t *allocate(uintptr_t size, unsigned alignment) {
+            if (!alignment) alignment = 16;
+
+            if (!next || (uint8_t *) llvm::alignAddr(next, alignment) + size > end) {
+                reserve(std::max<uintptr_t>(size, 1), alignment);
+            }
+            auto base = (uint8_t *) llvm::alignAddr(next, alignment);
+            next = base + size;
+            return base;
+        }
+
+        bool finalize(std::string *errMsg) {
+            if (!pool.changesProtection()) return true;
+
+            for (const auto &range : ranges) {
+                llvm::sys::MemoryBlock block(range.base, range.size);
+                if (auto ec = llvm::sys::Memory::protectMappedMemory(block, pool.getFinalFlags())) {
+                    if (errMsg) *errMsg = ec.message();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void release() {
+            for (const auto &range : ranges) {
+                // the next object loaded into the range needs to be able to write to it
+                if (pool.changesProtection()) {
+                    llvm::sys::Memory::protectMappedMemory(llvm::sys::MemoryBlock(range.base, range.size),
+                                                           pool.getFlags());
+                }
+                pool.release(range);
+            }
+        }
+    };
+
+    Sections code;
+    Sections readOnlyData;
+    Sections readWriteData;
+};
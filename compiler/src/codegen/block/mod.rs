@@ -70,7 +70,12 @@ fn get_lifecycle_func(
     block: BlockRef,
     lifecycle: LifecycleFunc,
 ) -> FunctionValue {
-    let func_name = format!("maxim.block.{}.{}", block, lifecycle);
+    let func_name = format!(
+        "maxim.block.{}.{}.{}",
+        block,
+        cache.block_key(block),
+        lifecycle
+    );
     util::get_or_create_func(module, &func_name, true, &|| {
         let context = module.get_context();
         let layout = cache.block_layout(block).unwrap();
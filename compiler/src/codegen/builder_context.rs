@@ -1,4 +1,4 @@
-use codegen::TargetProperties;
+use codegen::{OptimizationProfile, TargetProperties};
 use inkwell::attribute::AttrKind;
 use inkwell::builder::Builder;
 use inkwell::context::Context;
@@ -35,7 +35,7 @@ pub fn build_context_function(
     function.add_attribute(context.get_enum_attr(AttrKind::NoRecurse, 0));
     function.add_attribute(context.get_enum_attr(AttrKind::NoUnwind, 0));
 
-    if target.min_size {
+    if target.profile == OptimizationProfile::Size {
         function.add_attribute(context.get_enum_attr(AttrKind::MinSize, 0));
         function.add_attribute(context.get_enum_attr(AttrKind::OptimizeForSize, 0));
     }
@@ -1,6 +1,7 @@
 use super::ControlContext;
 use super::{default_copy_getter, default_copy_setter, Control, ControlFieldGenerator};
 use ast::{ControlField, ControlType, FormType, GraphField};
+use codegen::math::{self, Precision};
 use codegen::values::NumValue;
 use codegen::{
     build_context_function, globals, intrinsics, util, BuilderContext, TargetProperties,
@@ -39,7 +40,7 @@ impl GraphControl {
     fn build_tension_graph_func(module: &Module, target: &TargetProperties) {
         let func = GraphControl::get_tension_graph_func(module);
         build_context_function(module, func, target, &|ctx: BuilderContext| {
-            let pow_intrinsic = intrinsics::pow_f32(ctx.module);
+            let pow_intrinsic = math::pow_f32(ctx.module, Precision::Fast);
 
             let q_value = ctx.context.f32_type().const_float(20.);
 
@@ -198,7 +199,7 @@ impl Control for GraphControl {
                     .ctx
                     .b
                     .build_load(
-                        &globals::get_sample_rate(control.ctx.module).as_pointer_value(),
+                        &globals::get_sample_rate(control.ctx.module, control.ctx.b),
                         "samplerate",
                     ).into_vector_value(),
                 &control.ctx.context.i64_type().const_int(0, false),
@@ -216,10 +217,8 @@ impl Control for GraphControl {
                 &control
                     .ctx
                     .b
-                    .build_load(
-                        &globals::get_bpm(control.ctx.module).as_pointer_value(),
-                        "bpm",
-                    ).into_vector_value(),
+                    .build_load(&globals::get_bpm(control.ctx.module, control.ctx.b), "bpm")
+                    .into_vector_value(),
                 &control.ctx.context.i64_type().const_int(0, false),
                 "",
             ).into_float_value();
@@ -1,6 +1,7 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::{intrinsics, util};
+use codegen::math::{self, Precision};
+use codegen::util;
 use inkwell::builder::Builder;
 use inkwell::context::Context;
 use inkwell::module::Module;
@@ -16,7 +17,7 @@ fn amplitude_from_db(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    let pow_intrinsic = math::pow_v2f32(module, Precision::Accurate);
     builder
         .build_call(
             &pow_intrinsic,
@@ -30,7 +30,7 @@ fn beats_from_frequency(
 ) -> VectorValue {
     builder.build_float_div(
         builder
-            .build_load(&globals::get_bpm(module).as_pointer_value(), "bpm")
+            .build_load(&globals::get_bpm(module, builder), "bpm")
             .into_vector_value(),
         builder.build_float_mul(util::get_vec_spread(context, 60.), val, ""),
         "",
@@ -47,16 +47,14 @@ fn beats_from_samples(
         builder.build_float_mul(
             val,
             builder
-                .build_load(&globals::get_bpm(module).as_pointer_value(), "bpm")
+                .build_load(&globals::get_bpm(module, builder), "bpm")
                 .into_vector_value(),
             "",
         ),
         builder.build_float_mul(
             builder
-                .build_load(
-                    &globals::get_sample_rate(module).as_pointer_value(),
-                    "samplerate",
-                ).into_vector_value(),
+                .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+                .into_vector_value(),
             util::get_vec_spread(context, 60.),
             "",
         ),
@@ -74,7 +72,7 @@ fn beats_from_seconds(
         val,
         builder.build_float_mul(
             builder
-                .build_load(&globals::get_bpm(module).as_pointer_value(), "bpm")
+                .build_load(&globals::get_bpm(module, builder), "bpm")
                 .into_vector_value(),
             util::get_vec_spread(context, 60.),
             "",
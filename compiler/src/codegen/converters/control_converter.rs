@@ -1,6 +1,6 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::intrinsics;
+use codegen::math::{self, Precision};
 use codegen::{globals, util};
 use inkwell::builder::Builder;
 use inkwell::context::Context;
@@ -34,7 +34,7 @@ fn control_from_db(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    let pow_intrinsic = math::pow_v2f32(module, Precision::Accurate);
 
     builder.build_float_div(
         builder
@@ -60,7 +60,7 @@ fn control_from_frequency(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log_intrinsic = intrinsics::log_v2f32(module);
+    let log_intrinsic = math::log_v2f32(module, Precision::Accurate);
 
     builder.build_float_div(
         builder
@@ -125,10 +125,8 @@ fn control_from_samples(
             builder.build_float_mul(
                 util::get_vec_spread(context, 0.1),
                 builder
-                    .build_load(
-                        &globals::get_sample_rate(module).as_pointer_value(),
-                        "samplerate",
-                    ).into_vector_value(),
+                    .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+                    .into_vector_value(),
                 "",
             ),
             "",
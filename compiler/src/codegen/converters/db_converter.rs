@@ -1,6 +1,6 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::intrinsics;
+use codegen::math::{self, Precision};
 use codegen::util;
 use inkwell::builder::Builder;
 use inkwell::context::Context;
@@ -18,7 +18,7 @@ fn db_from_amplitude(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log10_intrinsic = intrinsics::log10_v2f32(module);
+    let log10_intrinsic = math::log10_v2f32(module, Precision::Accurate);
 
     builder.build_float_mul(
         builder
@@ -37,7 +37,7 @@ fn db_from_control(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log10_intrinsic = intrinsics::log10_v2f32(module);
+    let log10_intrinsic = math::log10_v2f32(module, Precision::Accurate);
 
     builder.build_float_mul(
         builder
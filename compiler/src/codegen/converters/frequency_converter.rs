@@ -1,6 +1,7 @@
 use super::ConvertGenerator;
 use ast::FormType;
 use codegen::intrinsics;
+use codegen::math::{self, Precision};
 use codegen::{globals, util};
 use inkwell::builder::Builder;
 use inkwell::context::Context;
@@ -23,7 +24,7 @@ fn frequency_from_beats(
 ) -> VectorValue {
     builder.build_float_div(
         builder
-            .build_load(&globals::get_bpm(module).as_pointer_value(), "bpm")
+            .build_load(&globals::get_bpm(module, builder), "bpm")
             .into_vector_value(),
         builder.build_float_mul(val, util::get_vec_spread(context, 60.), ""),
         "",
@@ -36,7 +37,7 @@ fn frequency_from_control(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    let pow_intrinsic = math::pow_v2f32(module, Precision::Accurate);
     let min_intrinsic = intrinsics::minnum_v2f32(module);
 
     builder.build_float_sub(
@@ -71,7 +72,7 @@ fn frequency_from_note(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    let pow_intrinsic = math::pow_v2f32(module, Precision::Accurate);
 
     builder.build_float_mul(
         util::get_vec_spread(context, 440.),
@@ -103,10 +104,8 @@ fn frequency_from_samples(
 ) -> VectorValue {
     builder.build_float_div(
         builder
-            .build_load(
-                &globals::get_sample_rate(module).as_pointer_value(),
-                "samplerate",
-            ).into_vector_value(),
+            .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+            .into_vector_value(),
         val,
         "",
     )
@@ -1,6 +1,7 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::{intrinsics, util};
+use codegen::math::{self, Precision};
+use codegen::util;
 use inkwell::builder::Builder;
 use inkwell::context::Context;
 use inkwell::module::Module;
@@ -26,7 +27,7 @@ fn note_from_frequency(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log2_intrinsic = intrinsics::log2_v2f32(module);
+    let log2_intrinsic = math::log2_v2f32(module, Precision::Accurate);
 
     builder.build_float_add(
         util::get_vec_spread(context, 69.),
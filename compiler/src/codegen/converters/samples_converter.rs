@@ -24,17 +24,15 @@ fn samples_from_beats(
             val,
             builder.build_float_mul(
                 builder
-                    .build_load(
-                        &globals::get_sample_rate(module).as_pointer_value(),
-                        "samplerate",
-                    ).into_vector_value(),
+                    .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+                    .into_vector_value(),
                 util::get_vec_spread(context, 60.),
                 "",
             ),
             "",
         ),
         builder
-            .build_load(&globals::get_bpm(module).as_pointer_value(), "bpm")
+            .build_load(&globals::get_bpm(module, builder), "bpm")
             .into_vector_value(),
         "",
     )
@@ -50,10 +48,8 @@ fn samples_from_control(
         builder.build_float_mul(
             val,
             builder
-                .build_load(
-                    &globals::get_sample_rate(module).as_pointer_value(),
-                    "samplerate",
-                ).into_vector_value(),
+                .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+                .into_vector_value(),
             "",
         ),
         builder.build_float_sub(
@@ -73,10 +69,8 @@ fn samples_from_frequency(
 ) -> VectorValue {
     builder.build_float_div(
         builder
-            .build_load(
-                &globals::get_sample_rate(module).as_pointer_value(),
-                "samplerate",
-            ).into_vector_value(),
+            .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+            .into_vector_value(),
         val,
         "",
     )
@@ -91,10 +85,8 @@ fn samples_from_seconds(
     builder.build_float_mul(
         val,
         builder
-            .build_load(
-                &globals::get_sample_rate(module).as_pointer_value(),
-                "samplerate",
-            ).into_vector_value(),
+            .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+            .into_vector_value(),
         "",
     )
 }
@@ -23,7 +23,7 @@ fn seconds_from_beats(
         val,
         builder.build_float_div(
             builder
-                .build_load(&globals::get_bpm(module).as_pointer_value(), "bpm")
+                .build_load(&globals::get_bpm(module, builder), "bpm")
                 .into_vector_value(),
             util::get_vec_spread(context, 60.),
             "",
@@ -67,10 +67,8 @@ fn seconds_from_samples(
     builder.build_float_div(
         val,
         builder
-            .build_load(
-                &globals::get_sample_rate(module).as_pointer_value(),
-                "samplerate",
-            ).into_vector_value(),
+            .build_load(&globals::get_sample_rate(module, builder), "samplerate")
+            .into_vector_value(),
         "",
     )
 }
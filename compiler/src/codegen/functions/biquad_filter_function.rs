@@ -1,4 +1,5 @@
 use super::{Function, FunctionContext, VarArgs};
+use codegen::math::{self, Precision};
 use codegen::values::NumValue;
 use codegen::{
     build_context_function, globals, intrinsics, util, BuilderContext, TargetProperties,
@@ -147,8 +148,8 @@ fn gen_biquad_call(
     generate_coefficients: &GenerateCoefficientsFn,
 ) {
     let max_intrinsic = intrinsics::maxnum_v2f32(func.ctx.module);
-    let sin_intrinsic = intrinsics::sin_v2f32(func.ctx.module);
-    let cos_intrinsic = intrinsics::cos_v2f32(func.ctx.module);
+    let sin_intrinsic = math::sin_v2f32(func.ctx.module, Precision::Accurate);
+    let cos_intrinsic = math::cos_v2f32(func.ctx.module, Precision::Accurate);
     let internal_biquad_func = get_internal_biquad_func(func.ctx.module);
 
     let a1_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 0, "a1.ptr") };
@@ -298,7 +299,7 @@ fn gen_biquad_call(
         .ctx
         .b
         .build_load(
-            &globals::get_sample_rate(func.ctx.module).as_pointer_value(),
+            &globals::get_sample_rate(func.ctx.module, func.ctx.b),
             "samplerate",
         ).into_vector_value();
     let w0 = func.ctx.b.build_float_mul(
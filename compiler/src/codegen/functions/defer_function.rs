@@ -1,5 +1,6 @@
 use super::{Function, FunctionContext, VarArgs};
 use ast::FormType;
+use codegen::math::{self, Precision};
 use codegen::values::NumValue;
 use codegen::{globals, intrinsics, util, BuilderContext};
 use inkwell::context::Context;
@@ -50,7 +51,7 @@ impl Function for AmplitudeFunction {
         result: PointerValue,
     ) {
         let abs_intrinsic = intrinsics::fabs_v2f32(func.ctx.module);
-        let exp_intrinsic = intrinsics::exp_v2f32(func.ctx.module);
+        let exp_intrinsic = math::exp_v2f32(func.ctx.module, Precision::Accurate);
 
         let current_estimate_ptr = unsafe {
             func.ctx
@@ -89,7 +90,7 @@ impl Function for AmplitudeFunction {
                             func.ctx
                                 .b
                                 .build_load(
-                                    &globals::get_sample_rate(func.ctx.module).as_pointer_value(),
+                                    &globals::get_sample_rate(func.ctx.module, func.ctx.b),
                                     "samplerate",
                                 ).into_vector_value(),
                             "",
@@ -53,27 +53,28 @@ impl DelayFunction {
     ///
     ///         (*buffer)[loadedCurrentPos] = input;
     ///     } else {
-    ///         resultVal = input;
+    ///         // the buffer hasn't been allocated yet, so nothing has been written to it
+    ///         resultVal = delaySamples == 0 ? input : 0;
     ///     }
     ///
     ///     auto bufferSize = calculateNextPowerOfTwo(reserveSamples);
-    ///     if (bufferSize != *currentSize) {
-    ///         *buffer = realloc(*buffer, bufferSize * sizeof(float));
-    ///         if (bufferSize == 0) *buffer = nullptr;
-    ///         else memset(*buffer + *currentSize, 0, (bufferSize - *currentSize) * sizeof(float));
+    ///     if (bufferSize != *currentSize && maxim_resize_buffer(bufferPool, buffer, *currentSize, bufferSize)) {
+    ///         *currentPos &= bufferSize - 1;
     ///         *currentSize = bufferSize;
     ///     }
     ///
     ///     return resultVal;
     /// }
     /// ```
+    ///
+    /// Buffers come from the runtime's buffer pool, so resizing them never calls the system
+    /// allocator. If the pool doesn't have a buffer of the new size ready, the old one is kept and
+    /// resizing is tried again on the next sample.
     fn build_channel_update_func(module: &Module, target: &TargetProperties) {
         let func = DelayFunction::get_channel_update_func(module);
         build_context_function(module, func, target, &|ctx: BuilderContext| {
-            let target_data = target.machine.get_data();
             let next_power_intrinsic = intrinsics::next_power_i64(ctx.module);
-            let realloc_intrinsic = intrinsics::realloc(ctx.module, &target_data);
-            let memset_intrinsic = intrinsics::memset(ctx.module, &target_data);
+            let resize_buffer_intrinsic = intrinsics::resize_buffer(ctx.module);
 
             let current_pos_ptr = ctx.func.get_nth_param(0).unwrap().into_pointer_value();
             let current_size_ptr = ctx.func.get_nth_param(1).unwrap().into_pointer_value();
@@ -96,23 +97,13 @@ impl DelayFunction {
             let has_buffer_continue_block = ctx
                 .context
                 .append_basic_block(&ctx.func, "hasbuffer.continue");
-            let needs_realloc_true_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "needsrealloc.true");
-            let size_zero_true_block = ctx.context.append_basic_block(&ctx.func, "sizezero.true");
-            let size_zero_false_block = ctx.context.append_basic_block(&ctx.func, "sizezero.false");
-            let size_increase_true_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "sizeincrease.true");
-            let size_increase_continue_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "sizeincrease.continue");
-            let size_zero_continue_block = ctx
+            let needs_resize_true_block = ctx
                 .context
-                .append_basic_block(&ctx.func, "sizezero.continue");
-            let needs_realloc_continue_block = ctx
+                .append_basic_block(&ctx.func, "needsresize.true");
+            let resized_true_block = ctx.context.append_basic_block(&ctx.func, "resized.true");
+            let needs_resize_continue_block = ctx
                 .context
-                .append_basic_block(&ctx.func, "needsrealloc.continue");
+                .append_basic_block(&ctx.func, "needsresize.continue");
 
             let result_ptr = ctx
                 .allocb
@@ -122,6 +113,13 @@ impl DelayFunction {
                 .build_load(&buffer_ptr_ptr, "bufferptr")
                 .into_pointer_value();
 
+            let has_samples = ctx.b.build_int_compare(
+                IntPredicate::NE,
+                delay_samples,
+                ctx.context.i64_type().const_int(0, false),
+                "hassamples",
+            );
+
             // if (*currentSize) {
             let current_size = ctx
                 .b
@@ -160,12 +158,6 @@ impl DelayFunction {
             ctx.b.build_store(&current_pos_ptr, &new_pos);
 
             // if (delaySamples == 0) {
-            let has_samples = ctx.b.build_int_compare(
-                IntPredicate::NE,
-                delay_samples,
-                ctx.context.i64_type().const_int(0, false),
-                "hassamples",
-            );
             ctx.b.build_conditional_branch(
                 &has_samples,
                 &has_samples_true_block,
@@ -222,8 +214,14 @@ impl DelayFunction {
 
             ctx.b.position_at_end(&has_buffer_false_block);
 
-            // resultVal = input;
-            ctx.b.build_store(&result_ptr, &input_num);
+            // resultVal = delaySamples == 0 ? input : 0;
+            let empty_result = ctx.b.build_select(
+                has_samples,
+                ctx.context.f32_type().const_float(0.),
+                input_num,
+                "emptyresult",
+            );
+            ctx.b.build_store(&result_ptr, &empty_result);
             ctx.b.build_unconditional_branch(&has_buffer_continue_block);
 
             ctx.b.position_at_end(&has_buffer_continue_block);
@@ -240,125 +238,75 @@ impl DelayFunction {
                 .unwrap()
                 .into_int_value();
 
-            // if (bufferSize != *currentSize) {
-            let needs_realloc = ctx.b.build_int_compare(
+            // if (bufferSize != *currentSize && maxim_resize_buffer(bufferPool, buffer, *currentSize, bufferSize)) {
+            let needs_resize = ctx.b.build_int_compare(
                 IntPredicate::NE,
                 new_buffer_size,
                 current_size,
-                "needsrealloc",
+                "needsresize",
             );
             ctx.b.build_conditional_branch(
-                &needs_realloc,
-                &needs_realloc_true_block,
-                &needs_realloc_continue_block,
+                &needs_resize,
+                &needs_resize_true_block,
+                &needs_resize_continue_block,
             );
 
-            ctx.b.position_at_end(&needs_realloc_true_block);
-
-            // *buffer = realloc(*buffer, bufferSize * sizeof(float));
-            let size_type = target_data.int_ptr_type_in_context(ctx.context);
-            let float_size = ctx
-                .context
-                .f32_type()
-                .size_of()
-                .const_cast(&size_type, false);
-            let realloc_size = ctx.b.build_int_mul(
-                ctx.b.build_int_cast(new_buffer_size, size_type, ""),
-                float_size,
-                "",
-            );
-            let realloc_ptr = ctx
+            ctx.b.position_at_end(&needs_resize_true_block);
+            let buffer_pool = ctx
+                .b
+                .build_load(
+                    &globals::get_buffer_pool(ctx.module).as_pointer_value(),
+                    "bufferpool",
+                ).into_pointer_value();
+            let resized = ctx
                 .b
                 .build_call(
-                    &realloc_intrinsic,
+                    &resize_buffer_intrinsic,
                     &[
-                        &ctx.b.build_pointer_cast(
-                            buffer_ptr,
-                            ctx.context.i8_type().ptr_type(AddressSpace::Generic),
-                            "",
-                        ),
-                        &realloc_size,
+                        &buffer_pool,
+                        &buffer_ptr_ptr,
+                        &current_size,
+                        &new_buffer_size,
                     ],
                     "",
                     false,
                 ).left()
                 .unwrap()
-                .into_pointer_value();
-
-            // if (bufferSize == 0) *buffer = nullptr;
-            let size_is_zero = ctx.b.build_int_compare(
-                IntPredicate::EQ,
-                realloc_size,
-                size_type.const_int(0, false),
-                "sizezero",
+                .into_int_value();
+            let is_resized = ctx.b.build_int_compare(
+                IntPredicate::NE,
+                resized,
+                ctx.context.i8_type().const_int(0, false),
+                "isresized",
             );
             ctx.b.build_conditional_branch(
-                &size_is_zero,
-                &size_zero_true_block,
-                &size_zero_false_block,
+                &is_resized,
+                &resized_true_block,
+                &needs_resize_continue_block,
             );
 
-            let buffer_ptr_type = ctx.context.f32_type().ptr_type(AddressSpace::Generic);
-
-            ctx.b.position_at_end(&size_zero_true_block);
-            ctx.b
-                .build_store(&buffer_ptr_ptr, &buffer_ptr_type.const_null());
-            ctx.b.build_unconditional_branch(&size_zero_continue_block);
-
-            // else if (bufferSize > *currentSize) memset(*buffer + *currentSize, 0, (bufferSize - *currentSize) * sizeof(float));
-            ctx.b.position_at_end(&size_zero_false_block);
-            let size_increase = ctx.b.build_int_compare(
-                IntPredicate::UGT,
-                new_buffer_size,
-                current_size,
-                "sizeincrease",
-            );
-            ctx.b.build_conditional_branch(
-                &size_increase,
-                &size_increase_true_block,
-                &size_increase_continue_block,
-            );
+            ctx.b.position_at_end(&resized_true_block);
 
-            ctx.b.position_at_end(&size_increase_true_block);
-            let current_size_bytes = ctx.b.build_int_mul(
-                ctx.b.build_int_cast(current_size, size_type, ""),
-                float_size,
-                "currentsizebytes",
-            );
-            ctx.b.build_call(
-                &memset_intrinsic,
-                &[
-                    &unsafe {
-                        ctx.b
-                            .build_in_bounds_gep(&realloc_ptr, &[current_size_bytes], "offsetptr")
-                    },
-                    &ctx.context.i8_type().const_int(0, false),
-                    &ctx.b.build_int_sub(realloc_size, current_size_bytes, ""),
-                    &ctx.context.i32_type().const_int(0, false),
-                    &ctx.context.bool_type().const_int(0, false),
-                ],
-                "",
-                false,
-            );
-            ctx.b
-                .build_unconditional_branch(&size_increase_continue_block);
-
-            ctx.b.position_at_end(&size_increase_continue_block);
-            ctx.b.build_store(
-                &buffer_ptr_ptr,
-                &ctx.b
-                    .build_pointer_cast(realloc_ptr, buffer_ptr_type, "newbufferptr"),
+            // *currentPos &= bufferSize - 1;
+            let wrapped_pos = ctx.b.build_and(
+                ctx.b
+                    .build_load(&current_pos_ptr, "currentpos")
+                    .into_int_value(),
+                ctx.b.build_int_sub(
+                    new_buffer_size,
+                    ctx.context.i64_type().const_int(1, false),
+                    "",
+                ),
+                "wrappedpos",
             );
-            ctx.b.build_unconditional_branch(&size_zero_continue_block);
-
-            ctx.b.position_at_end(&size_zero_continue_block);
+            ctx.b.build_store(&current_pos_ptr, &wrapped_pos);
 
             // *currentSize = bufferSize;
             ctx.b.build_store(&current_size_ptr, &new_buffer_size);
             ctx.b
-                .build_unconditional_branch(&needs_realloc_continue_block);
+                .build_unconditional_branch(&needs_resize_continue_block);
 
-            ctx.b.position_at_end(&needs_realloc_continue_block);
+            ctx.b.position_at_end(&needs_resize_continue_block);
             ctx.b.build_return(Some(&ctx.b.build_load(&result_ptr, "")));
         });
     }
@@ -447,24 +395,40 @@ impl Function for DelayFunction {
             .ctx
             .b
             .build_load(
-                &globals::get_sample_rate(func.ctx.module).as_pointer_value(),
+                &globals::get_sample_rate(func.ctx.module, func.ctx.b),
                 "samplerate",
             ).into_vector_value();
 
-        // determine reserve samples
+        // determine reserve samples, up to the size of the largest buffer the pool has
         let reserve_vec = reserve_num.get_vec(func.ctx.b);
         let reserve_samples_float = func
             .ctx
             .b
             .build_call(
-                &max_intrinsic,
+                &min_intrinsic,
                 &[
-                    &func.ctx.b.build_float_mul(
-                        reserve_vec,
-                        sample_rate,
-                        "reservesamples.unclamped",
+                    &func
+                        .ctx
+                        .b
+                        .build_call(
+                            &max_intrinsic,
+                            &[
+                                &func.ctx.b.build_float_mul(
+                                    reserve_vec,
+                                    sample_rate,
+                                    "reservesamples.unclamped",
+                                ),
+                                &util::get_vec_spread(func.ctx.context, 0.),
+                            ],
+                            "reservesamples.clamped",
+                            false,
+                        ).left()
+                        .unwrap()
+                        .into_vector_value(),
+                    &util::get_vec_spread(
+                        func.ctx.context,
+                        (1u64 << intrinsics::MAX_BUFFER_SIZE_CLASS) as f32,
                     ),
-                    &util::get_vec_spread(func.ctx.context, 0.),
                 ],
                 "reservesamples.clamped",
                 false,
@@ -597,30 +561,99 @@ impl Function for DelayFunction {
         result_num.set_form(func.ctx.b, &input_form);
     }
 
-    fn gen_destruct(func: &mut FunctionContext) {
-        let left_buffer_ptr = func
+    // A buffer for a one second reserve is reserved for each channel while the delay is
+    // constructed, off the audio thread, so delays of around that length have one ready the first
+    // time they run however many delays there are.
+    fn gen_construct(func: &mut FunctionContext) {
+        let next_power_intrinsic = intrinsics::next_power_i64(func.ctx.module);
+        let prepare_buffer_intrinsic = intrinsics::prepare_buffer(func.ctx.module);
+        let buffer_pool = func
             .ctx
             .b
             .build_load(
-                &unsafe {
-                    func.ctx
-                        .b
-                        .build_struct_gep(&func.data_ptr, 4, "leftbuffer.ptr")
-                },
-                "leftbuffer",
+                &globals::get_buffer_pool(func.ctx.module).as_pointer_value(),
+                "bufferpool",
             ).into_pointer_value();
-        let right_buffer_ptr = func
+        let sample_rate = func
             .ctx
             .b
             .build_load(
-                &unsafe {
-                    func.ctx
-                        .b
-                        .build_struct_gep(&func.data_ptr, 5, "rightbuffer.ptr")
-                },
-                "rightbuffer",
+                &globals::get_sample_rate(func.ctx.module, func.ctx.b),
+                "samplerate",
+            ).into_vector_value();
+
+        // a second's worth of samples is the sample rate of each channel
+        for &element in &[0, 1] {
+            let channel_rate = func.ctx.b.build_extract_element(
+                &sample_rate,
+                &func.ctx.context.i32_type().const_int(element, false),
+                "channelrate",
+            );
+            let reserve_samples = func.ctx.b.build_float_to_unsigned_int(
+                channel_rate.into_float_value(),
+                func.ctx.context.i64_type(),
+                "reservesamples",
+            );
+            let buffer_size = func
+                .ctx
+                .b
+                .build_call(
+                    &next_power_intrinsic,
+                    &[&reserve_samples],
+                    "buffersize",
+                    false,
+                ).left()
+                .unwrap()
+                .into_int_value();
+            func.ctx.b.build_call(
+                &prepare_buffer_intrinsic,
+                &[&buffer_pool, &buffer_size],
+                "",
+                false,
+            );
+        }
+    }
+
+    fn gen_destruct(func: &mut FunctionContext) {
+        let free_buffer_intrinsic = intrinsics::free_buffer(func.ctx.module);
+        let buffer_pool = func
+            .ctx
+            .b
+            .build_load(
+                &globals::get_buffer_pool(func.ctx.module).as_pointer_value(),
+                "bufferpool",
             ).into_pointer_value();
-        func.ctx.b.build_free(&left_buffer_ptr);
-        func.ctx.b.build_free(&right_buffer_ptr);
+
+        // buffers are returned to the pool with their size, which is the pool's size class
+        for &(length_index, buffer_index) in &[(2, 4), (3, 5)] {
+            let buffer_length = func
+                .ctx
+                .b
+                .build_load(
+                    &unsafe {
+                        func.ctx
+                            .b
+                            .build_struct_gep(&func.data_ptr, length_index, "bufferlength.ptr")
+                    },
+                    "bufferlength",
+                ).into_int_value();
+            let buffer_ptr = func
+                .ctx
+                .b
+                .build_load(
+                    &unsafe {
+                        func.ctx
+                            .b
+                            .build_struct_gep(&func.data_ptr, buffer_index, "buffer.ptr")
+                    },
+                    "buffer",
+                ).into_pointer_value();
+            func.ctx.b.build_call(
+                &free_buffer_intrinsic,
+                &[&buffer_pool, &buffer_ptr, &buffer_length],
+                "",
+                false,
+            );
+        }
     }
 }
@@ -1,10 +1,11 @@
 use super::{Function, FunctionContext, VarArgs};
 use ast::FormType;
+use codegen::math::{self, Precision};
 use codegen::values::{ArrayValue, NumValue, ARRAY_CAPACITY};
-use codegen::{intrinsics, util};
-use inkwell::module::Linkage;
-use inkwell::types::VectorType;
-use inkwell::values::PointerValue;
+use codegen::{globals, intrinsics, util};
+use inkwell::context::Context;
+use inkwell::types::{StructType, VectorType};
+use inkwell::values::{PointerValue, VectorValue};
 use inkwell::IntPredicate;
 use mir::block;
 use std::f32::consts;
@@ -148,8 +149,8 @@ impl Function for PanFunction {
         let min_intrinsic = intrinsics::minnum_v2f32(func.ctx.module);
         let max_intrinsic = intrinsics::maxnum_v2f32(func.ctx.module);
         let sqrt_intrinsic = intrinsics::sqrt_v2f32(func.ctx.module);
-        let cos_intrinsic = intrinsics::cos_f32(func.ctx.module);
-        let sin_intrinsic = intrinsics::sin_f32(func.ctx.module);
+        let cos_intrinsic = math::cos_f32(func.ctx.module, Precision::Fast);
+        let sin_intrinsic = math::sin_f32(func.ctx.module, Precision::Fast);
 
         let x_num = NumValue::new(args[0]);
         let pan_num = NumValue::new(args[1]);
@@ -564,12 +565,95 @@ impl Function for MixdownFunction {
     }
 }
 
+// Hashes each lane of a vector of integers to a well-mixed value. This is the "lowbias32" integer
+// hash, which is cheap, has no state and vectorizes, so noise doesn't need a shared generator.
+fn gen_noise_hash(func: &mut FunctionContext, val: VectorValue) -> VectorValue {
+    let b = &*func.ctx.b;
+    let context = func.ctx.context;
+    let xor_shift = |val: VectorValue, shift: u64| {
+        b.build_xor(
+            val,
+            b.build_right_shift(val, util::get_int_vec_spread(context, shift), false, ""),
+            "",
+        )
+    };
+
+    let val = xor_shift(val, 16);
+    let val = b.build_int_mul(val, util::get_int_vec_spread(context, 0x7FEB_352D), "");
+    let val = xor_shift(val, 15);
+    let val = b.build_int_mul(val, util::get_int_vec_spread(context, 0x846C_A68B), "");
+    xor_shift(val, 16)
+}
+
 pub struct NoiseFunction {}
 impl Function for NoiseFunction {
     fn function_type() -> block::Function {
         block::Function::Noise
     }
 
+    // Each noise node hashes a counter with a key that's unique to the node and channel, so nodes
+    // and voices produce independent streams without sharing any state.
+    fn data_type(context: &Context) -> StructType {
+        context.struct_type(
+            &[&context.i32_type().vec_type(2), &context.i32_type()],
+            false,
+        )
+    }
+
+    fn gen_construct(func: &mut FunctionContext) {
+        let key_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 0, "key.ptr") };
+        let counter_ptr = unsafe {
+            func.ctx
+                .b
+                .build_struct_gep(&func.data_ptr, 1, "counter.ptr")
+        };
+        let seed_ptr = globals::get_noise_seed(func.ctx.module, func.ctx.b);
+        let stream_ptr = globals::get_noise_stream(func.ctx.module, func.ctx.b);
+
+        // Each node takes the next two streams, one for each channel. Nodes are constructed in
+        // the same order each time a patch is built, so a patch sounds the same for the same seed.
+        let stream = func
+            .ctx
+            .b
+            .build_load(&stream_ptr, "stream")
+            .into_int_value();
+        func.ctx.b.build_store(
+            &stream_ptr,
+            &func.ctx.b.build_int_add(
+                stream,
+                func.ctx.context.i32_type().const_int(1, false),
+                "nextstream",
+            ),
+        );
+        let first_stream = func.ctx.b.build_int_mul(
+            stream,
+            func.ctx.context.i32_type().const_int(2, false),
+            "firststream",
+        );
+        let streams = func.ctx.b.build_int_add(
+            util::splat_int_vector(func.ctx.b, first_stream, "streams"),
+            VectorType::const_vector(&[
+                &func.ctx.context.i32_type().const_int(0, false),
+                &func.ctx.context.i32_type().const_int(1, false),
+            ]),
+            "streams",
+        );
+
+        let seed = func.ctx.b.build_load(&seed_ptr, "seed").into_int_value();
+        let stream_hash = gen_noise_hash(func, streams);
+        let seeded_hash = func.ctx.b.build_xor(
+            stream_hash,
+            util::splat_int_vector(func.ctx.b, seed, "seed"),
+            "seededhash",
+        );
+        let key = gen_noise_hash(func, seeded_hash);
+        func.ctx.b.build_store(&key_ptr, &key);
+        func.ctx.b.build_store(
+            &counter_ptr,
+            &func.ctx.context.i32_type().const_int(0, false),
+        );
+    }
+
     fn gen_call(
         func: &mut FunctionContext,
         _args: &[PointerValue],
@@ -577,59 +661,61 @@ impl Function for NoiseFunction {
         result: PointerValue,
     ) {
         let result_num = NumValue::new(result);
-        let noise_func = util::get_or_create_func(func.ctx.module, "rand", false, &|| {
-            (
-                Linkage::ExternalLinkage,
-                func.ctx.context.i32_type().fn_type(&[], false),
-            )
-        });
-
-        let left_rand = func
-            .ctx
-            .b
-            .build_call(&noise_func, &[], "rand.left", false)
-            .left()
-            .unwrap()
-            .into_int_value();
-        let right_rand = func
+        let key_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 0, "key.ptr") };
+        let counter_ptr = unsafe {
+            func.ctx
+                .b
+                .build_struct_gep(&func.data_ptr, 1, "counter.ptr")
+        };
+
+        let key = func.ctx.b.build_load(&key_ptr, "key").into_vector_value();
+        let counter = func
             .ctx
             .b
-            .build_call(&noise_func, &[], "rand.right", false)
-            .left()
-            .unwrap()
+            .build_load(&counter_ptr, "counter")
             .into_int_value();
-        let rand_vec = func
-            .ctx
-            .b
-            .build_insert_element(
-                &func.ctx.context.i32_type().vec_type(2).get_undef(),
-                &left_rand,
-                &func.ctx.context.i32_type().const_int(0, false),
-                "rand",
-            ).into_vector_value();
-        let rand_vec = func
-            .ctx
-            .b
-            .build_insert_element(
-                &rand_vec,
-                &right_rand,
-                &func.ctx.context.i32_type().const_int(1, false),
-                "rand",
-            ).into_vector_value();
-        let rand_vec_float = func.ctx.b.build_signed_int_to_float(
+        func.ctx.b.build_store(
+            &counter_ptr,
+            &func.ctx.b.build_int_add(
+                counter,
+                func.ctx.context.i32_type().const_int(1, false),
+                "nextcounter",
+            ),
+        );
+
+        // spreading the counter out with the golden ratio keeps consecutive inputs far apart, and
+        // the stream only repeats after 2^32 samples
+        let spread_counter = func.ctx.b.build_int_mul(
+            counter,
+            func.ctx.context.i32_type().const_int(0x9E37_79B9, false),
+            "spreadcounter",
+        );
+        let rand_input = func.ctx.b.build_int_add(
+            key,
+            util::splat_int_vector(func.ctx.b, spread_counter, "spreadcounter"),
+            "rand.input",
+        );
+        let rand_vec = gen_noise_hash(func, rand_input);
+
+        // the top 24 bits fit in a float exactly, so every output value is equally likely
+        let rand_bits = func.ctx.b.build_right_shift(
             rand_vec,
+            util::get_int_vec_spread(func.ctx.context, 8),
+            false,
+            "rand.bits",
+        );
+        let rand_vec_float = func.ctx.b.build_signed_int_to_float(
+            rand_bits,
             func.ctx.context.f32_type().vec_type(2),
             "rand.float",
         );
 
-        // todo: figure out a compiler-independent way to do this - this is the constant from GNU C headers
-        let double_rand_max_float = util::get_vec_spread(func.ctx.context, 32767. / 2.);
-
         // get the random number between 0 and 2
-        let rand_normalized =
-            func.ctx
-                .b
-                .build_float_div(rand_vec_float, double_rand_max_float, "rand.normalized");
+        let rand_normalized = func.ctx.b.build_float_mul(
+            rand_vec_float,
+            util::get_vec_spread(func.ctx.context, 2. / (1 << 24) as f32),
+            "rand.normalized",
+        );
 
         // now convert it to be between -1 and 1
         let rand_val = func.ctx.b.build_float_sub(
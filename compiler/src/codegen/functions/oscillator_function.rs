@@ -1,5 +1,6 @@
 use super::{Function, FunctionContext, VarArgs};
 use ast::FormType;
+use codegen::math::{self, Precision};
 use codegen::values::NumValue;
 use codegen::{globals, intrinsics, util, BuilderContext};
 use inkwell::context::Context;
@@ -55,7 +56,7 @@ fn gen_periodic_call(
         .ctx
         .b
         .build_load(
-            &globals::get_sample_rate(func.ctx.module).as_pointer_value(),
+            &globals::get_sample_rate(func.ctx.module, func.ctx.b),
             "samplerate",
         ).into_vector_value();
     let phase_offset = func
@@ -113,7 +114,7 @@ fn sin_next_value(
     phase: VectorValue,
     _extra_args: &[PointerValue],
 ) -> VectorValue {
-    let sin_intrinsic = intrinsics::sin_v2f32(func.ctx.module);
+    let sin_intrinsic = math::sin_v2f32(func.ctx.module, Precision::Accurate);
     let sin_phase = func.ctx.b.build_float_mul(
         phase,
         util::get_vec_spread(func.ctx.context, consts::PI * 2.),
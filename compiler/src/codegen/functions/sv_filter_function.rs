@@ -1,4 +1,5 @@
 use super::{Function, FunctionContext, VarArgs};
+use codegen::math::{self, Precision};
 use codegen::values::{NumValue, TupleValue};
 use codegen::{globals, intrinsics, util};
 use inkwell::context::Context;
@@ -33,9 +34,9 @@ impl Function for SvFilterFunction {
         _varargs: Option<VarArgs>,
         result: PointerValue,
     ) {
-        let sin_intrinsic = intrinsics::sin_v2f32(func.ctx.module);
+        let sin_intrinsic = math::sin_v2f32(func.ctx.module, Precision::Accurate);
         let min_intrinsic = intrinsics::minnum_v2f32(func.ctx.module);
-        let pow_intrinsic = intrinsics::pow_v2f32(func.ctx.module);
+        let pow_intrinsic = math::pow_v2f32(func.ctx.module, Precision::Accurate);
 
         let notch_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 0, "notch.ptr") };
         let low_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 1, "low.ptr") };
@@ -61,7 +62,7 @@ impl Function for SvFilterFunction {
                             func.ctx
                                 .b
                                 .build_load(
-                                    &globals::get_sample_rate(func.ctx.module).as_pointer_value(),
+                                    &globals::get_sample_rate(func.ctx.module, func.ctx.b),
                                     "samplerate",
                                 ).into_vector_value(),
                             "",
@@ -1,27 +1,123 @@
 use codegen::util;
-use inkwell::module::Module;
-use inkwell::values::GlobalValue;
+use inkwell::attribute::AttrKind;
+use inkwell::builder::Builder;
+use inkwell::context::Context;
+use inkwell::module::{Linkage, Module};
+use inkwell::types::StructType;
+use inkwell::values::{FunctionValue, GlobalValue, PointerValue};
+use inkwell::AddressSpace;
 
-pub const SAMPLERATE_GLOBAL_NAME: &str = "maxim.samplerate";
-pub const BPM_GLOBAL_NAME: &str = "maxim.bpm";
+/// Returns a pointer to the globals of the runtime being run on the calling thread, implemented by
+/// the runtime. Must match the layout of `RuntimeGlobals`.
+pub const RUNTIME_GLOBALS_FUNC_NAME: &str = "maxim_get_runtime_globals";
 
-pub fn get_sample_rate(module: &Module) -> GlobalValue {
+pub const WORKER_POOL_GLOBAL_NAME: &str = "maxim.workers.pool";
+pub const BUFFER_POOL_GLOBAL_NAME: &str = "maxim.buffers.pool";
+
+fn get_runtime_globals_type(context: &Context) -> StructType {
+    let vec_type = context.f32_type().vec_type(2);
+    context.struct_type(
+        &[
+            &vec_type,           // sample rate
+            &vec_type,           // BPM
+            &context.i32_type(), // noise seed
+            &context.i32_type(), // noise stream
+        ],
+        false,
+    )
+}
+
+fn get_runtime_globals_func(module: &Module) -> FunctionValue {
+    if let Some(func) = module.get_function(RUNTIME_GLOBALS_FUNC_NAME) {
+        return func;
+    }
+
+    let context = module.get_context();
+    let func = module.add_function(
+        RUNTIME_GLOBALS_FUNC_NAME,
+        &get_runtime_globals_type(&context)
+            .ptr_type(AddressSpace::Generic)
+            .fn_type(&[], false),
+        Some(&Linkage::ExternalLinkage),
+    );
+
+    func.add_attribute(context.get_enum_attr(AttrKind::NoUnwind, 0));
+    func
+}
+
+// Runtimes sharing code each have their own sample rate, BPM and noise streams, so they're looked
+// up from the runtime running the code instead of being globals in the library.
+fn get_runtime_global(module: &Module, builder: &Builder, index: u32, name: &str) -> PointerValue {
+    let globals_ptr = builder
+        .build_call(
+            &get_runtime_globals_func(module),
+            &[],
+            "runtime.globals",
+            false,
+        ).left()
+        .unwrap()
+        .into_pointer_value();
+    unsafe { builder.build_struct_gep(&globals_ptr, index, name) }
+}
+
+pub fn get_sample_rate(module: &Module, builder: &Builder) -> PointerValue {
+    get_runtime_global(module, builder, 0, "samplerate.ptr")
+}
+
+pub fn get_bpm(module: &Module, builder: &Builder) -> PointerValue {
+    get_runtime_global(module, builder, 1, "bpm.ptr")
+}
+
+// Pointer to the pool extracted voices are run on, or null if they should be run in a loop on the
+// calling thread.
+pub fn get_worker_pool(module: &Module) -> GlobalValue {
     util::get_or_create_global(
         module,
-        SAMPLERATE_GLOBAL_NAME,
-        &module.get_context().f32_type().vec_type(2),
+        WORKER_POOL_GLOBAL_NAME,
+        &module
+            .get_context()
+            .i8_type()
+            .ptr_type(AddressSpace::Generic),
     )
 }
 
-pub fn get_bpm(module: &Module) -> GlobalValue {
+// Pointer to the pool sample buffers are allocated from, so they can be resized on the audio
+// thread.
+pub fn get_buffer_pool(module: &Module) -> GlobalValue {
     util::get_or_create_global(
         module,
-        BPM_GLOBAL_NAME,
-        &module.get_context().f32_type().vec_type(2),
+        BUFFER_POOL_GLOBAL_NAME,
+        &module
+            .get_context()
+            .i8_type()
+            .ptr_type(AddressSpace::Generic),
     )
 }
 
+// The seed every noise generator's stream is derived from.
+pub fn get_noise_seed(module: &Module, builder: &Builder) -> PointerValue {
+    get_runtime_global(module, builder, 2, "noiseseed.ptr")
+}
+
+// The stream the next noise generator to be constructed gets. Generators are constructed in the
+// same order each time the same patch is built, so they get the same streams.
+pub fn get_noise_stream(module: &Module, builder: &Builder) -> PointerValue {
+    get_runtime_global(module, builder, 3, "noisestream.ptr")
+}
+
 pub fn build_globals(module: &Module) {
-    get_sample_rate(module).set_initializer(&util::get_vec_spread(&module.get_context(), 44100.));
-    get_bpm(module).set_initializer(&util::get_vec_spread(&module.get_context(), 60.));
+    get_worker_pool(module).set_initializer(
+        &module
+            .get_context()
+            .i8_type()
+            .ptr_type(AddressSpace::Generic)
+            .const_null(),
+    );
+    get_buffer_pool(module).set_initializer(
+        &module
+            .get_context()
+            .i8_type()
+            .ptr_type(AddressSpace::Generic)
+            .const_null(),
+    );
 }
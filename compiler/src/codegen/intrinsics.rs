@@ -24,18 +24,66 @@ pub fn memcpy(module: &Module) -> FunctionValue {
     })
 }
 
-pub fn realloc(module: &Module, target: &TargetData) -> FunctionValue {
-    util::get_or_create_func(module, "realloc", false, &|| {
-        let ptr_type = module
-            .get_context()
-            .i8_type()
-            .ptr_type(AddressSpace::Generic);
+/// Resizes a sample buffer from the buffer pool without calling the system allocator, implemented
+/// by the runtime.
+pub const RESIZE_BUFFER_FUNC_NAME: &str = "maxim_resize_buffer";
+
+/// Returns a sample buffer to the buffer pool, implemented by the runtime.
+pub const FREE_BUFFER_FUNC_NAME: &str = "maxim_free_buffer";
+
+/// Has the buffer pool get buffers of a size ready ahead of them being asked for, implemented by
+/// the runtime. Calls the system allocator, so it's only used while constructing.
+pub const PREPARE_BUFFER_FUNC_NAME: &str = "maxim_prepare_buffer";
+
+/// Pooled buffers hold a power of two samples, up to 2^MAX_BUFFER_SIZE_CLASS. That's over a
+/// minute at 192kHz, and 64MB per buffer.
+pub const MAX_BUFFER_SIZE_CLASS: usize = 24;
+
+pub fn resize_buffer(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, RESIZE_BUFFER_FUNC_NAME, false, &|| {
+        let context = module.get_context();
+        let buffer_ptr_type = context.f32_type().ptr_type(AddressSpace::Generic);
         (
             Linkage::ExternalLinkage,
-            ptr_type.fn_type(
+            context.i8_type().fn_type(
                 &[
-                    &ptr_type,
-                    &target.int_ptr_type_in_context(&module.get_context()),
+                    &context.i8_type().ptr_type(AddressSpace::Generic), // pool
+                    &buffer_ptr_type.ptr_type(AddressSpace::Generic),   // buffer pointer
+                    &context.i64_type(),                                // old size
+                    &context.i64_type(),                                // new size
+                ],
+                false,
+            ),
+        )
+    })
+}
+
+pub fn free_buffer(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, FREE_BUFFER_FUNC_NAME, false, &|| {
+        let context = module.get_context();
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(
+                &[
+                    &context.i8_type().ptr_type(AddressSpace::Generic), // pool
+                    &context.f32_type().ptr_type(AddressSpace::Generic), // buffer
+                    &context.i64_type(),                                // size
+                ],
+                false,
+            ),
+        )
+    })
+}
+
+pub fn prepare_buffer(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, PREPARE_BUFFER_FUNC_NAME, false, &|| {
+        let context = module.get_context();
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(
+                &[
+                    &context.i8_type().ptr_type(AddressSpace::Generic), // pool
+                    &context.i64_type(),                                // size
                 ],
                 false,
             ),
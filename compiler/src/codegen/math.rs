@@ -0,0 +1,635 @@
+//! Polynomial approximations of the transcendental functions used in generated code.
+//!
+//! The LLVM intrinsics for these (`llvm.pow`, `llvm.sin` etc) are lowered to calls to the
+//! scalar libm functions, once for each lane, which the optimizer can't inline or vectorize.
+//! These are built into each module that uses them as private functions made of plain arithmetic
+//! and bit manipulation, so they're inlined into the caller and vectorized with the code around
+//! them. They have the same signatures as the intrinsics they replace.
+//!
+//! The log functions give negative infinity for zero and NaN for negative inputs, like the
+//! intrinsics, but otherwise the approximations assume finite, normal inputs: infinities, NaNs and
+//! denormals give meaningless results, and `exp` saturates instead of overflowing. Large inputs to
+//! `sin` and `cos` lose precision in the range reduction, the same as with single-precision libm
+//! functions. Because of this, the block functions patches call directly (`sin`, `log` etc) still
+//! use the intrinsics, and these are only used where the inputs are known to be in range.
+
+use codegen::{intrinsics, util};
+use inkwell::attribute::AttrKind;
+use inkwell::builder::Builder;
+use inkwell::context::Context;
+use inkwell::module::{Linkage, Module};
+use inkwell::types::BasicType;
+use inkwell::values::{BasicValue, FunctionValue, VectorValue};
+use inkwell::FloatPredicate;
+use std::f32::{self, consts};
+
+/// How accurate an approximation needs to be. Cheaper approximations use polynomials of a lower
+/// degree.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Precision {
+    /// Within about 1e-4 of the exact result, for modulation and curves where the error can't be
+    /// heard.
+    Fast,
+    /// Within about 2e-7 of the exact result, which is close to the limit of single precision.
+    /// `sin` and `cos` are within about 4e-7, since the range reduction rounds.
+    Accurate,
+}
+
+impl Precision {
+    fn name(self) -> &'static str {
+        match self {
+            Precision::Fast => "fast",
+            Precision::Accurate => "accurate",
+        }
+    }
+
+    // Coefficients of 2^x in [0, 1).
+    fn exp2_coefficients(self) -> &'static [f32] {
+        match self {
+            Precision::Fast => &[1., 0.695_116_76, 0.227_645, 0.077_067_04],
+            Precision::Accurate => &[
+                1.,
+                0.693_151_3,
+                0.240_164_44,
+                0.055_799_913,
+                0.009_017_03,
+                0.001_867_130_2,
+            ],
+        }
+    }
+
+    // Coefficients of log2(1 + x) / x in [sqrt(0.5) - 1, sqrt(2) - 1).
+    fn log2_coefficients(self) -> &'static [f32] {
+        match self {
+            Precision::Fast => &[
+                1.442_646_3,
+                -0.720_554_95,
+                0.485_306_53,
+                -0.390_892_42,
+                0.254_751_74,
+            ],
+            Precision::Accurate => &[
+                1.442_694_9,
+                -0.721_352_8,
+                0.480_923_24,
+                -0.360_239_63,
+                0.287_098_7,
+                -0.248_876_87,
+                0.234_042_33,
+                -0.145_811_62,
+            ],
+        }
+    }
+
+    // Coefficients of sin(2 * pi * x) / x in terms of x^2, for x in [-0.25, 0.25].
+    fn sin_coefficients(self) -> &'static [f32] {
+        match self {
+            Precision::Fast => &[6.281_28, -41.095_24, 73.585_52],
+            Precision::Accurate => &[6.283_185, -41.341_656, 81.601_006, -76.549_79, 39.536_78],
+        }
+    }
+}
+
+pub fn exp2_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "exp2", precision, 1, &|b, context, args| {
+        gen_exp2(b, module, context, precision, args[0])
+    })
+}
+
+pub fn exp_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "exp", precision, 1, &|b, context, args| {
+        let exponent =
+            b.build_float_mul(args[0], util::get_vec_spread(context, consts::LOG2_E), "");
+        gen_exp2(b, module, context, precision, exponent)
+    })
+}
+
+pub fn log2_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "log2", precision, 1, &|b, context, args| {
+        let log2 = gen_log2(b, context, precision, args[0]);
+        gen_log_special_cases(b, context, args[0], log2)
+    })
+}
+
+pub fn log_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "log", precision, 1, &|b, context, args| {
+        let log2 = gen_log2(b, context, precision, args[0]);
+        let log = b.build_float_mul(log2, util::get_vec_spread(context, consts::LN_2), "");
+        gen_log_special_cases(b, context, args[0], log)
+    })
+}
+
+pub fn log10_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "log10", precision, 1, &|b, context, args| {
+        let log2 = gen_log2(b, context, precision, args[0]);
+        let log10 = b.build_float_mul(
+            log2,
+            util::get_vec_spread(context, consts::LN_2 / consts::LN_10),
+            "",
+        );
+        gen_log_special_cases(b, context, args[0], log10)
+    })
+}
+
+/// Only defined for bases that are zero or positive, unlike `llvm.pow`. Negative bases are
+/// treated as their absolute value.
+pub fn pow_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "pow", precision, 2, &|b, context, args| {
+        let (base, exponent) = (args[0], args[1]);
+        let log2 = gen_log2(b, context, precision, base);
+        let result = gen_exp2(
+            b,
+            module,
+            context,
+            precision,
+            b.build_float_mul(exponent, log2, ""),
+        );
+
+        // log2 of zero isn't infinite here, so zero bases are handled separately: 0^0 is 1, and 0
+        // to the power of anything else is 0
+        let zero_vec = util::get_vec_spread(context, 0.);
+        let zero_result = b
+            .build_select(
+                b.build_float_compare(FloatPredicate::OEQ, exponent, zero_vec, "exponentzero"),
+                util::get_vec_spread(context, 1.),
+                zero_vec,
+                "",
+            ).into_vector_value();
+        b.build_select(
+            b.build_float_compare(FloatPredicate::OEQ, base, zero_vec, "basezero"),
+            zero_result,
+            result,
+            "",
+        ).into_vector_value()
+    })
+}
+
+pub fn sin_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "sin", precision, 1, &|b, context, args| {
+        gen_sin(b, module, context, precision, args[0], 0.)
+    })
+}
+
+pub fn cos_v2f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_func(module, "cos", precision, 1, &|b, context, args| {
+        gen_sin(b, module, context, precision, args[0], 0.25)
+    })
+}
+
+pub fn pow_f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_scalar_func(module, pow_v2f32(module, precision))
+}
+
+pub fn sin_f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_scalar_func(module, sin_v2f32(module, precision))
+}
+
+pub fn cos_f32(module: &Module, precision: Precision) -> FunctionValue {
+    get_or_build_scalar_func(module, cos_v2f32(module, precision))
+}
+
+fn get_or_build_func(
+    module: &Module,
+    name: &str,
+    precision: Precision,
+    param_count: usize,
+    build: &Fn(&Builder, &Context, &[VectorValue]) -> VectorValue,
+) -> FunctionValue {
+    let func_name = format!("maxim.math.{}.{}.v2f32", name, precision.name());
+    if let Some(func) = module.get_function(&func_name) {
+        return func;
+    }
+
+    let context = module.get_context();
+    let v2f32_type = context.f32_type().vec_type(2);
+    let param_types: Vec<_> = (0..param_count)
+        .map(|_| &v2f32_type as &BasicType)
+        .collect();
+    let func = module.add_function(
+        &func_name,
+        &v2f32_type.fn_type(&param_types, false),
+        Some(&Linkage::PrivateLinkage),
+    );
+    func.add_attribute(context.get_enum_attr(AttrKind::AlwaysInline, 0));
+
+    let entry_block = context.append_basic_block(&func, "entry");
+    let builder = context.create_builder();
+    builder.set_fast_math_all();
+    builder.position_at_end(&entry_block);
+
+    let params: Vec<_> = (0..param_count)
+        .map(|index| func.get_nth_param(index as u32).unwrap().into_vector_value())
+        .collect();
+    let result = build(&builder, &context, &params);
+    builder.build_return(Some(&result));
+
+    func
+}
+
+// Builds a scalar version of a vector function, which runs it with the value in both lanes.
+fn get_or_build_scalar_func(module: &Module, vector_func: FunctionValue) -> FunctionValue {
+    let vector_name = vector_func.get_name().to_str().unwrap().to_string();
+    let func_name = format!("{}f32", vector_name.trim_right_matches("v2f32"));
+    if let Some(func) = module.get_function(&func_name) {
+        return func;
+    }
+
+    let context = module.get_context();
+    let f32_type = context.f32_type();
+    let param_count = vector_func.count_params();
+    let param_types: Vec<_> = (0..param_count).map(|_| &f32_type as &BasicType).collect();
+    let func = module.add_function(
+        &func_name,
+        &f32_type.fn_type(&param_types, false),
+        Some(&Linkage::PrivateLinkage),
+    );
+    func.add_attribute(context.get_enum_attr(AttrKind::AlwaysInline, 0));
+
+    let entry_block = context.append_basic_block(&func, "entry");
+    let builder = context.create_builder();
+    builder.set_fast_math_all();
+    builder.position_at_end(&entry_block);
+
+    let vector_params: Vec<_> = (0..param_count)
+        .map(|index| {
+            let param = func.get_nth_param(index).unwrap().into_float_value();
+            util::splat_vector(&builder, param, "")
+        }).collect();
+    let vector_args: Vec<_> = vector_params
+        .iter()
+        .map(|param| param as &BasicValue)
+        .collect();
+    let vector_result = builder
+        .build_call(&vector_func, &vector_args, "", false)
+        .left()
+        .unwrap()
+        .into_vector_value();
+    let result = builder.build_extract_element(
+        &vector_result,
+        &context.i32_type().const_int(0, false),
+        "",
+    );
+    builder.build_return(Some(&result));
+
+    func
+}
+
+// Evaluates a polynomial with Horner's method. Coefficients are in order of increasing degree.
+fn gen_polynomial(
+    builder: &Builder,
+    context: &Context,
+    coefficients: &[f32],
+    x: VectorValue,
+) -> VectorValue {
+    let (last, rest) = coefficients.split_last().unwrap();
+    rest.iter()
+        .rev()
+        .fold(util::get_vec_spread(context, *last), |acc, coefficient| {
+            builder.build_float_add(
+                builder.build_float_mul(acc, x, ""),
+                util::get_vec_spread(context, *coefficient),
+                "",
+            )
+        })
+}
+
+// 2^x is split into 2^floor(x), which is built directly as a float's exponent bits, and 2^fract(x),
+// which is approximated.
+fn gen_exp2(
+    builder: &Builder,
+    module: &Module,
+    context: &Context,
+    precision: Precision,
+    x: VectorValue,
+) -> VectorValue {
+    let min_intrinsic = intrinsics::minnum_v2f32(module);
+    let max_intrinsic = intrinsics::maxnum_v2f32(module);
+    let floor_intrinsic = intrinsics::floor_v2f32(module);
+
+    // keep the exponent in the range of normal floats
+    let clamped_x = builder
+        .build_call(
+            &max_intrinsic,
+            &[
+                &builder
+                    .build_call(
+                        &min_intrinsic,
+                        &[&x, &util::get_vec_spread(context, 127.)],
+                        "",
+                        false,
+                    ).left()
+                    .unwrap()
+                    .into_vector_value(),
+                &util::get_vec_spread(context, -126.),
+            ],
+            "clamped",
+            false,
+        ).left()
+        .unwrap()
+        .into_vector_value();
+
+    let whole = builder
+        .build_call(&floor_intrinsic, &[&clamped_x], "whole", false)
+        .left()
+        .unwrap()
+        .into_vector_value();
+    let fract = builder.build_float_sub(clamped_x, whole, "fract");
+
+    let i32_vec_type = context.i32_type().vec_type(2);
+    let whole_int = builder.build_float_to_signed_int(whole, i32_vec_type, "whole.int");
+    let scale_bits = builder.build_left_shift(
+        builder.build_int_add(whole_int, util::get_int_vec_spread(context, 127), ""),
+        util::get_int_vec_spread(context, 23),
+        "scale.bits",
+    );
+    let scale = builder
+        .build_bitcast(scale_bits, context.f32_type().vec_type(2), "scale")
+        .into_vector_value();
+
+    builder.build_float_mul(
+        gen_polynomial(builder, context, precision.exp2_coefficients(), fract),
+        scale,
+        "",
+    )
+}
+
+// log2(x) is split into the float's exponent and log2 of its mantissa, which is approximated. The
+// mantissa is moved into [sqrt(0.5), sqrt(2)) so the polynomial is centered on 1, where its error
+// is smallest. The sign is ignored, and zero gives -127 instead of negative infinity.
+fn gen_log2(
+    builder: &Builder,
+    context: &Context,
+    precision: Precision,
+    x: VectorValue,
+) -> VectorValue {
+    let i32_vec_type = context.i32_type().vec_type(2);
+    let f32_vec_type = context.f32_type().vec_type(2);
+
+    let bits = builder
+        .build_bitcast(x, i32_vec_type, "bits")
+        .into_vector_value();
+    let exponent_bits = builder.build_and(
+        builder.build_right_shift(bits, util::get_int_vec_spread(context, 23), false, ""),
+        util::get_int_vec_spread(context, 0xFF),
+        "exponent.bits",
+    );
+    let mantissa_bits = builder.build_or(
+        builder.build_and(bits, util::get_int_vec_spread(context, 0x7F_FFFF), ""),
+        util::get_int_vec_spread(context, 0x3F80_0000),
+        "mantissa.bits",
+    );
+    let mantissa = builder
+        .build_bitcast(mantissa_bits, f32_vec_type, "mantissa")
+        .into_vector_value();
+
+    let is_large = builder.build_float_compare(
+        FloatPredicate::OGT,
+        mantissa,
+        util::get_vec_spread(context, consts::SQRT_2),
+        "mantissa.large",
+    );
+    let mantissa = builder
+        .build_select(
+            is_large,
+            builder.build_float_mul(mantissa, util::get_vec_spread(context, 0.5), ""),
+            mantissa,
+            "mantissa.centered",
+        ).into_vector_value();
+    let exponent = builder.build_signed_int_to_float(
+        builder.build_int_add(
+            builder.build_int_sub(exponent_bits, util::get_int_vec_spread(context, 127), ""),
+            builder.build_int_z_extend(is_large, i32_vec_type, ""),
+            "",
+        ),
+        f32_vec_type,
+        "exponent",
+    );
+
+    let t = builder.build_float_sub(mantissa, util::get_vec_spread(context, 1.), "t");
+    builder.build_float_add(
+        exponent,
+        builder.build_float_mul(
+            t,
+            gen_polynomial(builder, context, precision.log2_coefficients(), t),
+            "",
+        ),
+        "",
+    )
+}
+
+// Gives negative infinity for zero inputs and NaN for negative ones, which `gen_log2` doesn't.
+fn gen_log_special_cases(
+    builder: &Builder,
+    context: &Context,
+    x: VectorValue,
+    log: VectorValue,
+) -> VectorValue {
+    let zero_vec = util::get_vec_spread(context, 0.);
+    let log = builder
+        .build_select(
+            builder.build_float_compare(FloatPredicate::OLT, x, zero_vec, "negative"),
+            util::get_vec_spread(context, f32::NAN),
+            log,
+            "",
+        ).into_vector_value();
+    builder
+        .build_select(
+            builder.build_float_compare(FloatPredicate::OEQ, x, zero_vec, "zero"),
+            util::get_vec_spread(context, f32::NEG_INFINITY),
+            log,
+            "",
+        ).into_vector_value()
+}
+
+// The input is converted to turns and reduced to [-0.5, 0.5], then folded into [-0.25, 0.25]
+// using sin(pi - x) = sin(x), where the approximation is made. Cosine is a sine a quarter turn
+// ahead.
+fn gen_sin(
+    builder: &Builder,
+    module: &Module,
+    context: &Context,
+    precision: Precision,
+    x: VectorValue,
+    turn_offset: f32,
+) -> VectorValue {
+    let floor_intrinsic = intrinsics::floor_v2f32(module);
+    let fabs_intrinsic = intrinsics::fabs_v2f32(module);
+    let copysign_intrinsic = intrinsics::copysign_v2f32(module);
+
+    let turns = builder.build_float_add(
+        builder.build_float_mul(x, util::get_vec_spread(context, 0.5 / consts::PI), ""),
+        util::get_vec_spread(context, turn_offset),
+        "turns",
+    );
+    let nearest_turn = builder
+        .build_call(
+            &floor_intrinsic,
+            &[&builder.build_float_add(turns, util::get_vec_spread(context, 0.5), "")],
+            "",
+            false,
+        ).left()
+        .unwrap()
+        .into_vector_value();
+    let reduced = builder.build_float_sub(turns, nearest_turn, "reduced");
+
+    let reduced_abs = builder
+        .build_call(&fabs_intrinsic, &[&reduced], "", false)
+        .left()
+        .unwrap()
+        .into_vector_value();
+    let half_turn = builder
+        .build_call(
+            &copysign_intrinsic,
+            &[&util::get_vec_spread(context, 0.5), &reduced],
+            "",
+            false,
+        ).left()
+        .unwrap()
+        .into_vector_value();
+    let folded = builder
+        .build_select(
+            builder.build_float_compare(
+                FloatPredicate::OGT,
+                reduced_abs,
+                util::get_vec_spread(context, 0.25),
+                "",
+            ),
+            builder.build_float_sub(half_turn, reduced, ""),
+            reduced,
+            "folded",
+        ).into_vector_value();
+
+    let folded_squared = builder.build_float_mul(folded, folded, "");
+    builder.build_float_mul(
+        folded,
+        gen_polynomial(
+            builder,
+            context,
+            precision.sin_coefficients(),
+            folded_squared,
+        ),
+        "",
+    )
+}
+
+#[cfg(test)]
+mod tests {
+    use super::Precision;
+    use std::f32::consts;
+
+    // Scalar versions of the generated functions, which make the same single-precision operations
+    // in the same order, so the tests check the coefficients with the rounding the generated code
+    // has.
+    fn polynomial(coefficients: &[f32], x: f32) -> f32 {
+        let (last, rest) = coefficients.split_last().unwrap();
+        rest.iter()
+            .rev()
+            .fold(*last, |acc, coefficient| acc * x + coefficient)
+    }
+
+    fn exp2(precision: Precision, x: f32) -> f32 {
+        let clamped_x = x.min(127.).max(-126.);
+        let whole = clamped_x.floor();
+        let scale = f32::from_bits(((whole as i32 + 127) << 23) as u32);
+        polynomial(precision.exp2_coefficients(), clamped_x - whole) * scale
+    }
+
+    fn log2(precision: Precision, x: f32) -> f32 {
+        let bits = x.to_bits() as i32;
+        let exponent_bits = (bits >> 23) & 0xFF;
+        let mantissa = f32::from_bits(((bits & 0x7F_FFFF) | 0x3F80_0000) as u32);
+        let is_large = mantissa > consts::SQRT_2;
+        let mantissa = if is_large { mantissa * 0.5 } else { mantissa };
+        let exponent = (exponent_bits - 127 + is_large as i32) as f32;
+        let t = mantissa - 1.;
+        exponent + t * polynomial(precision.log2_coefficients(), t)
+    }
+
+    fn sin(precision: Precision, x: f32, turn_offset: f32) -> f32 {
+        let turns = x * (0.5 / consts::PI) + turn_offset;
+        let reduced = turns - (turns + 0.5).floor();
+        let folded = if reduced.abs() > 0.25 {
+            if reduced < 0. {
+                -0.5 - reduced
+            } else {
+                0.5 - reduced
+            }
+        } else {
+            reduced
+        };
+        folded * polynomial(precision.sin_coefficients(), folded * folded)
+    }
+
+    const SAMPLE_COUNT: usize = 100_000;
+
+    fn max_error(
+        start: f64,
+        end: f64,
+        approximate: &Fn(f32) -> f32,
+        exact: &Fn(f64) -> f64,
+        error: &Fn(f64, f64) -> f64,
+    ) -> f64 {
+        (0..=SAMPLE_COUNT)
+            .map(|index| {
+                let x = (start + (end - start) * index as f64 / SAMPLE_COUNT as f64) as f32;
+                error(approximate(x) as f64, exact(x as f64))
+            }).fold(0., f64::max)
+    }
+
+    fn absolute_error(approximate: f64, exact: f64) -> f64 {
+        (approximate - exact).abs()
+    }
+
+    fn relative_error(approximate: f64, exact: f64) -> f64 {
+        (approximate / exact - 1.).abs()
+    }
+
+    fn check_bounds(precision: Precision, bound: f64, sin_bound: f64) {
+        let exp2_error = max_error(
+            -20.,
+            20.,
+            &|x| exp2(precision, x),
+            &|x| x.exp2(),
+            &relative_error,
+        );
+        assert!(exp2_error < bound, "exp2 error is {}", exp2_error);
+
+        // past this range, the error is dominated by rounding the exponent into the result
+        let log2_error = max_error(
+            0.5,
+            2.,
+            &|x| log2(precision, x),
+            &|x| x.log2(),
+            &absolute_error,
+        );
+        assert!(log2_error < bound, "log2 error is {}", log2_error);
+
+        let pi = consts::PI as f64;
+        let sin_error = max_error(
+            -pi,
+            pi,
+            &|x| sin(precision, x, 0.),
+            &|x| x.sin(),
+            &absolute_error,
+        );
+        assert!(sin_error < sin_bound, "sin error is {}", sin_error);
+        let cos_error = max_error(
+            -pi,
+            pi,
+            &|x| sin(precision, x, 0.25),
+            &|x| x.cos(),
+            &absolute_error,
+        );
+        assert!(cos_error < sin_bound, "cos error is {}", cos_error);
+    }
+
+    #[test]
+    fn fast_is_within_bounds() {
+        check_bounds(Precision::Fast, 1e-4, 1e-4);
+    }
+
+    #[test]
+    fn accurate_is_within_bounds() {
+        check_bounds(Precision::Accurate, 2e-7, 4e-7);
+    }
+}
@@ -7,6 +7,7 @@ pub mod editor;
 pub mod functions;
 pub mod globals;
 pub mod intrinsics;
+pub mod math;
 mod object_cache;
 mod optimizer;
 pub mod root;
@@ -18,7 +19,7 @@ pub mod values;
 pub use self::builder_context::{build_context_function, BuilderContext};
 pub use self::object_cache::ObjectCache;
 pub use self::optimizer::Optimizer;
-pub use self::target_properties::TargetProperties;
+pub use self::target_properties::{HostMachine, OptimizationProfile, TargetProperties};
 
 use std::fmt;
 
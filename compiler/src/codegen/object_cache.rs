@@ -14,4 +14,11 @@ pub trait ObjectCache {
     fn block_mir(&self, id: BlockRef) -> Option<&Block>;
 
     fn block_layout(&self, id: BlockRef) -> Option<&data_analyzer::BlockLayout>;
+
+    // Keys identify the code built for an object by its content, and are included in symbol names.
+    // This lets a changed object be deployed alongside the code that's still running, and lets
+    // runtimes share code for objects that are the same.
+    fn surface_key(&self, id: SurfaceRef) -> u64;
+
+    fn block_key(&self, id: BlockRef) -> u64;
 }
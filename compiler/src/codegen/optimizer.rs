@@ -1,83 +1,95 @@
-use codegen::TargetProperties;
+use codegen::{HostMachine, OptimizationProfile};
+use ffi;
 use inkwell::module::Module;
-use inkwell::passes::{PassManager, PassManagerBuilder};
-use inkwell::values::FunctionValue;
-use inkwell::OptimizationLevel;
 
-struct ModuleFunctionIterator {
-    next_func: Option<FunctionValue>,
+// Modules are optimized on the compiler threads after they've been read back from bitcode, so the
+// optimizer works on raw modules and pass managers rather than inkwell's.
+#[derive(Debug)]
+pub struct Optimizer<'a> {
+    machine: &'a HostMachine,
+    module_pass: ffi::LLVMPassManagerRef,
+    builder: ffi::LLVMPassManagerBuilderRef,
 }
 
-impl ModuleFunctionIterator {
-    pub fn new(module: &Module) -> ModuleFunctionIterator {
-        ModuleFunctionIterator {
-            next_func: module.get_first_function(),
-        }
-    }
-}
+impl<'a> Optimizer<'a> {
+    pub fn new(profile: OptimizationProfile, machine: &'a HostMachine) -> Self {
+        unsafe {
+            let builder = ffi::LLVMPassManagerBuilderCreate();
 
-impl Iterator for ModuleFunctionIterator {
-    type Item = FunctionValue;
+            match profile {
+                OptimizationProfile::Size => {
+                    ffi::LLVMPassManagerBuilderSetOptLevel(builder, 2);
+                    ffi::LLVMPassManagerBuilderSetSizeLevel(builder, 2);
 
-    fn next(&mut self) -> Option<FunctionValue> {
-        match self.next_func {
-            Some(func) => {
-                self.next_func = func.get_next_function();
-                Some(func)
-            }
-            None => None,
-        }
-    }
-}
-
-#[derive(Debug)]
-pub struct Optimizer {
-    module_pass: PassManager,
-    builder: PassManagerBuilder,
-}
+                    // threshold for -Oz, see http://llvm.org/doxygen/InlineCost_8h_source.html
+                    ffi::LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 5);
 
-impl Optimizer {
-    pub fn new(target: &TargetProperties) -> Self {
-        let builder = PassManagerBuilder::create();
+                    // vectorizing grows code, so it's left off like in -Oz
+                    ffi::LLVMAxiomPassManagerBuilderSetVectorize(builder, false, false);
+                }
+                OptimizationProfile::Balanced => {
+                    ffi::LLVMPassManagerBuilderSetOptLevel(builder, 2);
+                    ffi::LLVMPassManagerBuilderSetSizeLevel(builder, 0);
 
-        if target.min_size {
-            builder.set_optimization_level(OptimizationLevel::Default);
-            builder.set_size_level(2);
+                    // threshold for -O2, see http://llvm.org/doxygen/InlineCost_8h_source.html
+                    ffi::LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 225);
+                    ffi::LLVMAxiomPassManagerBuilderSetVectorize(builder, true, true);
+                }
+                OptimizationProfile::Speed => {
+                    ffi::LLVMPassManagerBuilderSetOptLevel(builder, 3);
+                    ffi::LLVMPassManagerBuilderSetSizeLevel(builder, 0);
 
-            // threshold for -Oz, see http://llvm.org/doxygen/InlineCost_8h_source.html
-            builder.set_inliner_with_threshold(5);
-        } else {
-            builder.set_optimization_level(OptimizationLevel::Aggressive);
-            builder.set_size_level(0);
-
-            // threshold for -O3, see http://llvm.org/doxygen/InlineCost_8h_source.html
-            builder.set_inliner_with_threshold(250);
-        }
+                    // threshold for -O3, see http://llvm.org/doxygen/InlineCost_8h_source.html
+                    ffi::LLVMPassManagerBuilderUseInlinerWithThreshold(builder, 250);
+                    ffi::LLVMAxiomPassManagerBuilderSetVectorize(builder, true, true);
+                }
+            }
 
-        let module_pass = PassManager::create_for_module();
-        builder.populate_module_pass_manager(&module_pass);
-        target.machine.add_analysis_passes(&module_pass);
+            // the target's analysis passes are added first, so the vectorizers and other passes
+            // that ask for target information get the host's instead of the defaults
+            let module_pass = ffi::LLVMCreatePassManager();
+            ffi::LLVMAddAnalysisPasses(machine.as_raw(), module_pass);
+            ffi::LLVMPassManagerBuilderPopulateModulePassManager(builder, module_pass);
 
-        Optimizer {
-            module_pass,
-            builder,
+            Optimizer {
+                machine,
+                module_pass,
+                builder,
+            }
         }
     }
 
-    pub fn optimize_module(&self, module: &Module) {
+    pub fn verify_module(module: &Module) {
         if let Err(err) = module.verify() {
             module.print_to_stderr();
             panic!(err.to_string());
         }
+    }
+
+    /// Optimizes a module that's only used by this thread.
+    pub unsafe fn optimize_module(&self, module: ffi::LLVMModuleRef) {
+        let func_pass = ffi::LLVMCreateFunctionPassManagerForModule(module);
+        ffi::LLVMAddAnalysisPasses(self.machine.as_raw(), func_pass);
+        ffi::LLVMPassManagerBuilderPopulateFunctionPassManager(self.builder, func_pass);
+
+        ffi::LLVMInitializeFunctionPassManager(func_pass);
+        let mut func = ffi::LLVMGetFirstFunction(module);
+        while !func.is_null() {
+            ffi::LLVMRunFunctionPassManager(func_pass, func);
+            func = ffi::LLVMGetNextFunction(func);
+        }
+        ffi::LLVMFinalizeFunctionPassManager(func_pass);
+        ffi::LLVMDisposePassManager(func_pass);
 
-        let func_pass = PassManager::create_for_function(module);
-        self.builder.populate_function_pass_manager(&func_pass);
+        ffi::LLVMRunPassManager(self.module_pass, module);
+    }
+}
 
-        func_pass.initialize();
-        let func_iterator = ModuleFunctionIterator::new(module);
-        for func in func_iterator {
-            func_pass.run_on_function(&func);
+impl<'a> Drop for Optimizer<'a> {
+    fn drop(&mut self) {
+        unsafe {
+            ffi::LLVMDisposePassManager(self.module_pass);
+            ffi::LLVMPassManagerBuilderDispose(self.builder);
         }
-        self.module_pass.run_on_module(module);
     }
 }
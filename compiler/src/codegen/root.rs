@@ -1,11 +1,13 @@
 use codegen::data_analyzer::{PointerSource, PointerSourceAggregateType};
 use codegen::values::remap_type;
-use codegen::{build_context_function, surface, util, BuilderContext, LifecycleFunc, ObjectCache};
+use codegen::{
+    build_context_function, surface, util, values, BuilderContext, LifecycleFunc, ObjectCache,
+};
 use inkwell::context::Context;
 use inkwell::module::{Linkage, Module};
-use inkwell::types::BasicType;
+use inkwell::types::{BasicType, StructType};
 use inkwell::values::{BasicValue, BasicValueEnum, GlobalValue, IntValue, PointerValue};
-use inkwell::AddressSpace;
+use inkwell::{AddressSpace, IntPredicate};
 use mir::{Root, SurfaceRef};
 use std::iter;
 
@@ -228,3 +230,230 @@ pub fn build_funcs(
         pointers,
     );
 }
+
+/// Returns the type of a portal buffer binding. This is a pointer to the portal's socket, pointers
+/// to the left and right channel sample arrays to read from or write to, and the form to give
+/// values read into the portal.
+pub fn get_portal_buffer_type(context: &Context) -> StructType {
+    let channel_ptr_type = context.f32_type().ptr_type(AddressSpace::Generic);
+    context.struct_type(
+        &[
+            &context.i8_type().ptr_type(AddressSpace::Generic),
+            &channel_ptr_type,
+            &channel_ptr_type,
+            &context.i8_type(),
+        ],
+        false,
+    )
+}
+
+fn build_portal_buffer_copy(
+    ctx: &mut BuilderContext,
+    buffers: PointerValue,
+    buffer_count: IntValue,
+    frame_index: IntValue,
+    copy_to_portal: bool,
+) {
+    let index_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i32_type(), "bufferindex.ptr");
+    ctx.b
+        .build_store(&index_ptr, &ctx.context.i32_type().const_int(0, false));
+
+    let check_block = ctx.context.append_basic_block(&ctx.func, "buffer.check");
+    let run_block = ctx.context.append_basic_block(&ctx.func, "buffer.run");
+    let end_block = ctx.context.append_basic_block(&ctx.func, "buffer.end");
+
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&check_block);
+
+    let current_index = ctx.b.build_load(&index_ptr, "bufferindex").into_int_value();
+    let can_continue_loop = ctx.b.build_int_compare(
+        IntPredicate::ULT,
+        current_index,
+        buffer_count,
+        "cancontinue",
+    );
+    ctx.b
+        .build_conditional_branch(&can_continue_loop, &run_block, &end_block);
+    ctx.b.position_at_end(&run_block);
+
+    let buffer_ptr = unsafe { ctx.b.build_in_bounds_gep(&buffers, &[current_index], "buffer") };
+    let portal_ptr = ctx
+        .b
+        .build_load(
+            &unsafe { ctx.b.build_struct_gep(&buffer_ptr, 0, "buffer.portal.ptr") },
+            "buffer.portal",
+        ).into_pointer_value();
+    let left_channel = ctx
+        .b
+        .build_load(
+            &unsafe { ctx.b.build_struct_gep(&buffer_ptr, 1, "buffer.left.ptr") },
+            "buffer.left",
+        ).into_pointer_value();
+    let right_channel = ctx
+        .b
+        .build_load(
+            &unsafe { ctx.b.build_struct_gep(&buffer_ptr, 2, "buffer.right.ptr") },
+            "buffer.right",
+        ).into_pointer_value();
+    let left_ptr = unsafe {
+        ctx.b
+            .build_in_bounds_gep(&left_channel, &[frame_index], "buffer.left.sample.ptr")
+    };
+    let right_ptr = unsafe {
+        ctx.b
+            .build_in_bounds_gep(&right_channel, &[frame_index], "buffer.right.sample.ptr")
+    };
+
+    let portal_num = values::NumValue::new(ctx.b.build_pointer_cast(
+        portal_ptr,
+        values::NumValue::get_type(ctx.context).ptr_type(AddressSpace::Generic),
+        "portal.num",
+    ));
+    let left_index = ctx.context.i32_type().const_int(0, false);
+    let right_index = ctx.context.i32_type().const_int(1, false);
+
+    if copy_to_portal {
+        let form = ctx
+            .b
+            .build_load(
+                &unsafe { ctx.b.build_struct_gep(&buffer_ptr, 3, "buffer.form.ptr") },
+                "buffer.form",
+            ).into_int_value();
+        let left = ctx
+            .b
+            .build_load(&left_ptr, "buffer.left.sample")
+            .into_float_value();
+        let right = ctx
+            .b
+            .build_load(&right_ptr, "buffer.right.sample")
+            .into_float_value();
+        let vec = ctx
+            .b
+            .build_insert_element(
+                &ctx.b
+                    .build_insert_element(
+                        &ctx.context.f32_type().vec_type(2).get_undef(),
+                        &left,
+                        &left_index,
+                        "",
+                    ).into_vector_value(),
+                &right,
+                &right_index,
+                "",
+            ).into_vector_value();
+        portal_num.set_vec(ctx.b, &vec);
+        portal_num.set_form(ctx.b, &form);
+    } else {
+        let vec = portal_num.get_vec(ctx.b);
+        let left = ctx
+            .b
+            .build_extract_element(&vec, &left_index, "portal.left")
+            .into_float_value();
+        let right = ctx
+            .b
+            .build_extract_element(&vec, &right_index, "portal.right")
+            .into_float_value();
+        ctx.b.build_store(&left_ptr, &left);
+        ctx.b.build_store(&right_ptr, &right);
+    }
+
+    let next_index = ctx.b.build_int_add(
+        current_index,
+        ctx.context.i32_type().const_int(1, false),
+        "nextindex",
+    );
+    ctx.b.build_store(&index_ptr, &next_index);
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&end_block);
+}
+
+/// Builds a function that runs the update function for a number of frames. Before each frame,
+/// samples are read from each input buffer's channels into the bound portal, and after each frame
+/// samples are written from each bound portal to the output buffer's channels. Since channels are
+/// read and written directly, they can point straight at the host's (deinterleaved) audio buffers. Building this in the runtime allows
+/// the update function to be inlined into the loop, and saves a call into the runtime for each
+/// frame.
+pub fn build_block_func(module: &Module, cache: &ObjectCache, name: &str, update_name: &str) {
+    let context = module.get_context();
+    let func = util::get_or_create_func(module, name, true, &|| {
+        let buffer_ptr_type = get_portal_buffer_type(&context).ptr_type(AddressSpace::Generic);
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(
+                &[
+                    &context.i32_type(), // frame count
+                    &buffer_ptr_type,    // input buffers
+                    &context.i32_type(), // input buffer count
+                    &buffer_ptr_type,    // output buffers
+                    &context.i32_type(), // output buffer count
+                ],
+                false,
+            ),
+        )
+    });
+    let update_func = module.get_function(update_name).unwrap();
+
+    build_context_function(module, func, cache.target(), &|mut ctx: BuilderContext| {
+        let frame_count = ctx.func.get_nth_param(0).unwrap().into_int_value();
+        let input_buffers = ctx.func.get_nth_param(1).unwrap().into_pointer_value();
+        let input_buffer_count = ctx.func.get_nth_param(2).unwrap().into_int_value();
+        let output_buffers = ctx.func.get_nth_param(3).unwrap().into_pointer_value();
+        let output_buffer_count = ctx.func.get_nth_param(4).unwrap().into_int_value();
+
+        let frame_index_ptr = ctx
+            .allocb
+            .build_alloca(&ctx.context.i32_type(), "frameindex.ptr");
+        ctx.b
+            .build_store(&frame_index_ptr, &ctx.context.i32_type().const_int(0, false));
+
+        let check_block = ctx.context.append_basic_block(&ctx.func, "frame.check");
+        let run_block = ctx.context.append_basic_block(&ctx.func, "frame.run");
+        let end_block = ctx.context.append_basic_block(&ctx.func, "frame.end");
+
+        ctx.b.build_unconditional_branch(&check_block);
+        ctx.b.position_at_end(&check_block);
+
+        let frame_index = ctx
+            .b
+            .build_load(&frame_index_ptr, "frameindex")
+            .into_int_value();
+        let can_continue_loop = ctx.b.build_int_compare(
+            IntPredicate::ULT,
+            frame_index,
+            frame_count,
+            "cancontinue",
+        );
+        ctx.b
+            .build_conditional_branch(&can_continue_loop, &run_block, &end_block);
+        ctx.b.position_at_end(&run_block);
+
+        build_portal_buffer_copy(
+            &mut ctx,
+            input_buffers,
+            input_buffer_count,
+            frame_index,
+            true,
+        );
+        ctx.b.build_call(&update_func, &[], "", false);
+        build_portal_buffer_copy(
+            &mut ctx,
+            output_buffers,
+            output_buffer_count,
+            frame_index,
+            false,
+        );
+
+        let next_frame_index = ctx.b.build_int_add(
+            frame_index,
+            ctx.context.i32_type().const_int(1, false),
+            "nextframeindex",
+        );
+        ctx.b.build_store(&frame_index_ptr, &next_frame_index);
+        ctx.b.build_unconditional_branch(&check_block);
+
+        ctx.b.position_at_end(&end_block);
+        ctx.b.build_return(None);
+    });
+}
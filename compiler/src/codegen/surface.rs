@@ -1,5 +1,5 @@
 use codegen::{
-    block, build_context_function, util, values, BuilderContext, LifecycleFunc, ObjectCache,
+    block, build_context_function, globals, util, values, BuilderContext, LifecycleFunc, ObjectCache,
 };
 use inkwell::builder::Builder;
 use inkwell::module::{Linkage, Module};
@@ -7,13 +7,41 @@ use inkwell::values::{FunctionValue, PointerValue};
 use inkwell::{AddressSpace, IntPredicate};
 use mir::{Node, NodeData, Surface, SurfaceRef};
 
+/// Runs the voices of an extracted surface on a worker pool, implemented by the runtime.
+pub const DISPATCH_VOICES_FUNC_NAME: &str = "maxim_dispatch_voices";
+
+fn get_dispatch_voices_func(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, DISPATCH_VOICES_FUNC_NAME, false, &|| {
+        let context = module.get_context();
+        let ptr_type = context.i8_type().ptr_type(AddressSpace::Generic);
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(
+                &[
+                    &ptr_type,
+                    &ptr_type,
+                    &ptr_type,
+                    &context.i64_type(),
+                    &context.i32_type(),
+                ],
+                false,
+            ),
+        )
+    })
+}
+
 fn get_lifecycle_func(
     module: &Module,
     cache: &ObjectCache,
     surface: SurfaceRef,
     lifecycle: LifecycleFunc,
 ) -> FunctionValue {
-    let func_name = format!("maxim.surface.{}.{}", surface, lifecycle);
+    let func_name = format!(
+        "maxim.surface.{}.{}.{}",
+        surface,
+        cache.surface_key(surface),
+        lifecycle
+    );
     util::get_or_create_func(module, &func_name, true, &|| {
         let context = module.get_context();
         let layout = cache.surface_layout(surface).unwrap();
@@ -111,6 +139,59 @@ fn build_node_call(
                 None
             };
 
+            let end_block = ctx.context.append_basic_block(&ctx.func, "voice.end");
+
+            // if the runtime has a worker pool, updates are handed to it to run the voices in
+            // parallel, otherwise they're run in the loop below
+            if lifecycle == LifecycleFunc::Update {
+                let dispatch_block = ctx.context.append_basic_block(&ctx.func, "voice.dispatch");
+                let loop_block = ctx.context.append_basic_block(&ctx.func, "voice.loop");
+
+                let pool_ptr = ctx
+                    .b
+                    .build_load(
+                        &globals::get_worker_pool(ctx.module).as_pointer_value(),
+                        "workerpool",
+                    ).into_pointer_value();
+                let has_pool = ctx.b.build_is_not_null(pool_ptr, "haspool");
+                ctx.b
+                    .build_conditional_branch(&has_pool, &dispatch_block, &loop_block);
+                ctx.b.position_at_end(&dispatch_block);
+
+                let i8_ptr_type = ctx.context.i8_type().ptr_type(AddressSpace::Generic);
+                let update_func = get_lifecycle_func(ctx.module, cache, *surface_id, lifecycle);
+                let voice_stride = cache
+                    .surface_layout(*surface_id)
+                    .unwrap()
+                    .pointer_struct
+                    .size_of()
+                    .unwrap();
+                let dispatch_bitmap = if let Some(active_bitmap) = valid_bitmap {
+                    active_bitmap
+                } else {
+                    ctx.b
+                        .build_not(&ctx.context.i32_type().const_int(0, false), "")
+                };
+                ctx.b.build_call(
+                    &get_dispatch_voices_func(ctx.module),
+                    &[
+                        &pool_ptr,
+                        &ctx.b.build_pointer_cast(
+                            update_func.as_global_value().as_pointer_value(),
+                            i8_ptr_type,
+                            "",
+                        ),
+                        &ctx.b.build_pointer_cast(voice_pointers, i8_ptr_type, ""),
+                        &voice_stride,
+                        &dispatch_bitmap,
+                    ],
+                    "",
+                    false,
+                );
+                ctx.b.build_unconditional_branch(&end_block);
+                ctx.b.position_at_end(&loop_block);
+            }
+
             // build a for loop to iterate over each instance
             let index_ptr = ctx
                 .allocb
@@ -123,7 +204,6 @@ fn build_node_call(
                 .context
                 .append_basic_block(&ctx.func, "voice.checkactive");
             let run_block = ctx.context.append_basic_block(&ctx.func, "voice.run");
-            let end_block = ctx.context.append_basic_block(&ctx.func, "voice.end");
 
             ctx.b.build_unconditional_branch(&check_block);
             ctx.b.position_at_end(&check_block);
@@ -1,18 +1,68 @@
+use ffi;
 use inkwell::targets::TargetMachine;
 
+/// How generated code is optimized. The value is passed across the C API, so the order must match
+/// `OptimizationProfile` in the editor.
+#[repr(u8)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum OptimizationProfile {
+    /// Equivalent to -Oz, for exported code where binary size matters more than speed.
+    Size,
+    /// Equivalent to -O2, a compromise between compile time, code size and speed.
+    Balanced,
+    /// Equivalent to -O3, for code that's being played live.
+    Speed,
+}
+
 #[derive(Debug)]
 pub struct TargetProperties {
     pub include_ui: bool,
-    pub min_size: bool,
+    pub profile: OptimizationProfile,
     pub machine: TargetMachine,
 }
 
 impl TargetProperties {
-    pub fn new(include_ui: bool, min_size: bool, machine: TargetMachine) -> Self {
+    pub fn new(include_ui: bool, profile: OptimizationProfile, machine: TargetMachine) -> Self {
         TargetProperties {
             include_ui,
-            min_size,
+            profile,
             machine,
         }
     }
 }
+
+/// A target machine for the host CPU, created through the C API so it can be passed to LLVM
+/// functions that inkwell doesn't wrap. Target machines can't be shared between threads, so each
+/// thread that needs one selects its own.
+#[derive(Debug)]
+pub struct HostMachine(ffi::LLVMTargetMachineRef);
+
+impl HostMachine {
+    pub fn select() -> Self {
+        HostMachine(unsafe { ffi::LLVMAxiomSelectTarget() })
+    }
+
+    pub fn as_raw(&self) -> ffi::LLVMTargetMachineRef {
+        self.0
+    }
+
+    /// The triple, CPU and features the machine generates code for.
+    pub fn description(&self) -> String {
+        unsafe {
+            format!(
+                "{} {} {}",
+                ffi::take_message(ffi::LLVMGetTargetMachineTriple(self.0)),
+                ffi::take_message(ffi::LLVMGetTargetMachineCPU(self.0)),
+                ffi::take_message(ffi::LLVMGetTargetMachineFeatureString(self.0))
+            )
+        }
+    }
+}
+
+impl Drop for HostMachine {
+    fn drop(&mut self) {
+        unsafe {
+            ffi::LLVMDisposeTargetMachine(self.0);
+        }
+    }
+}
@@ -113,6 +113,13 @@ pub fn get_vec_spread(context: &Context, val: f32) -> VectorValue {
     get_const_vec(context, val, val)
 }
 
+pub fn get_int_vec_spread(context: &Context, val: u64) -> VectorValue {
+    VectorType::const_vector(&[
+        &context.i32_type().const_int(val, false),
+        &context.i32_type().const_int(val, false),
+    ])
+}
+
 pub fn splat_vector(builder: &Builder, val: FloatValue, name: &str) -> VectorValue {
     let context = val.get_type().get_context();
     builder
@@ -130,6 +137,23 @@ pub fn splat_vector(builder: &Builder, val: FloatValue, name: &str) -> VectorVal
         ).into_vector_value()
 }
 
+pub fn splat_int_vector(builder: &Builder, val: IntValue, name: &str) -> VectorValue {
+    let context = val.get_type().get_context();
+    builder
+        .build_insert_element(
+            &builder
+                .build_insert_element(
+                    &val.get_type().vec_type(2).get_undef(),
+                    &val,
+                    &context.i32_type().const_int(0, false),
+                    name,
+                ).into_vector_value(),
+            &val,
+            &context.i32_type().const_int(1, false),
+            name,
+        ).into_vector_value()
+}
+
 pub fn copy_ptr(builder: &mut Builder, module: &Module, src: PointerValue, dest: PointerValue) {
     let src_elem_type = src.get_type().element_type();
     let dest_elem_type = dest.get_type().element_type();
@@ -9,6 +9,7 @@ use inkwell::AddressSpace;
 use inkwell::IntPredicate;
 use std::borrow::Borrow;
 
+// The editor writes MIDI values directly, so this must match `MidiValue::MAX_EVENTS` there.
 pub const MIDI_EVENT_COUNT: u8 = 16;
 
 #[derive(Debug, Clone)]
@@ -0,0 +1,135 @@
+// C functions the compiler calls on raw LLVM handles, for things inkwell doesn't wrap. The
+// `LLVMAxiom` functions are defined in llvmmaxim, the others are part of LLVM's C API.
+
+use std::ffi::CStr;
+use std::os::raw::{c_char, c_uint};
+
+pub enum LLVMOpaqueContext {}
+pub enum LLVMOpaqueMemoryBuffer {}
+pub enum LLVMOpaqueModule {}
+pub enum LLVMOpaquePassManager {}
+pub enum LLVMOpaquePassManagerBuilder {}
+pub enum LLVMOpaqueTargetMachine {}
+pub enum LLVMOpaqueValue {}
+pub enum OrcJit {}
+
+pub type LLVMBool = i32;
+pub type LLVMContextRef = *mut LLVMOpaqueContext;
+pub type LLVMMemoryBufferRef = *mut LLVMOpaqueMemoryBuffer;
+pub type LLVMModuleRef = *mut LLVMOpaqueModule;
+pub type LLVMPassManagerRef = *mut LLVMOpaquePassManager;
+pub type LLVMPassManagerBuilderRef = *mut LLVMOpaquePassManagerBuilder;
+pub type LLVMTargetMachineRef = *mut LLVMOpaqueTargetMachine;
+pub type LLVMValueRef = *mut LLVMOpaqueValue;
+pub type LLVMOrcModuleHandle = u64;
+pub type LLVMOrcTargetAddress = u64;
+
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum LLVMCodeGenFileType {
+    LLVMAssemblyFile = 0,
+    LLVMObjectFile = 1,
+}
+
+extern "C" {
+    pub fn LLVMAxiomSelectTarget() -> LLVMTargetMachineRef;
+    pub fn LLVMAxiomPassManagerBuilderSetVectorize(
+        builder: LLVMPassManagerBuilderRef,
+        loop_vectorize: bool,
+        slp_vectorize: bool,
+    );
+
+    pub fn LLVMAxiomOrcCreateInstance(target_machine: LLVMTargetMachineRef) -> *mut OrcJit;
+    pub fn LLVMAxiomOrcAddBuiltin(
+        jit: *mut OrcJit,
+        name: *const c_char,
+        address: LLVMOrcTargetAddress,
+    );
+    pub fn LLVMAxiomOrcAddObjectFile(
+        jit: *mut OrcJit,
+        data: *const c_char,
+        size: usize,
+    ) -> LLVMOrcModuleHandle;
+    pub fn LLVMAxiomOrcRemoveModule(jit: *mut OrcJit, handle: LLVMOrcModuleHandle);
+    pub fn LLVMAxiomOrcGetSymbolAddress(
+        jit: *mut OrcJit,
+        name: *const c_char,
+    ) -> LLVMOrcTargetAddress;
+    pub fn LLVMAxiomOrcDisposeInstance(jit: *mut OrcJit);
+
+    pub fn LLVMDisposeMessage(message: *mut c_char);
+
+    pub fn LLVMContextCreate() -> LLVMContextRef;
+    pub fn LLVMContextDispose(context: LLVMContextRef);
+
+    pub fn LLVMCreateMemoryBufferWithMemoryRange(
+        data: *const c_char,
+        size: usize,
+        name: *const c_char,
+        requires_null_terminator: LLVMBool,
+    ) -> LLVMMemoryBufferRef;
+    pub fn LLVMGetBufferStart(buffer: LLVMMemoryBufferRef) -> *const c_char;
+    pub fn LLVMGetBufferSize(buffer: LLVMMemoryBufferRef) -> usize;
+    pub fn LLVMDisposeMemoryBuffer(buffer: LLVMMemoryBufferRef);
+
+    pub fn LLVMParseBitcodeInContext2(
+        context: LLVMContextRef,
+        buffer: LLVMMemoryBufferRef,
+        out_module: *mut LLVMModuleRef,
+    ) -> LLVMBool;
+    pub fn LLVMDumpModule(module: LLVMModuleRef);
+    pub fn LLVMDisposeModule(module: LLVMModuleRef);
+    pub fn LLVMGetFirstFunction(module: LLVMModuleRef) -> LLVMValueRef;
+    pub fn LLVMGetNextFunction(func: LLVMValueRef) -> LLVMValueRef;
+
+    pub fn LLVMPassManagerBuilderCreate() -> LLVMPassManagerBuilderRef;
+    pub fn LLVMPassManagerBuilderSetOptLevel(builder: LLVMPassManagerBuilderRef, level: c_uint);
+    pub fn LLVMPassManagerBuilderSetSizeLevel(builder: LLVMPassManagerBuilderRef, level: c_uint);
+    pub fn LLVMPassManagerBuilderUseInlinerWithThreshold(
+        builder: LLVMPassManagerBuilderRef,
+        threshold: c_uint,
+    );
+    pub fn LLVMPassManagerBuilderPopulateModulePassManager(
+        builder: LLVMPassManagerBuilderRef,
+        pass_manager: LLVMPassManagerRef,
+    );
+    pub fn LLVMPassManagerBuilderPopulateFunctionPassManager(
+        builder: LLVMPassManagerBuilderRef,
+        pass_manager: LLVMPassManagerRef,
+    );
+    pub fn LLVMPassManagerBuilderDispose(builder: LLVMPassManagerBuilderRef);
+
+    pub fn LLVMCreatePassManager() -> LLVMPassManagerRef;
+    pub fn LLVMCreateFunctionPassManagerForModule(module: LLVMModuleRef) -> LLVMPassManagerRef;
+    pub fn LLVMInitializeFunctionPassManager(pass_manager: LLVMPassManagerRef) -> LLVMBool;
+    pub fn LLVMRunFunctionPassManager(
+        pass_manager: LLVMPassManagerRef,
+        func: LLVMValueRef,
+    ) -> LLVMBool;
+    pub fn LLVMFinalizeFunctionPassManager(pass_manager: LLVMPassManagerRef) -> LLVMBool;
+    pub fn LLVMRunPassManager(pass_manager: LLVMPassManagerRef, module: LLVMModuleRef) -> LLVMBool;
+    pub fn LLVMDisposePassManager(pass_manager: LLVMPassManagerRef);
+
+    pub fn LLVMAddAnalysisPasses(
+        target_machine: LLVMTargetMachineRef,
+        pass_manager: LLVMPassManagerRef,
+    );
+    pub fn LLVMTargetMachineEmitToMemoryBuffer(
+        target_machine: LLVMTargetMachineRef,
+        module: LLVMModuleRef,
+        file_type: LLVMCodeGenFileType,
+        error_message: *mut *mut c_char,
+        out_buffer: *mut LLVMMemoryBufferRef,
+    ) -> LLVMBool;
+    pub fn LLVMGetTargetMachineTriple(target_machine: LLVMTargetMachineRef) -> *mut c_char;
+    pub fn LLVMGetTargetMachineCPU(target_machine: LLVMTargetMachineRef) -> *mut c_char;
+    pub fn LLVMGetTargetMachineFeatureString(target_machine: LLVMTargetMachineRef) -> *mut c_char;
+    pub fn LLVMDisposeTargetMachine(target_machine: LLVMTargetMachineRef);
+}
+
+/// Copies a message allocated by LLVM, and disposes of it.
+pub unsafe fn take_message(message: *mut c_char) -> String {
+    let string = CStr::from_ptr(message).to_string_lossy().into_owned();
+    LLVMDisposeMessage(message);
+    string
+}
@@ -0,0 +1,348 @@
+use codegen::intrinsics::MAX_BUFFER_SIZE_CLASS;
+use std::alloc::{self, Layout};
+use std::fmt;
+use std::ptr;
+use std::sync::atomic::{AtomicBool, AtomicPtr, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
+
+// How many buffers of a size are kept ready once one has been asked for, on top of any that have
+// been reserved.
+const READY_PER_CLASS: usize = 2;
+
+// How many buffers of a size can be reserved with `prepare` at once. Each stereo delay reserves
+// two, so this is enough for 64 delays with the same reserve.
+const MAX_RESERVED_PER_CLASS: usize = 128;
+
+// How many buffers of each size can be ready, and how many freed buffers can be waiting to be
+// cleared or released.
+const SLOTS_PER_CLASS: usize = MAX_RESERVED_PER_CLASS + READY_PER_CLASS;
+
+// The pool thread wakes up this often even if nothing has asked for a buffer, to deal with freed
+// ones.
+const REFILL_INTERVAL: Duration = Duration::from_millis(10);
+
+// Once a size hasn't been asked for in this long, buffers of it stop being kept ready, so sizes a
+// patch has moved on from don't hold on to memory.
+const WANTED_TIMEOUT: Duration = Duration::from_millis(10_000);
+
+fn buffer_layout(size_class: usize) -> Layout {
+    Layout::from_size_align((1 << size_class) * 4, 16).unwrap()
+}
+
+fn size_class(size: u64) -> Option<usize> {
+    if size.is_power_of_two() && size.trailing_zeros() as usize <= MAX_BUFFER_SIZE_CLASS {
+        Some(size.trailing_zeros() as usize)
+    } else {
+        None
+    }
+}
+
+// Slots are claimed and filled with single atomic operations, so any number of threads can take
+// and put buffers without locking.
+struct Slots(Vec<AtomicPtr<f32>>);
+
+impl Slots {
+    fn new() -> Self {
+        Slots(
+            (0..SLOTS_PER_CLASS)
+                .map(|_| AtomicPtr::new(ptr::null_mut()))
+                .collect(),
+        )
+    }
+
+    fn take(&self) -> Option<*mut f32> {
+        self.0
+            .iter()
+            .map(|slot| slot.swap(ptr::null_mut(), Ordering::Acquire))
+            .find(|buffer| !buffer.is_null())
+    }
+
+    // Returns false if every slot is full.
+    fn put(&self, buffer: *mut f32) -> bool {
+        self.0.iter().any(|slot| {
+            slot.compare_exchange(ptr::null_mut(), buffer, Ordering::Release, Ordering::Relaxed)
+                .is_ok()
+        })
+    }
+
+    fn count(&self) -> usize {
+        self.0
+            .iter()
+            .filter(|slot| !slot.load(Ordering::Relaxed).is_null())
+            .count()
+    }
+}
+
+struct SizeClass {
+    // Cleared buffers that can be handed out.
+    ready: Slots,
+    // Buffers that have been freed, which the pool thread clears and makes ready again (or
+    // releases, if there are already enough ready).
+    freed: Slots,
+    // Set each time a buffer of this size is asked for, and cleared by the pool thread, which
+    // keeps some ready until none have been asked for in WANTED_TIMEOUT.
+    is_requested: AtomicBool,
+    // How many buffers `prepare` has reserved that haven't been taken yet. Each is kept ready as
+    // well as READY_PER_CLASS, so every caller of `prepare` gets one even if they all ask at once.
+    reserved: AtomicUsize,
+}
+
+impl SizeClass {
+    fn ready_target(&self) -> usize {
+        self.reserved.load(Ordering::Relaxed) + READY_PER_CLASS
+    }
+
+    fn reserve(&self) {
+        let mut reserved = self.reserved.load(Ordering::Relaxed);
+        while reserved < MAX_RESERVED_PER_CLASS {
+            match self.reserved.compare_exchange_weak(
+                reserved,
+                reserved + 1,
+                Ordering::Relaxed,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => return,
+                Err(current) => reserved = current,
+            }
+        }
+    }
+
+    // Called when a buffer is taken, which uses up a reservation if there are any.
+    fn release_reservation(&self) {
+        let mut reserved = self.reserved.load(Ordering::Relaxed);
+        while reserved > 0 {
+            match self.reserved.compare_exchange_weak(
+                reserved,
+                reserved - 1,
+                Ordering::Relaxed,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => return,
+                Err(current) => reserved = current,
+            }
+        }
+    }
+
+    // Allocates buffers until enough are ready.
+    fn fill_ready(&self, layout: Layout) {
+        for _ in self.ready.count()..self.ready_target() {
+            let buffer = unsafe { alloc::alloc_zeroed(layout) } as *mut f32;
+            if buffer.is_null() {
+                break;
+            }
+            if !self.ready.put(buffer) {
+                unsafe {
+                    alloc::dealloc(buffer as *mut u8, layout);
+                }
+                break;
+            }
+        }
+    }
+}
+
+struct PoolState {
+    classes: Vec<SizeClass>,
+    is_stopping: AtomicBool,
+}
+
+impl PoolState {
+    // `wanted_until` is when each size stops being kept ready, and is only used by the pool thread.
+    fn refill(&self, wanted_until: &mut [Option<Instant>]) {
+        let now = Instant::now();
+        for (class_index, class) in self.classes.iter().enumerate() {
+            let layout = buffer_layout(class_index);
+
+            let class_wanted_until = &mut wanted_until[class_index];
+            if class.is_requested.swap(false, Ordering::Relaxed) {
+                *class_wanted_until = Some(now + WANTED_TIMEOUT);
+            } else if class_wanted_until.map_or(false, |until| now >= until) {
+                *class_wanted_until = None;
+                class.reserved.store(0, Ordering::Relaxed);
+                while let Some(buffer) = class.ready.take() {
+                    unsafe {
+                        alloc::dealloc(buffer as *mut u8, layout);
+                    }
+                }
+            }
+            let is_wanted = class_wanted_until.is_some();
+
+            let ready_target = class.ready_target();
+            while let Some(buffer) = class.freed.take() {
+                let is_needed = is_wanted && class.ready.count() < ready_target;
+                unsafe {
+                    if is_needed {
+                        ptr::write_bytes(buffer, 0, 1 << class_index);
+                    }
+                    if !is_needed || !class.ready.put(buffer) {
+                        alloc::dealloc(buffer as *mut u8, layout);
+                    }
+                }
+            }
+
+            if is_wanted {
+                class.fill_ready(layout);
+            }
+        }
+    }
+
+    fn run(&self) {
+        let mut wanted_until = vec![None; self.classes.len()];
+        while !self.is_stopping.load(Ordering::Relaxed) {
+            self.refill(&mut wanted_until);
+            thread::park_timeout(REFILL_INTERVAL);
+        }
+    }
+}
+
+impl Drop for PoolState {
+    fn drop(&mut self) {
+        for (class_index, class) in self.classes.iter().enumerate() {
+            let layout = buffer_layout(class_index);
+            while let Some(buffer) = class.ready.take().or_else(|| class.freed.take()) {
+                unsafe {
+                    alloc::dealloc(buffer as *mut u8, layout);
+                }
+            }
+        }
+    }
+}
+
+/// Sample buffers for generated code that can be resized from the audio thread without calling
+/// the system allocator. Buffers come in power-of-two sizes, a few of each size that's been asked
+/// for recently are kept ready, and a background thread allocates and clears them. Taking and
+/// returning buffers is lock-free.
+///
+/// If no buffer of a size is ready, the request fails and the caller keeps its current buffer
+/// until the pool thread has prepared one, which takes a few milliseconds. Buffers that are likely
+/// to be asked for can be reserved ahead of time with `prepare`, one per call.
+pub struct BufferPool {
+    state: Arc<PoolState>,
+    refill_thread: thread::Thread,
+    refill_handle: Mutex<Option<thread::JoinHandle<()>>>,
+}
+
+impl fmt::Debug for BufferPool {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "BufferPool")
+    }
+}
+
+impl BufferPool {
+    pub fn new() -> Self {
+        let state = Arc::new(PoolState {
+            classes: (0..=MAX_BUFFER_SIZE_CLASS)
+                .map(|_| SizeClass {
+                    ready: Slots::new(),
+                    freed: Slots::new(),
+                    is_requested: AtomicBool::new(false),
+                    reserved: AtomicUsize::new(0),
+                }).collect(),
+            is_stopping: AtomicBool::new(false),
+        });
+
+        let thread_state = state.clone();
+        let refill_handle = thread::Builder::new()
+            .name("maxim buffer pool".to_string())
+            .spawn(move || thread_state.run())
+            .unwrap();
+
+        BufferPool {
+            state,
+            refill_thread: refill_handle.thread().clone(),
+            refill_handle: Mutex::new(Some(refill_handle)),
+        }
+    }
+
+    /// Moves the samples in a buffer to one of a new size, which is cleared past the end of the
+    /// old samples, and frees the old buffer. Sizes must be zero or a power of two. Returns false
+    /// if no buffer of the new size is ready, in which case the old buffer is left as it is and
+    /// the pool thread is woken to prepare one.
+    pub unsafe fn resize(&self, buffer: &mut *mut f32, old_size: u64, new_size: u64) -> bool {
+        let new_buffer = if new_size == 0 {
+            ptr::null_mut()
+        } else {
+            let class = match size_class(new_size) {
+                Some(class) => &self.state.classes[class],
+                None => return false,
+            };
+            class.is_requested.store(true, Ordering::Relaxed);
+            match class.ready.take() {
+                Some(new_buffer) => {
+                    class.release_reservation();
+                    new_buffer
+                }
+                None => {
+                    self.refill_thread.unpark();
+                    return false;
+                }
+            }
+        };
+
+        if !buffer.is_null() && !new_buffer.is_null() {
+            ptr::copy_nonoverlapping(*buffer, new_buffer, old_size.min(new_size) as usize);
+        }
+        self.free(*buffer, old_size);
+        *buffer = new_buffer;
+        true
+    }
+
+    /// Reserves a buffer of a size and gets it ready, so the first request for it doesn't fail
+    /// while the pool thread prepares one. Each call reserves another buffer, which is kept ready
+    /// until a request takes it. Sizes the pool doesn't have buffers for are ignored. This
+    /// allocates on the calling thread, so it can't be called from the audio thread.
+    pub fn prepare(&self, size: u64) {
+        if let Some(class_index) = size_class(size) {
+            let class = &self.state.classes[class_index];
+            class.is_requested.store(true, Ordering::Relaxed);
+            class.reserve();
+            class.fill_ready(buffer_layout(class_index));
+        }
+    }
+
+    /// Returns a buffer to the pool. It's cleared or released by the pool thread.
+    pub unsafe fn free(&self, buffer: *mut f32, size: u64) {
+        if buffer.is_null() {
+            return;
+        }
+
+        let class = size_class(size).unwrap();
+        if !self.state.classes[class].freed.put(buffer) {
+            // only happens if the pool thread has fallen far behind
+            alloc::dealloc(buffer as *mut u8, buffer_layout(class));
+        }
+    }
+}
+
+impl Drop for BufferPool {
+    fn drop(&mut self) {
+        self.state.is_stopping.store(true, Ordering::Relaxed);
+        self.refill_thread.unpark();
+        if let Some(handle) = self.refill_handle.lock().unwrap().take() {
+            handle.join().unwrap();
+        }
+    }
+}
+
+/// Called by generated code to resize a sample buffer from a buffer pool. The JIT is given this
+/// function as a builtin when it's created. Returns 1 if the buffer was resized.
+pub unsafe extern "C" fn maxim_resize_buffer(
+    pool: *const BufferPool,
+    buffer: *mut *mut f32,
+    old_size: u64,
+    new_size: u64,
+) -> u8 {
+    (*pool).resize(&mut *buffer, old_size, new_size) as u8
+}
+
+/// Called by generated code to return a sample buffer to a buffer pool.
+pub unsafe extern "C" fn maxim_free_buffer(pool: *const BufferPool, buffer: *mut f32, size: u64) {
+    (*pool).free(buffer, size);
+}
+
+/// Called by generated code to reserve a buffer of a size in a buffer pool. Only called while
+/// constructing, never from the audio thread.
+pub unsafe extern "C" fn maxim_prepare_buffer(pool: *const BufferPool, size: u64) {
+    (*pool).prepare(size);
+}
@@ -1,4 +1,4 @@
-use super::{value_reader, Runtime, Transaction};
+use super::{value_reader, CommitTimings, MemoryUsage, PortalBuffer, Runtime, Transaction};
 use ast;
 use codegen;
 use inkwell::{orc, targets};
@@ -21,11 +21,34 @@ pub unsafe extern "C" fn maxim_destroy_string(string: *mut std::os::raw::c_char)
     // string will be dropped here
 }
 
+// Profiles come from the editor as the index of its `OptimizationProfile`. Values it doesn't have
+// get the editor's default instead of being turned into an invalid profile.
+fn optimization_profile(profile: u8) -> codegen::OptimizationProfile {
+    match profile {
+        0 => codegen::OptimizationProfile::Size,
+        1 => codegen::OptimizationProfile::Balanced,
+        _ => codegen::OptimizationProfile::Speed,
+    }
+}
+
 #[no_mangle]
-pub unsafe extern "C" fn maxim_create_runtime(include_ui: bool, min_size: bool) -> *mut Runtime {
-    let target =
-        codegen::TargetProperties::new(include_ui, min_size, targets::TargetMachine::select());
-    Box::into_raw(Box::new(Runtime::new(target)))
+pub unsafe extern "C" fn maxim_create_runtime(
+    include_ui: bool,
+    profile: u8,
+    c_code_cache_path: *const std::os::raw::c_char,
+) -> *mut Runtime {
+    let target = codegen::TargetProperties::new(
+        include_ui,
+        optimization_profile(profile),
+        targets::TargetMachine::select(),
+    );
+    let code_cache_path = if c_code_cache_path.is_null() {
+        None
+    } else {
+        let path = std::ffi::CStr::from_ptr(c_code_cache_path).to_str().unwrap();
+        Some(std::path::PathBuf::from(path))
+    };
+    Box::into_raw(Box::new(Runtime::new(target, code_cache_path)))
 }
 
 #[no_mangle]
@@ -45,6 +68,18 @@ pub unsafe extern "C" fn maxim_run_update(runtime: *const Runtime) {
     (*runtime).run_update();
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_run_block(
+    runtime: *const Runtime,
+    frames: u32,
+    inputs: *const PortalBuffer,
+    input_count: u32,
+    outputs: *const PortalBuffer,
+    output_count: u32,
+) {
+    (*runtime).run_block(frames, inputs, input_count, outputs, output_count);
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_set_bpm(runtime: *mut Runtime, bpm: f32) {
     (*runtime).set_bpm(bpm);
@@ -65,12 +100,65 @@ pub unsafe extern "C" fn maxim_get_sample_rate(runtime: *const Runtime) -> f32 {
     (*runtime).get_sample_rate()
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_get_last_commit_timings(runtime: *const Runtime) -> CommitTimings {
+    (*runtime).get_last_commit_timings()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_get_memory_usage(runtime: *const Runtime) -> MemoryUsage {
+    (*runtime).get_memory_usage()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_worker_threads(runtime: *mut Runtime, count: u32) {
+    (*runtime).set_worker_threads(count as usize);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_get_worker_threads(runtime: *const Runtime) -> u32 {
+    (*runtime).get_worker_threads() as u32
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_compile_threads(runtime: *mut Runtime, count: u32) {
+    (*runtime).set_compile_threads(count as usize);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_crossfade_time(runtime: *mut Runtime, seconds: f32) {
+    (*runtime).set_crossfade_time(seconds);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_noise_seed(runtime: *mut Runtime, seed: u32) {
+    (*runtime).set_noise_seed(seed);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_tiered_compilation(
+    runtime: *mut Runtime,
+    tiered_compilation: bool,
+) {
+    (*runtime).set_tiered_compilation(tiered_compilation);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_optimize_pending(runtime: *mut Runtime) -> bool {
+    (*runtime).optimize_pending()
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_commit(runtime: *mut Runtime, transaction: *mut Transaction) {
     let owned_transaction = Box::from_raw(transaction);
     (*runtime).commit(*owned_transaction)
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_publish(runtime: *mut Runtime) {
+    (*runtime).publish();
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_is_node_extracted(
     runtime: *const Runtime,
@@ -154,6 +242,20 @@ pub unsafe extern "C" fn maxim_destroy_transaction(val: *mut Transaction) {
     // box will be dropped here
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_merge_transaction(val: *mut Transaction, newer: *mut Transaction) {
+    let owned_newer = Box::from_raw(newer);
+    (*val).merge(*owned_newer);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_transaction_set_optimization_profile(
+    val: *mut Transaction,
+    profile: u8,
+) {
+    (*val).profile = Some(optimization_profile(profile));
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_print_transaction_to_stdout(val: *const Transaction) {
     println!("{:#?}", *val);
@@ -0,0 +1,157 @@
+use codegen::{HostMachine, TargetProperties};
+use std::collections::hash_map::DefaultHasher;
+use std::fs;
+use std::hash::{Hash, Hasher};
+use std::path::{Path, PathBuf};
+use std::time::{Duration, SystemTime};
+
+// A hash of the compiler's sources, generated by the build script. Objects built by a different
+// build might not match the layouts or library this one generates, so they're never loaded.
+const BUILD_ID: &str = env!("MAXIM_BUILD_ID");
+
+// Each object starts with a header identifying the build and target it was compiled for, which is
+// checked when it's loaded in case the file name hash collides or the file was cut short.
+const HEADER_MAGIC: &[u8; 8] = b"MAXIMOBJ";
+const HEADER_SIZE: usize = 24;
+
+// Objects are removed once they're this old, or the oldest ones once the cache gets this big. An
+// object that's still used is compiled and stored again the next time it's needed.
+const MAX_OBJECT_AGE_SECS: u64 = 30 * 24 * 60 * 60;
+const MAX_CACHE_BYTES: u64 = 256 * 1024 * 1024;
+
+/// A directory of compiled object files, so modules that have been built before (in this process
+/// or a previous one) can be loaded instead of being optimized and compiled again.
+///
+/// Objects are named after a hash of the module name (which identifies the MIR it was built from),
+/// the target machine, the target properties (which decide how the module is optimized) and the
+/// compiler build. Any of those changing just causes a cache miss, and objects from old builds are
+/// pruned once they age out.
+#[derive(Debug, Clone)]
+pub struct CodeCache {
+    directory: PathBuf,
+    target_key: u64,
+}
+
+impl CodeCache {
+    pub fn new(directory: PathBuf, target: &TargetProperties) -> Self {
+        // if the directory can't be created, loading and storing will fail and objects are built
+        // as usual
+        if let Err(err) = fs::create_dir_all(&directory) {
+            eprintln!(
+                "Failed to create code cache at {}: {}",
+                directory.display(),
+                err
+            );
+        }
+
+        CodeCache::prune(&directory);
+
+        let mut hasher = DefaultHasher::new();
+        BUILD_ID.hash(&mut hasher);
+        HostMachine::select().description().hash(&mut hasher);
+        target.include_ui.hash(&mut hasher);
+        target.profile.hash(&mut hasher);
+
+        CodeCache {
+            directory,
+            target_key: hasher.finish(),
+        }
+    }
+
+    pub fn directory(&self) -> &Path {
+        &self.directory
+    }
+
+    fn object_path(&self, name: &str) -> PathBuf {
+        let mut hasher = DefaultHasher::new();
+        self.target_key.hash(&mut hasher);
+        name.hash(&mut hasher);
+        self.directory.join(format!("{:016x}.o", hasher.finish()))
+    }
+
+    /// Returns true if an object is stored for the module.
+    pub fn contains(&self, name: &str) -> bool {
+        self.object_path(name).is_file()
+    }
+
+    fn header(&self) -> [u8; HEADER_SIZE] {
+        let build_id = u64::from_str_radix(BUILD_ID, 16).unwrap();
+        let mut header = [0; HEADER_SIZE];
+        header[..8].copy_from_slice(HEADER_MAGIC);
+        for byte in 0..8 {
+            header[8 + byte] = (build_id >> (byte * 8)) as u8;
+            header[16 + byte] = (self.target_key >> (byte * 8)) as u8;
+        }
+        header
+    }
+
+    /// Returns the object stored for the module, if there is one. Objects with a header that
+    /// doesn't match this build and target are removed.
+    pub fn load(&self, name: &str) -> Option<Vec<u8>> {
+        let path = self.object_path(name);
+        let data = fs::read(&path).ok()?;
+        if data.len() <= HEADER_SIZE || data[..HEADER_SIZE] != self.header() {
+            eprintln!("Discarding stale code cache object for {}", name);
+            fs::remove_file(&path).ok();
+            return None;
+        }
+
+        Some(data[HEADER_SIZE..].to_vec())
+    }
+
+    /// Stores the compiled object for a module.
+    pub fn store(&self, name: &str, object: &[u8]) {
+        // objects are written to a temporary file first, so another process or thread loading
+        // the same object never sees it half-written
+        let path = self.object_path(name);
+        let temp_path = path.with_extension(format!(
+            "{}.{:?}.tmp",
+            ::std::process::id(),
+            ::std::thread::current().id()
+        ));
+        let mut data = Vec::with_capacity(HEADER_SIZE + object.len());
+        data.extend_from_slice(&self.header());
+        data.extend_from_slice(object);
+        let write_result =
+            fs::write(&temp_path, &data).and_then(|_| fs::rename(&temp_path, &path));
+        if let Err(err) = write_result {
+            eprintln!("Failed to write {} to code cache: {}", name, err);
+            fs::remove_file(&temp_path).ok();
+        }
+    }
+    // Removes objects that haven't been stored for a while, which includes every object built by
+    // an older build, then the oldest objects until the cache is under its maximum size. Files
+    // another process removes or is still writing are skipped.
+    fn prune(directory: &Path) {
+        let entries = match fs::read_dir(directory) {
+            Ok(entries) => entries,
+            Err(_) => return,
+        };
+
+        let now = SystemTime::now();
+        let max_age = Duration::from_secs(MAX_OBJECT_AGE_SECS);
+        let mut objects: Vec<_> = entries
+            .filter_map(|entry| entry.ok())
+            .filter_map(|entry| {
+                let metadata = entry.metadata().ok()?;
+                let modified = metadata.modified().ok()?;
+                if metadata.is_file() {
+                    Some((entry.path(), modified, metadata.len()))
+                } else {
+                    None
+                }
+            }).collect();
+
+        // newest first, so the oldest objects are the ones over the size limit
+        objects.sort_by(|a, b| b.1.cmp(&a.1));
+
+        let mut total_bytes = 0;
+        for (path, modified, size) in objects {
+            let age = now.duration_since(modified).unwrap_or_default();
+            total_bytes += size;
+            if age > max_age || total_bytes > MAX_CACHE_BYTES {
+                fs::remove_file(&path).ok();
+            }
+        }
+    }
+}
@@ -0,0 +1,170 @@
+use super::runtime::{PortalBuffer, UpdateBlockFunc};
+use std::os::raw::c_void;
+use std::ptr;
+
+// Frames are crossfaded in chunks of at most this many, so the old generation's output fits in
+// buffers allocated up front.
+const CHUNK_FRAMES: usize = 256;
+
+/// The portals and block function of one of the generations being crossfaded.
+pub struct CrossfadeGeneration {
+    pub update_block: UpdateBlockFunc,
+    pub portals: *const *mut c_void,
+    pub portal_count: usize,
+}
+
+impl CrossfadeGeneration {
+    // Portals are bound by pointer, so buffers bound to the new generation's portals are moved to
+    // the old generation's portal at the same index.
+    unsafe fn find_portal_index(&self, portal: *mut c_void) -> Option<usize> {
+        (0..self.portal_count).find(|&index| *self.portals.add(index) == portal)
+    }
+}
+
+/// Buffers the audio thread uses while crossfading from an old generation to a new one. They're
+/// allocated when the new generation is deployed, since the audio thread can't allocate. The
+/// generations must have the same portals.
+#[derive(Debug)]
+pub struct CrossfadeBuffers {
+    old_inputs: Vec<PortalBuffer>,
+    old_outputs: Vec<PortalBuffer>,
+    new_inputs: Vec<PortalBuffer>,
+    new_outputs: Vec<PortalBuffer>,
+    // The old generation's output for the current chunk, with two channels for each portal.
+    old_samples: Vec<f32>,
+}
+
+impl CrossfadeBuffers {
+    pub fn new(portal_count: usize) -> Self {
+        CrossfadeBuffers {
+            old_inputs: Vec::with_capacity(portal_count),
+            old_outputs: Vec::with_capacity(portal_count),
+            new_inputs: Vec::with_capacity(portal_count),
+            new_outputs: Vec::with_capacity(portal_count),
+            old_samples: vec![0.; portal_count * 2 * CHUNK_FRAMES],
+        }
+    }
+
+    /// Runs a block of frames on both generations, fading each output from the old generation to
+    /// the new one. `fade_position` is how many frames of the fade have been run before this
+    /// block. Once the fade is over, the rest of the block is only run on the new generation.
+    pub unsafe fn run(
+        &mut self,
+        old: &CrossfadeGeneration,
+        new: &CrossfadeGeneration,
+        frames: usize,
+        inputs: &[PortalBuffer],
+        outputs: &[PortalBuffer],
+        fade_position: usize,
+        fade_length: usize,
+    ) {
+        let mut offset = 0;
+        while offset < frames {
+            let fade_remaining = fade_length.saturating_sub(fade_position + offset);
+            if fade_remaining == 0 {
+                offset_buffers(&mut self.new_inputs, inputs, offset);
+                offset_buffers(&mut self.new_outputs, outputs, offset);
+                self.run_new(new, frames - offset);
+                return;
+            }
+
+            let chunk_frames = (frames - offset).min(fade_remaining).min(CHUNK_FRAMES);
+
+            // The old generation is run first, since hosts can process in-place, in which case
+            // the new generation's output overwrites the input.
+            self.bind_old_buffers(old, new, inputs, outputs, offset, chunk_frames);
+            (old.update_block)(
+                chunk_frames as u32,
+                self.old_inputs.as_ptr(),
+                self.old_inputs.len() as u32,
+                self.old_outputs.as_ptr(),
+                self.old_outputs.len() as u32,
+            );
+
+            offset_buffers(&mut self.new_inputs, inputs, offset);
+            offset_buffers(&mut self.new_outputs, outputs, offset);
+            self.run_new(new, chunk_frames);
+
+            // the old generation's output fades out linearly, since both are mostly the same signal
+            let sample_buffer_count = self.old_samples.len() / (2 * CHUNK_FRAMES);
+            for (output_index, output) in outputs.iter().take(sample_buffer_count).enumerate() {
+                let old_left = output_index * 2 * CHUNK_FRAMES;
+                let old_right = old_left + CHUNK_FRAMES;
+                for frame in 0..chunk_frames {
+                    let new_gain = (fade_position + offset + frame) as f32 / fade_length as f32;
+                    let left = output.left.add(offset + frame);
+                    let right = output.right.add(offset + frame);
+                    *left = self.old_samples[old_left + frame] * (1. - new_gain) + *left * new_gain;
+                    *right =
+                        self.old_samples[old_right + frame] * (1. - new_gain) + *right * new_gain;
+                }
+            }
+
+            offset += chunk_frames;
+        }
+    }
+
+    unsafe fn run_new(&self, new: &CrossfadeGeneration, frames: usize) {
+        (new.update_block)(
+            frames as u32,
+            self.new_inputs.as_ptr(),
+            self.new_inputs.len() as u32,
+            self.new_outputs.as_ptr(),
+            self.new_outputs.len() as u32,
+        );
+    }
+
+    unsafe fn bind_old_buffers(
+        &mut self,
+        old: &CrossfadeGeneration,
+        new: &CrossfadeGeneration,
+        inputs: &[PortalBuffer],
+        outputs: &[PortalBuffer],
+        offset: usize,
+        frames: usize,
+    ) {
+        self.old_inputs.clear();
+        for input in inputs {
+            if let Some(portal_index) = new.find_portal_index(input.portal) {
+                self.old_inputs.push(PortalBuffer {
+                    portal: *old.portals.add(portal_index),
+                    left: input.left.add(offset),
+                    right: input.right.add(offset),
+                    form: input.form,
+                });
+            }
+        }
+
+        // outputs can't be bound more than once, so there's never more than the portal count
+        self.old_outputs.clear();
+        let sample_buffers = self.old_samples.chunks_mut(2 * CHUNK_FRAMES);
+        for (output, samples) in outputs.iter().zip(sample_buffers) {
+            let (left, right) = samples.split_at_mut(CHUNK_FRAMES);
+            match new.find_portal_index(output.portal) {
+                Some(portal_index) => self.old_outputs.push(PortalBuffer {
+                    portal: *old.portals.add(portal_index),
+                    left: left.as_mut_ptr(),
+                    right: right.as_mut_ptr(),
+                    form: 0,
+                }),
+                // an output the old generation doesn't have fades in from silence
+                None => {
+                    ptr::write_bytes(left.as_mut_ptr(), 0, frames);
+                    ptr::write_bytes(right.as_mut_ptr(), 0, frames);
+                }
+            }
+        }
+    }
+}
+
+// Points a list of buffers at a frame offset into the given buffers. The list has enough capacity
+// that this never allocates.
+unsafe fn offset_buffers(dest: &mut Vec<PortalBuffer>, buffers: &[PortalBuffer], offset: usize) {
+    dest.clear();
+    dest.extend(buffers.iter().map(|buffer| PortalBuffer {
+        portal: buffer.portal,
+        left: buffer.left.add(offset),
+        right: buffer.right.add(offset),
+        form: buffer.form,
+    }));
+}
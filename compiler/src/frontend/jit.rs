@@ -1,31 +1,70 @@
-use inkwell::module::Module;
-use inkwell::orc::{Orc, OrcModuleKey};
-use inkwell::targets::TargetMachine;
+use codegen::HostMachine;
+use ffi;
+use std::ffi::CString;
+use std::os::raw::c_void;
+use std::sync::Mutex;
 
-pub type JitKey = OrcModuleKey;
+pub type JitKey = ffi::LLVMOrcModuleHandle;
 
+// The JIT is shared between runtimes, which commit on their own threads, so access to it is
+// serialized. It's used through the llvmmaxim functions directly, since inkwell doesn't wrap
+// adding builtins or object files.
 #[derive(Debug)]
 pub struct Jit {
-    orc: Orc,
+    orc: Mutex<*mut ffi::OrcJit>,
+    // The JIT compiles with the machine it's created with, so it's kept until the JIT is disposed.
+    machine: HostMachine,
 }
 
+unsafe impl Send for Jit {}
+unsafe impl Sync for Jit {}
+
 impl Jit {
     pub fn new() -> Self {
-        let machine = TargetMachine::select();
-        let orc = Orc::new(machine);
+        let machine = HostMachine::select();
+        let orc = unsafe { ffi::LLVMAxiomOrcCreateInstance(machine.as_raw()) };
+
+        Jit {
+            orc: Mutex::new(orc),
+            machine,
+        }
+    }
 
-        Jit { orc }
+    /// Makes a function or global in the host process available to deployed modules under the
+    /// given name, in the same way as the libm builtins.
+    pub fn add_builtin(&self, symbol: &str, value: *mut c_void) {
+        let symbol = CString::new(symbol).unwrap();
+        let orc = self.orc.lock().unwrap();
+        unsafe {
+            ffi::LLVMAxiomOrcAddBuiltin(*orc, symbol.as_ptr(), value as u64);
+        }
     }
 
-    pub fn deploy(&self, module: &Module) -> JitKey {
-        self.orc.add_module(&module.clone())
+    /// Links an already compiled object into the JIT, skipping the compile layer. The JIT keeps
+    /// its own copy of the object.
+    pub fn deploy_object(&self, object: &[u8]) -> JitKey {
+        let orc = self.orc.lock().unwrap();
+        unsafe { ffi::LLVMAxiomOrcAddObjectFile(*orc, object.as_ptr() as *const _, object.len()) }
     }
 
     pub fn remove(&self, key: JitKey) {
-        self.orc.remove_module(key);
+        let orc = self.orc.lock().unwrap();
+        unsafe {
+            ffi::LLVMAxiomOrcRemoveModule(*orc, key);
+        }
     }
 
     pub fn get_symbol_address(&self, symbol: &str) -> u64 {
-        self.orc.get_symbol_address(symbol)
+        let symbol = CString::new(symbol).unwrap();
+        let orc = self.orc.lock().unwrap();
+        unsafe { ffi::LLVMAxiomOrcGetSymbolAddress(*orc, symbol.as_ptr()) }
+    }
+}
+
+impl Drop for Jit {
+    fn drop(&mut self) {
+        unsafe {
+            ffi::LLVMAxiomOrcDisposeInstance(*self.orc.get_mut().unwrap());
+        }
     }
 }
@@ -1,13 +1,22 @@
 pub mod c_api;
+mod buffer_pool;
+mod code_cache;
+mod crossfade;
 mod dependency_graph;
 mod jit;
+mod object_compiler;
 mod runtime;
+mod runtime_globals;
+mod shared_code;
+mod state_map;
 pub mod value_reader;
+mod worker_pool;
 
 pub use self::dependency_graph::DependencyGraph;
 pub use self::jit::Jit;
-pub use self::runtime::Runtime;
+pub use self::runtime::{CommitTimings, MemoryUsage, PortalBuffer, Runtime};
 
+use codegen::OptimizationProfile;
 use mir::{Block, BlockRef, Root, Surface, SurfaceRef};
 use std::collections::HashMap;
 use std::iter::FromIterator;
@@ -17,6 +26,8 @@ pub struct Transaction {
     pub root: Option<Root>,
     pub surfaces: HashMap<SurfaceRef, Surface>,
     pub blocks: HashMap<BlockRef, Block>,
+    // If set, everything is rebuilt with this profile.
+    pub profile: Option<OptimizationProfile>,
 }
 
 impl Transaction {
@@ -27,6 +38,7 @@ impl Transaction {
                 surfaces.into_iter().map(|surface| (surface.id.id, surface)),
             ),
             blocks: HashMap::from_iter(blocks.into_iter().map(|block| (block.id.id, block))),
+            profile: None,
         }
     }
 
@@ -37,4 +49,17 @@ impl Transaction {
     pub fn add_block(&mut self, block: Block) {
         self.blocks.insert(block.id.id, block);
     }
+
+    /// Folds a newer transaction into this one, so both can be committed at once. Objects in the
+    /// newer transaction replace any with the same ID.
+    pub fn merge(&mut self, newer: Transaction) {
+        if newer.root.is_some() {
+            self.root = newer.root;
+        }
+        if newer.profile.is_some() {
+            self.profile = newer.profile;
+        }
+        self.surfaces.extend(newer.surfaces);
+        self.blocks.extend(newer.blocks);
+    }
 }
@@ -0,0 +1,203 @@
+use super::code_cache::CodeCache;
+use codegen::{HostMachine, OptimizationProfile, Optimizer};
+use ffi;
+use inkwell::module::Module;
+use std::collections::{HashMap, VecDeque};
+use std::ffi::CString;
+use std::ptr;
+use std::slice;
+use std::sync::{Arc, Mutex};
+use std::thread;
+
+/// A module that's been built but not yet optimized or compiled. LLVM contexts can't be used from
+/// more than one thread at a time, and every module a runtime builds is in the same context, so
+/// the module is stored as bitcode and read back into a new context by whichever thread compiles
+/// it.
+pub struct CompileJob {
+    name: String,
+    bitcode: Vec<u8>,
+    optimize: bool,
+}
+
+impl CompileJob {
+    /// Verifies the module and serializes it for compiling.
+    pub fn new(name: String, module: &Module, optimize: bool) -> Self {
+        Optimizer::verify_module(module);
+        CompileJob {
+            name,
+            bitcode: module.write_bitcode_to_memory().as_slice().to_vec(),
+            optimize,
+        }
+    }
+
+    pub fn ir_size(&self) -> usize {
+        self.bitcode.len()
+    }
+
+    fn run(&self, optimizer: &Optimizer, machine: &HostMachine) -> Vec<u8> {
+        let module = ParsedModule::new(&self.name, &self.bitcode);
+        unsafe {
+            if self.optimize {
+                optimizer.optimize_module(module.module);
+            }
+            module.compile(machine)
+        }
+    }
+}
+
+// A module read back from bitcode into a context of its own, which are both disposed when it's
+// dropped.
+struct ParsedModule {
+    context: ffi::LLVMContextRef,
+    module: ffi::LLVMModuleRef,
+}
+
+impl ParsedModule {
+    fn new(name: &str, bitcode: &[u8]) -> Self {
+        let buffer_name = CString::new(name).unwrap();
+        unsafe {
+            let context = ffi::LLVMContextCreate();
+
+            // the module is read in full, so the buffer doesn't need to outlive it
+            let buffer = ffi::LLVMCreateMemoryBufferWithMemoryRange(
+                bitcode.as_ptr() as *const _,
+                bitcode.len(),
+                buffer_name.as_ptr(),
+                0,
+            );
+            let mut module = ptr::null_mut();
+            let failed = ffi::LLVMParseBitcodeInContext2(context, buffer, &mut module);
+            ffi::LLVMDisposeMemoryBuffer(buffer);
+            if failed != 0 {
+                ffi::LLVMContextDispose(context);
+                panic!("Failed to read bitcode for {}", name);
+            }
+
+            ParsedModule { context, module }
+        }
+    }
+
+    // Compiles the (already optimized) module to an object that can be deployed to the JIT.
+    unsafe fn compile(&self, machine: &HostMachine) -> Vec<u8> {
+        let mut error = ptr::null_mut();
+        let mut buffer = ptr::null_mut();
+        let failed = ffi::LLVMTargetMachineEmitToMemoryBuffer(
+            machine.as_raw(),
+            self.module,
+            ffi::LLVMCodeGenFileType::LLVMObjectFile,
+            &mut error,
+            &mut buffer,
+        );
+        if failed != 0 {
+            ffi::LLVMDumpModule(self.module);
+            panic!(ffi::take_message(error));
+        }
+
+        let object = slice::from_raw_parts(
+            ffi::LLVMGetBufferStart(buffer) as *const u8,
+            ffi::LLVMGetBufferSize(buffer),
+        ).to_vec();
+        ffi::LLVMDisposeMemoryBuffer(buffer);
+        object
+    }
+}
+
+impl Drop for ParsedModule {
+    fn drop(&mut self) {
+        unsafe {
+            ffi::LLVMDisposeModule(self.module);
+            ffi::LLVMContextDispose(self.context);
+        }
+    }
+}
+
+struct CompiledObject(String, Vec<u8>);
+
+/// Optimizes and compiles a single module on this thread. The object isn't stored in the code
+/// cache.
+pub fn compile_object(job: CompileJob, profile: OptimizationProfile) -> Vec<u8> {
+    let machine = HostMachine::select();
+    let optimizer = Optimizer::new(profile, &machine);
+    job.run(&optimizer, &machine)
+}
+
+/// Optimizes and compiles modules to objects on up to `thread_count` threads, returning the
+/// objects by module name. Optimized objects are stored in the code cache, if there is one.
+///
+/// Modules only refer to each other by symbol name, which the JIT resolves when they're deployed,
+/// so they can be compiled in any order.
+pub fn compile_objects(
+    jobs: Vec<CompileJob>,
+    profile: OptimizationProfile,
+    code_cache: Option<&CodeCache>,
+    thread_count: usize,
+) -> HashMap<String, Vec<u8>> {
+    let thread_count = thread_count.min(jobs.len());
+    let job_queue = Arc::new(Mutex::new(VecDeque::from(jobs)));
+
+    // if there's only one thread, it may as well be this one
+    if thread_count <= 1 {
+        return run_jobs(&job_queue, profile, code_cache)
+            .into_iter()
+            .map(|CompiledObject(name, object)| (name, object))
+            .collect();
+    }
+
+    let threads: Vec<_> = (0..thread_count)
+        .map(|thread_index| {
+            let thread_queue = job_queue.clone();
+            let thread_cache = code_cache.cloned();
+            thread::Builder::new()
+                .name(format!("maxim compiler {}", thread_index))
+                .spawn(move || run_jobs(&thread_queue, profile, thread_cache.as_ref()))
+                .unwrap()
+        }).collect();
+
+    threads
+        .into_iter()
+        .flat_map(|thread| thread.join().unwrap())
+        .map(|CompiledObject(name, object)| (name, object))
+        .collect()
+}
+
+/// Prints the IR of each module to stderr, optimized in the same way as when it's compiled.
+pub fn print_optimized_modules(jobs: &[CompileJob], profile: OptimizationProfile) {
+    let machine = HostMachine::select();
+    let optimizer = Optimizer::new(profile, &machine);
+    for job in jobs {
+        let module = ParsedModule::new(&job.name, &job.bitcode);
+        unsafe {
+            optimizer.optimize_module(module.module);
+            ffi::LLVMDumpModule(module.module);
+        }
+    }
+}
+
+// Jobs are taken from the queue one at a time, so a thread that gets a small module takes another
+// instead of waiting for the others. Target machines and pass managers aren't shared between
+// threads, so each thread has its own.
+fn run_jobs(
+    job_queue: &Mutex<VecDeque<CompileJob>>,
+    profile: OptimizationProfile,
+    code_cache: Option<&CodeCache>,
+) -> Vec<CompiledObject> {
+    let machine = HostMachine::select();
+    let optimizer = Optimizer::new(profile, &machine);
+    let mut objects = Vec::new();
+    loop {
+        let job = match job_queue.lock().unwrap().pop_front() {
+            Some(job) => job,
+            None => return objects,
+        };
+
+        let object = job.run(&optimizer, &machine);
+
+        // unoptimized builds are soon replaced, so they aren't cached
+        if job.optimize {
+            if let Some(cache) = code_cache {
+                cache.store(&job.name, &object);
+            }
+        }
+        objects.push(CompiledObject(job.name, object));
+    }
+}
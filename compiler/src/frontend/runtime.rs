@@ -1,32 +1,69 @@
+use super::code_cache::CodeCache;
+use super::crossfade::{CrossfadeBuffers, CrossfadeGeneration};
 use super::dependency_graph::DependencyGraph;
-use super::jit::{Jit, JitKey};
+use super::object_compiler::{self, CompileJob};
+use super::runtime_globals::RuntimeGlobals;
+use super::shared_code::SharedCode;
+use super::state_map::StateMap;
 use super::Transaction;
 use codegen::{
-    block, controls, converters, data_analyzer, editor, functions, globals, intrinsics, root,
-    surface, values, ObjectCache, Optimizer, TargetProperties,
+    block, data_analyzer, root, surface, ObjectCache, OptimizationProfile, TargetProperties,
 };
 use inkwell::context::Context;
 use inkwell::module::Module;
-use mir::{Block, BlockRef, IdAllocator, InternalNodeRef, Root, Surface, SurfaceRef};
+use mir::{Block, BlockRef, IdAllocator, InternalNodeRef, NodeData, Root, Surface, SurfaceRef};
 use pass;
-use std::collections::hash_map::Entry;
+use std::cell::UnsafeCell;
+use std::collections::hash_map::DefaultHasher;
 use std::collections::{HashMap, HashSet, VecDeque};
+use std::fmt;
+use std::hash::{Hash, Hasher};
 use std::iter;
 use std::iter::FromIterator;
 use std::mem;
 use std::os::raw::c_void;
+use std::path::PathBuf;
 use std::ptr;
+use std::slice;
+use std::sync::atomic::{AtomicPtr, AtomicUsize, Ordering};
+use std::sync::Arc;
 use std::time::{Duration, Instant};
 
+// The LLVM context a runtime builds modules in. Layouts hold types from the context, so it lives as
+// long as the runtime. Modules are compiled to objects in contexts of their own, so only the
+// runtime's thread uses it.
+#[derive(Debug)]
+struct ModuleContext(Context);
+
+unsafe impl Send for ModuleContext {}
+unsafe impl Sync for ModuleContext {}
+
 #[derive(Debug)]
 struct RuntimeModule {
-    module: Module,
-    key: Option<JitKey>,
+    // The name of the module in the shared code. Objects with the same content have the same name.
+    name: String,
+    // The compiled module, until it's deployed. The JIT keeps its own copy, so nothing built for
+    // a module is kept once it's deployed.
+    object: Option<Vec<u8>>,
+    object_size: usize,
+    // The size of the IR the module was built from, as bitcode.
+    ir_size: usize,
 }
 
 impl RuntimeModule {
-    pub fn new(module: Module, key: Option<JitKey>) -> Self {
-        RuntimeModule { module, key }
+    pub fn new(name: String, object: Option<Vec<u8>>, ir_size: usize) -> Self {
+        let object_size = object.as_ref().map_or(0, |object| object.len());
+        RuntimeModule {
+            name,
+            object,
+            object_size,
+            ir_size,
+        }
+    }
+
+    pub fn set_object(&mut self, object: Vec<u8>) {
+        self.object_size = object.len();
+        self.object = Some(object);
     }
 }
 
@@ -39,36 +76,72 @@ const POINTERS_GLOBAL_NAME: &str = "maxim.runtime.pointers";
 const CONSTRUCT_FUNC_NAME: &str = "maxim.runtime.construct";
 const UPDATE_FUNC_NAME: &str = "maxim.runtime.update";
 const DESTRUCT_FUNC_NAME: &str = "maxim.runtime.destruct";
+const UPDATE_BLOCK_FUNC_NAME: &str = "maxim.runtime.update_block";
 
-const CONVERT_NUM_FUNC_NAME: &str = "maxim.editor.convert_num";
+// Root symbols are suffixed with the generation they were built in, so a new root can be deployed
+// while the old one is still running. Generations are unique across runtimes sharing code.
+fn generation_symbol(name: &str, generation: u64) -> String {
+    format!("{}.{}", name, generation)
+}
 
-#[derive(Debug)]
-struct LibraryPointers {
-    samplerate_ptr: *mut c_void,
-    bpm_ptr: *mut c_void,
-    convert_num: unsafe extern "C" fn(*mut c_void, i8, *const c_void),
+// Identifies the code built for an object, from its MIR and the keys of the objects it uses.
+fn content_key(object: &impl fmt::Debug, dependency_keys: &[u64]) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    format!("{:?}", object).hash(&mut hasher);
+    dependency_keys.hash(&mut hasher);
+    hasher.finish()
 }
 
-impl LibraryPointers {
-    pub fn new(jit: &Jit) -> Self {
-        let samplerate_ptr_address =
-            jit.get_symbol_address(globals::SAMPLERATE_GLOBAL_NAME) as usize;
-        assert_ne!(samplerate_ptr_address, 0);
+// Unoptimized builds from tiered compilation get a different key to the optimized build that
+// replaces them, so their symbols don't clash while both are deployed.
+fn unoptimized_key(key: u64) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    key.hash(&mut hasher);
+    "unoptimized".hash(&mut hasher);
+    hasher.finish()
+}
 
-        let bpm_ptr_address = jit.get_symbol_address(globals::BPM_GLOBAL_NAME) as usize;
-        assert_ne!(bpm_ptr_address, 0);
+fn object_module_name(kind: &str, id: u64, key: u64) -> String {
+    format!("{}.{}.{}", kind, id, key)
+}
 
-        let convert_num_address = jit.get_symbol_address(CONVERT_NUM_FUNC_NAME) as usize;
-        assert_ne!(convert_num_address, 0);
+/// A binding of a portal to a pair of channel buffers, used when running a block of frames. Must
+/// match the layout of the type returned by `root::get_portal_buffer_type`.
+#[repr(C)]
+#[derive(Debug)]
+pub struct PortalBuffer {
+    pub portal: *mut c_void,
+    pub left: *mut f32,
+    pub right: *mut f32,
+    pub form: u8,
+}
 
-        LibraryPointers {
-            samplerate_ptr: samplerate_ptr_address as *mut c_void,
-            bpm_ptr: bpm_ptr_address as *mut c_void,
-            convert_num: unsafe { mem::transmute(convert_num_address) },
-        }
-    }
+/// How long each phase of a commit took, in seconds.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct CommitTimings {
+    pub patch_seconds: f64,
+    pub codegen_seconds: f64,
+    pub deploy_seconds: f64,
+}
+
+/// How much memory the code a runtime is using takes, in bytes. Only modules the runtime built or
+/// loaded from the code cache are counted, not ones it shares with runtimes that built them first.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct MemoryUsage {
+    pub module_count: u64,
+    /// The size of the compiled objects deployed to the JIT.
+    pub object_bytes: u64,
+    /// The size of the IR the objects were built from, as bitcode. IR is released once it's been
+    /// compiled, so this is what's saved by not keeping it (IR in memory is several times larger
+    /// than its bitcode).
+    pub released_ir_bytes: u64,
 }
 
+pub type UpdateBlockFunc =
+    unsafe extern "C" fn(u32, *const PortalBuffer, u32, *const PortalBuffer, u32);
+
 #[derive(Debug)]
 struct RuntimePointers {
     initialized_ptr: *mut c_void,
@@ -79,25 +152,47 @@ struct RuntimePointers {
     construct: unsafe extern "C" fn(),
     update: unsafe extern "C" fn(),
     destruct: unsafe extern "C" fn(),
+    update_block: UpdateBlockFunc,
+    // The code the generation was deployed to. It's kept alive by the runtime until the generation
+    // is reclaimed, so the audio thread can use its worker pool.
+    shared_code: *const SharedCode,
+    state_map: StateMap,
+    // Generations can only be crossfaded if they have the same portals.
+    portals_key: u64,
+    portal_count: usize,
+    // Only used by the audio thread, while crossfading to this generation.
+    crossfade_buffers: UnsafeCell<CrossfadeBuffers>,
 }
 
 impl RuntimePointers {
-    pub fn new(jit: &Jit) -> Self {
-        let construct_address = jit.get_symbol_address(CONSTRUCT_FUNC_NAME) as usize;
+    pub fn new(
+        shared_code: &SharedCode,
+        generation: u64,
+        state_map: StateMap,
+        root: &Root,
+    ) -> Self {
+        let jit = shared_code.jit();
+        let get_address =
+            |name: &str| jit.get_symbol_address(&generation_symbol(name, generation)) as usize;
+
+        let construct_address = get_address(CONSTRUCT_FUNC_NAME);
         assert_ne!(construct_address, 0);
 
-        let update_address = jit.get_symbol_address(UPDATE_FUNC_NAME) as usize;
+        let update_address = get_address(UPDATE_FUNC_NAME);
         assert_ne!(update_address, 0);
 
-        let destruct_address = jit.get_symbol_address(DESTRUCT_FUNC_NAME) as usize;
+        let destruct_address = get_address(DESTRUCT_FUNC_NAME);
         assert_ne!(destruct_address, 0);
 
+        let update_block_address = get_address(UPDATE_BLOCK_FUNC_NAME);
+        assert_ne!(update_block_address, 0);
+
         // pointers can be null when they're pointing to empty data
-        let initialized_ptr_address = jit.get_symbol_address(INITIALIZED_GLOBAL_NAME) as usize;
-        let scratch_ptr_address = jit.get_symbol_address(SCRATCH_GLOBAL_NAME) as usize;
-        let sockets_ptr_address = jit.get_symbol_address(SOCKETS_GLOBAL_NAME) as usize;
-        let portals_ptr_address = jit.get_symbol_address(PORTALS_GLOBAL_NAME) as usize;
-        let pointers_ptr_address = jit.get_symbol_address(POINTERS_GLOBAL_NAME) as usize;
+        let initialized_ptr_address = get_address(INITIALIZED_GLOBAL_NAME);
+        let scratch_ptr_address = get_address(SCRATCH_GLOBAL_NAME);
+        let sockets_ptr_address = get_address(SOCKETS_GLOBAL_NAME);
+        let portals_ptr_address = get_address(PORTALS_GLOBAL_NAME);
+        let pointers_ptr_address = get_address(POINTERS_GLOBAL_NAME);
 
         RuntimePointers {
             initialized_ptr: initialized_ptr_address as *mut c_void,
@@ -108,84 +203,174 @@ impl RuntimePointers {
             construct: unsafe { mem::transmute(construct_address) },
             update: unsafe { mem::transmute(update_address) },
             destruct: unsafe { mem::transmute(destruct_address) },
+            update_block: unsafe { mem::transmute(update_block_address) },
+            shared_code,
+            state_map,
+            portals_key: content_key(&root.sockets, &[]),
+            portal_count: root.sockets.len(),
+            crossfade_buffers: UnsafeCell::new(CrossfadeBuffers::new(root.sockets.len())),
+        }
+    }
+
+    fn crossfade_generation(&self) -> CrossfadeGeneration {
+        CrossfadeGeneration {
+            update_block: self.update_block,
+            portals: self.portals_ptr as *const *mut c_void,
+            portal_count: self.portal_count,
+        }
+    }
+}
+
+/// A generation that has been replaced by a newer commit. Its state and modules stay alive until
+/// the audio thread has moved its state to a newer generation and is no longer running it, at which
+/// point it's destructed and its modules are released.
+#[derive(Debug)]
+struct RetiredGeneration {
+    pointers: Option<Box<RuntimePointers>>,
+    // The code the generation was deployed to, which isn't the runtime's current shared code if
+    // the profile has changed since.
+    shared_code: Arc<SharedCode>,
+    modules: Vec<String>,
+}
+
+impl RetiredGeneration {
+    fn is_in_use(
+        &self,
+        live: *mut RuntimePointers,
+        active: *mut RuntimePointers,
+        last_run: *mut RuntimePointers,
+        fading: *mut RuntimePointers,
+        reading_shared_code: *mut SharedCode,
+    ) -> bool {
+        if &*self.shared_code as *const SharedCode as *mut SharedCode == reading_shared_code {
+            true
+        } else if let Some(ref pointers) = self.pointers {
+            let pointers = &**pointers as *const RuntimePointers as *mut RuntimePointers;
+            pointers == live || pointers == active || pointers == last_run || pointers == fading
+        } else {
+            false
+        }
+    }
+
+    fn reclaim(self) {
+        if let Some(ref pointers) = self.pointers {
+            unsafe {
+                (pointers.destruct)();
+            }
+        }
+        for module in self.modules {
+            self.shared_code.release_module(&module);
         }
     }
 }
 
 #[derive(Debug)]
 pub struct Runtime {
-    next_id: u64,
-    context: Context,
+    // IDs are allocated by the editor while a commit may be running on the compile thread
+    next_id: AtomicUsize,
+    context: ModuleContext,
     target: TargetProperties,
-    pub optimizer: Optimizer,
-    root: (Root, RuntimeModule),
+    root: (Root, Option<RuntimeModule>),
     surface_mirs: HashMap<SurfaceRef, Surface>,
     surface_layouts: HashMap<SurfaceRef, data_analyzer::SurfaceLayout>,
     surface_modules: HashMap<SurfaceRef, RuntimeModule>,
     block_mirs: HashMap<BlockRef, Block>,
     block_layouts: HashMap<BlockRef, data_analyzer::BlockLayout>,
     block_modules: HashMap<BlockRef, RuntimeModule>,
+    block_keys: HashMap<BlockRef, u64>,
+    surface_keys: HashMap<SurfaceRef, u64>,
+    generation: u64,
     graph: DependencyGraph,
-    jit: Jit,
-    library_pointers: LibraryPointers,
-    runtime_pointers: Option<RuntimePointers>,
-    bpm: f32,
-    sample_rate: f32,
+    // Only used by the thread committing. Other threads use `live_shared_code`.
+    shared_code: Arc<SharedCode>,
+    // The current shared code, which is replaced when the profile changes, and the one the control
+    // thread is reading, if any. Replaced code is kept alive by the generations retired with it.
+    live_shared_code: AtomicPtr<SharedCode>,
+    reading_shared_code: AtomicPtr<SharedCode>,
+    // The shared code the retired modules were deployed to, if the profile has changed since the
+    // last commit.
+    retired_shared_code: Option<Arc<SharedCode>>,
+    code_cache: Option<CodeCache>,
+    tiered_compilation: bool,
+    compile_threads: usize,
+    unoptimized_blocks: HashSet<BlockRef>,
+    unoptimized_surfaces: HashSet<SurfaceRef>,
+    runtime_pointers: Option<Box<RuntimePointers>>,
+    // The generation the audio thread should run, the one it's currently running (if any), and the
+    // last one it ran, whose state is moved to the next generation it runs.
+    live_pointers: AtomicPtr<RuntimePointers>,
+    active_pointers: AtomicPtr<RuntimePointers>,
+    last_run_pointers: AtomicPtr<RuntimePointers>,
+    // The generation being faded out while the audio thread crossfades to a new one, if any, and
+    // how far through the fade it is. The position and length are only used by the audio thread.
+    fading_pointers: AtomicPtr<RuntimePointers>,
+    fade_position: AtomicUsize,
+    fade_length: AtomicUsize,
+    crossfade_seconds: f32,
+    crossfade_frames: AtomicUsize,
+    retired_modules: Vec<String>,
+    retired_generations: Vec<RetiredGeneration>,
+    last_commit_timings: CommitTimings,
+    // Boxed so the pointer generated code has to them stays valid when the runtime is moved.
+    globals: Box<RuntimeGlobals>,
 }
 
 impl Runtime {
-    pub fn new(target: TargetProperties) -> Self {
-        let optimizer = Optimizer::new(&target);
-        let context = Context::create();
-        let root_module = Runtime::create_module(&context, &target, "root");
-        let jit = Jit::new();
-
-        // deploy the library to the JIT
-        let library_module = Runtime::codegen_lib(&context, &target);
-        optimizer.optimize_module(&library_module);
-        jit.deploy(&library_module);
-        let library_pointers = LibraryPointers::new(&jit);
+    /// Creates a runtime for the target. If a code cache path is provided, compiled code is
+    /// stored in the directory and loaded from it instead of being rebuilt the next time the same
+    /// library, blocks and surfaces are committed.
+    pub fn new(target: TargetProperties, code_cache_path: Option<PathBuf>) -> Self {
+        let code_cache = code_cache_path.map(|path| CodeCache::new(path, &target));
+        let shared_code = SharedCode::get(&target, code_cache.as_ref());
+        let live_shared_code = &*shared_code as *const SharedCode as *mut SharedCode;
 
         Runtime {
-            next_id: 1,
-            context,
+            next_id: AtomicUsize::new(1),
+            context: ModuleContext(Context::create()),
             target,
-            optimizer,
-            root: (Root::new(Vec::new()), RuntimeModule::new(root_module, None)),
+            root: (Root::new(Vec::new()), None),
             surface_mirs: HashMap::new(),
             surface_layouts: HashMap::new(),
             surface_modules: HashMap::new(),
             block_mirs: HashMap::new(),
             block_layouts: HashMap::new(),
             block_modules: HashMap::new(),
+            block_keys: HashMap::new(),
+            surface_keys: HashMap::new(),
+            generation: 0,
             graph: DependencyGraph::new(),
-            jit,
-            library_pointers,
+            shared_code,
+            live_shared_code: AtomicPtr::new(live_shared_code),
+            reading_shared_code: AtomicPtr::new(ptr::null_mut()),
+            retired_shared_code: None,
+            code_cache,
+            tiered_compilation: false,
+            compile_threads: 1,
+            unoptimized_blocks: HashSet::new(),
+            unoptimized_surfaces: HashSet::new(),
             runtime_pointers: None,
-            bpm: 60.,
-            sample_rate: 44100.,
+            live_pointers: AtomicPtr::new(ptr::null_mut()),
+            active_pointers: AtomicPtr::new(ptr::null_mut()),
+            last_run_pointers: AtomicPtr::new(ptr::null_mut()),
+            fading_pointers: AtomicPtr::new(ptr::null_mut()),
+            fade_position: AtomicUsize::new(0),
+            fade_length: AtomicUsize::new(0),
+            crossfade_seconds: 0.,
+            crossfade_frames: AtomicUsize::new(0),
+            retired_modules: Vec::new(),
+            retired_generations: Vec::new(),
+            last_commit_timings: CommitTimings::default(),
+            globals: Box::new(RuntimeGlobals::new()),
         }
     }
 
-    fn create_module(context: &Context, target: &TargetProperties, name: &str) -> Module {
+    pub fn create_module(context: &Context, target: &TargetProperties, name: &str) -> Module {
         let module = context.create_module(name);
         module.set_target(&target.machine.get_triple().to_string_lossy());
         module.set_data_layout(&target.machine.get_data().get_data_layout());
         module
     }
 
-    fn codegen_lib(context: &Context, target: &TargetProperties) -> Module {
-        let module = Runtime::create_module(context, target, "lib");
-        controls::build_funcs(&module, target);
-        converters::build_funcs(&module);
-        functions::build_funcs(&module, &target);
-        intrinsics::build_intrinsics(&module);
-        globals::build_globals(&module);
-        values::MidiValue::initialize(&module, context);
-        editor::build_convert_num_func(&module, &target, CONVERT_NUM_FUNC_NAME);
-        module
-    }
-
     fn get_affected_surfaces(
         graph: &DependencyGraph,
         blocks: &[BlockRef],
@@ -229,19 +414,68 @@ impl Runtime {
         Vec::from_iter(required_surfaces.into_iter())
     }
 
-    fn deploy_module(jit: &Jit, module: &mut RuntimeModule) {
-        // if the module already has a key, remove it
-        if let Some(key) = module.key {
-            jit.remove(key);
+    // Decides whether an object is optimized in this commit. With tiered compilation objects are
+    // built unoptimized, unless an optimized build is already available, and are optimized later
+    // by `optimize_pending`.
+    fn should_optimize(&self, optimized_name: &str, allow_unoptimized: bool) -> bool {
+        !allow_unoptimized
+            || self.shared_code.has_module(optimized_name)
+            || self
+                .code_cache
+                .as_ref()
+                .map_or(false, |cache| cache.contains(optimized_name))
+    }
+
+    // Builds a module, unless it's already deployed or has been compiled before. Built modules are
+    // added to the compile jobs, and get their object once the jobs are run.
+    fn build_module(
+        &self,
+        name: String,
+        debug_name: &str,
+        optimize: bool,
+        build_funcs: impl FnOnce(&Module),
+        compile_jobs: &mut Vec<CompileJob>,
+    ) -> RuntimeModule {
+        if self.shared_code.acquire_module(&name) {
+            return RuntimeModule::new(name, None, 0);
+        }
+
+        // unoptimized builds are soon replaced, so they aren't cached
+        let code_cache = if optimize {
+            self.code_cache.as_ref()
+        } else {
+            None
+        };
+        if let Some(object) = code_cache.and_then(|cache| cache.load(&name)) {
+            return RuntimeModule::new(name, Some(object), 0);
+        }
+
+        // the IR is released once it's been serialized for compiling
+        let module = Runtime::create_module(&self.context.0, &self.target, debug_name);
+        build_funcs(&module);
+
+        let job = CompileJob::new(name.clone(), &module, optimize);
+        let ir_size = job.ir_size();
+        compile_jobs.push(job);
+        RuntimeModule::new(name, None, ir_size)
+    }
+
+    fn deploy_module(shared_code: &SharedCode, module: &mut RuntimeModule) {
+        // modules without an object were acquired from the shared code when codegen was skipped
+        if let Some(object) = module.object.take() {
+            shared_code.deploy_object(&module.name, &object);
         }
-        let key = jit.deploy(&module.module);
-        module.key = Some(key);
     }
 
-    fn remove_module(jit: &Jit, module: &mut RuntimeModule) {
-        if let Some(key) = module.key {
-            jit.remove(key);
-            module.key = None;
+    fn replace_module(
+        modules: &mut HashMap<u64, RuntimeModule>,
+        id: u64,
+        module: RuntimeModule,
+        retired_modules: &mut Vec<String>,
+    ) {
+        // the old module is retired rather than released, since its code might still be running
+        if let Some(old_module) = modules.insert(id, module) {
+            retired_modules.push(old_module.name);
         }
     }
 
@@ -269,7 +503,7 @@ impl Runtime {
             let id = block.id.id;
             self.block_layouts.insert(
                 id,
-                data_analyzer::build_block_layout(&self.context, &block, &self.target),
+                data_analyzer::build_block_layout(&self.context.0, &block, &self.target),
             );
             self.block_mirs.insert(id, block);
         }
@@ -333,68 +567,117 @@ impl Runtime {
         (new_block_ids, sorted_surfaces)
     }
 
-    fn codegen_blocks(&mut self, block_ids: &[BlockRef]) {
+    fn codegen_blocks(
+        &mut self,
+        block_ids: &[BlockRef],
+        allow_unoptimized: bool,
+        compile_jobs: &mut Vec<CompileJob>,
+    ) {
         for &block_id in block_ids {
+            let mut key = content_key(&self.block_mirs[&block_id], &[]);
+            let optimize = self.should_optimize(
+                &object_module_name("block", block_id, key),
+                allow_unoptimized,
+            );
+            if optimize {
+                self.unoptimized_blocks.remove(&block_id);
+            } else {
+                key = unoptimized_key(key);
+                self.unoptimized_blocks.insert(block_id);
+            }
+            self.block_keys.insert(block_id, key);
+
             let block = &self.block_mirs[&block_id];
+            let module = self.build_module(
+                object_module_name("block", block_id, key),
+                &format!("block.{}.{}", block.id.id, block.id.debug_name),
+                optimize,
+                |module| block::build_funcs(module, self, block),
+                compile_jobs,
+            );
 
-            let module_id = if let Entry::Occupied(old_module) = self.block_modules.entry(block_id)
-            {
-                old_module.get().key
-            } else {
-                None
-            };
-
-            let module = RuntimeModule::new(
-                Runtime::create_module(
-                    &self.context,
-                    &self.target,
-                    &format!("block.{}.{}", block.id.id, block.id.debug_name),
-                ),
-                module_id,
+            Runtime::replace_module(
+                &mut self.block_modules,
+                block_id,
+                module,
+                &mut self.retired_modules,
             );
-            block::build_funcs(&module.module, self, block);
-            self.optimizer.optimize_module(&module.module);
-            self.block_modules.insert(block_id, module);
         }
     }
 
-    fn codegen_surfaces(&mut self, surface_ids: &[SurfaceRef]) {
+    fn codegen_surfaces(
+        &mut self,
+        surface_ids: &[SurfaceRef],
+        allow_unoptimized: bool,
+        compile_jobs: &mut Vec<CompileJob>,
+    ) {
+        // surfaces are sorted so the ones used by a surface have their keys before it
         for &surface_id in surface_ids {
             let surface = &self.surface_mirs[&surface_id];
+            let dependency_keys: Vec<_> = surface
+                .nodes
+                .iter()
+                .filter_map(|node| match node.data {
+                    NodeData::Dummy => None,
+                    NodeData::Custom(block) => Some(self.block_keys[&block]),
+                    NodeData::Group(surface) | NodeData::ExtractGroup { surface, .. } => {
+                        Some(self.surface_keys[&surface])
+                    }
+                }).collect();
+            // the source map isn't used by codegen, and is left out since its order isn't stable
+            let mut key = content_key(
+                &(&surface.id, &surface.groups, &surface.nodes),
+                &dependency_keys,
+            );
+            let optimize = self.should_optimize(
+                &object_module_name("surface", surface_id, key),
+                allow_unoptimized,
+            );
+            if optimize {
+                self.unoptimized_surfaces.remove(&surface_id);
+            } else {
+                key = unoptimized_key(key);
+                self.unoptimized_surfaces.insert(surface_id);
+            }
+            self.surface_keys.insert(surface_id, key);
+
+            let module = self.build_module(
+                object_module_name("surface", surface_id, key),
+                &format!("surface.{}.{}", surface.id.id, surface.id.debug_name),
+                optimize,
+                |module| surface::build_funcs(module, self, surface),
+                compile_jobs,
+            );
 
-            let module_id =
-                if let Entry::Occupied(old_module) = self.surface_modules.entry(surface_id) {
-                    old_module.get().key
-                } else {
-                    None
-                };
-
-            let module = RuntimeModule::new(
-                Runtime::create_module(
-                    &self.context,
-                    &self.target,
-                    &format!("surface.{}.{}", surface.id.id, surface.id.debug_name),
-                ),
-                module_id,
+            Runtime::replace_module(
+                &mut self.surface_modules,
+                surface_id,
+                module,
+                &mut self.retired_modules,
             );
-            surface::build_funcs(&module.module, self, surface);
-            self.optimizer.optimize_module(&module.module);
-            self.surface_modules.insert(surface_id, module);
         }
     }
 
     fn codegen_root(&self, root: &Root) -> Module {
-        let module = Runtime::create_module(&self.context, &self.target, "root");
+        let module = Runtime::create_module(&self.context.0, &self.target, "root");
+        let symbol = |name: &str| generation_symbol(name, self.generation);
+        let update_func_name = symbol(UPDATE_FUNC_NAME);
+
         let initialized_global =
-            root::build_initialized_global(&module, self, 0, INITIALIZED_GLOBAL_NAME);
-        let scratch_global = root::build_scratch_global(&module, self, 0, SCRATCH_GLOBAL_NAME);
-        let sockets_global =
-            root::build_sockets_global(&module, root, SOCKETS_GLOBAL_NAME, PORTALS_GLOBAL_NAME);
+            root::build_initialized_global(&module, self, 0, &symbol(INITIALIZED_GLOBAL_NAME));
+        let scratch_global =
+            root::build_scratch_global(&module, self, 0, &symbol(SCRATCH_GLOBAL_NAME));
+        let sockets_global = root::build_sockets_global(
+            &module,
+            root,
+            &symbol(SOCKETS_GLOBAL_NAME),
+            &symbol(PORTALS_GLOBAL_NAME),
+        );
         let pointers_global = root::build_pointers_global(
             &module,
             self,
             0,
-            POINTERS_GLOBAL_NAME,
+            &symbol(POINTERS_GLOBAL_NAME),
             initialized_global.as_pointer_value(),
             scratch_global.as_pointer_value(),
             sockets_global.sockets.as_pointer_value(),
@@ -403,12 +686,17 @@ impl Runtime {
             &module,
             self,
             0,
-            CONSTRUCT_FUNC_NAME,
-            UPDATE_FUNC_NAME,
-            DESTRUCT_FUNC_NAME,
+            &symbol(CONSTRUCT_FUNC_NAME),
+            &update_func_name,
+            &symbol(DESTRUCT_FUNC_NAME),
             pointers_global.as_pointer_value(),
         );
-        self.optimizer.optimize_module(&module);
+        root::build_block_func(
+            &module,
+            self,
+            &symbol(UPDATE_BLOCK_FUNC_NAME),
+            &update_func_name,
+        );
         module
     }
 
@@ -416,72 +704,245 @@ impl Runtime {
         &mut self,
         new_block_ids: &[BlockRef],
         affected_surfaces: &[SurfaceRef],
+        allow_unoptimized: bool,
     ) {
-        self.codegen_blocks(new_block_ids);
-        self.codegen_surfaces(affected_surfaces);
+        // Building IR uses the layouts, which are in the runtime's context, so modules are built
+        // one at a time. Optimizing and compiling them takes most of the time, and is done in
+        // parallel once they're all built.
+        let mut compile_jobs = Vec::new();
+        self.codegen_blocks(new_block_ids, allow_unoptimized, &mut compile_jobs);
+        self.codegen_surfaces(affected_surfaces, allow_unoptimized, &mut compile_jobs);
+
+        let mut objects = object_compiler::compile_objects(
+            compile_jobs,
+            self.target.profile,
+            self.code_cache.as_ref(),
+            self.compile_threads,
+        );
+        let modules = self
+            .block_modules
+            .values_mut()
+            .chain(self.surface_modules.values_mut());
+        for module in modules {
+            if let Some(object) = objects.remove(&module.name) {
+                module.set_object(object);
+            }
+        }
 
-        self.root.1.module = self.codegen_root(&self.root.0);
+        // the root is compiled here as well, so the JIT doesn't need its own copy of the IR
+        let root_name = format!("root.{}", self.generation);
+        let root_job = CompileJob::new(root_name.clone(), &self.codegen_root(&self.root.0), true);
+        let root_object = object_compiler::compile_object(root_job, self.target.profile);
+        let root_module = RuntimeModule::new(root_name, Some(root_object), 0);
+        if let Some(old_root_module) = mem::replace(&mut self.root.1, Some(root_module)) {
+            self.retired_modules.push(old_root_module.name);
+        }
     }
 
     fn deploy_transaction(&mut self, block_ids: &[BlockRef], affected_surfaces: &[SurfaceRef]) {
         for block in block_ids {
-            Runtime::deploy_module(&self.jit, self.block_modules.get_mut(block).unwrap());
+            Runtime::deploy_module(&self.shared_code, self.block_modules.get_mut(block).unwrap());
         }
         for surface in affected_surfaces {
-            Runtime::deploy_module(&self.jit, self.surface_modules.get_mut(surface).unwrap());
+            Runtime::deploy_module(
+                &self.shared_code,
+                self.surface_modules.get_mut(surface).unwrap(),
+            );
         }
 
-        Runtime::deploy_module(&self.jit, &mut self.root.1);
-        self.runtime_pointers = Some(RuntimePointers::new(&self.jit));
+        if let Some(ref mut root_module) = self.root.1 {
+            Runtime::deploy_module(&self.shared_code, root_module);
+        }
+        self.runtime_pointers = Some(Box::new(RuntimePointers::new(
+            &self.shared_code,
+            self.generation,
+            StateMap::new(self, 0),
+            &self.root.0,
+        )));
     }
 
+    // Switches to the shared code for a different profile. Every deployed module is retired along
+    // with the code it was deployed to, so everything needs to be rebuilt.
+    fn set_profile(&mut self, profile: OptimizationProfile) {
+        self.target.profile = profile;
+        let code_cache = self
+            .code_cache
+            .take()
+            .map(|cache| CodeCache::new(cache.directory().to_path_buf(), &self.target));
+        self.code_cache = code_cache;
+
+        let shared_code = SharedCode::get(&self.target, self.code_cache.as_ref());
+        let worker_threads = self.shared_code.get_worker_threads();
+        if worker_threads > 0 && shared_code.get_worker_threads() == 0 {
+            shared_code.set_worker_threads(worker_threads);
+        }
+        self.live_shared_code.store(
+            &*shared_code as *const SharedCode as *mut SharedCode,
+            Ordering::SeqCst,
+        );
+        self.retired_shared_code = Some(mem::replace(&mut self.shared_code, shared_code));
+
+        let retired_modules = &mut self.retired_modules;
+        retired_modules.extend(self.block_modules.drain().map(|(_, module)| module.name));
+        retired_modules.extend(self.surface_modules.drain().map(|(_, module)| module.name));
+        retired_modules.extend(self.root.1.take().map(|module| module.name));
+    }
+
+    /// Builds and constructs a new generation from the transaction. The new code is deployed
+    /// alongside the old, which keeps running on the audio thread until `publish` is called. If
+    /// the transaction changes the profile, everything is rebuilt.
     pub fn commit(&mut self, transaction: Transaction) {
+        let new_profile = transaction
+            .profile
+            .filter(|&profile| profile != self.target.profile);
+
         // if the transaction is empty, early exit
         if transaction.surfaces.is_empty()
             && transaction.blocks.is_empty()
             && transaction.root.is_none()
+            && new_profile.is_none()
         {
             return;
         }
 
-        // run destructors on old data before beginning
-        if let Some(ref pointers) = self.runtime_pointers {
-            unsafe {
-                (pointers.destruct)();
-            }
+        // clean up anything the audio thread has finished with since the last publish
+        self.reclaim();
+        if let Some(profile) = new_profile {
+            self.set_profile(profile);
         }
 
         let patch_start = Instant::now();
-        let (new_block_ids, affected_surfaces) = self.patch_transaction(transaction);
-        println!(
-            "Patch took {}s",
-            precise_duration_seconds(&patch_start.elapsed())
+        let (mut new_block_ids, mut affected_surfaces) = self.patch_transaction(transaction);
+        if new_profile.is_some() {
+            // nothing was kept from the old profile, so everything is built again
+            new_block_ids = self.block_mirs.keys().cloned().collect();
+            let all_surfaces = HashSet::from_iter(self.surface_mirs.keys().cloned());
+            affected_surfaces = self.graph.get_sorted_surfaces(&all_surfaces);
+            affected_surfaces.reverse();
+        }
+        let patch_seconds = precise_duration_seconds(&patch_start.elapsed());
+        println!("Patch took {}s", patch_seconds);
+
+        let allow_unoptimized = self.tiered_compilation;
+        self.build_generation(
+            &new_block_ids,
+            &affected_surfaces,
+            patch_seconds,
+            allow_unoptimized,
         );
+    }
+
+    /// Rebuilds everything that tiered compilation built unoptimized with full optimization, as a
+    /// new generation. The generation is published in the same way as a commit. Returns false if
+    /// there was nothing to optimize, in which case no generation is built.
+    pub fn optimize_pending(&mut self) -> bool {
+        if self.unoptimized_blocks.is_empty() && self.unoptimized_surfaces.is_empty() {
+            return false;
+        }
+
+        self.reclaim();
+
+        let patch_start = Instant::now();
+        let block_ids = Vec::from_iter(self.unoptimized_blocks.iter().cloned());
+        let surface_ids = Vec::from_iter(self.unoptimized_surfaces.iter().cloned());
+
+        // surfaces using the optimized objects are rebuilt too, since the symbols they use change
+        let affected_surfaces = HashSet::from_iter(Runtime::get_affected_surfaces(
+            &self.graph,
+            &block_ids,
+            &surface_ids,
+        ));
+        let mut sorted_surfaces = self.graph.get_sorted_surfaces(&affected_surfaces);
+        sorted_surfaces.reverse();
+        let patch_seconds = precise_duration_seconds(&patch_start.elapsed());
+
+        self.build_generation(&block_ids, &sorted_surfaces, patch_seconds, false);
+        true
+    }
+
+    // Builds, deploys and constructs a new generation from the patched objects, retiring the
+    // current one.
+    fn build_generation(
+        &mut self,
+        new_block_ids: &[BlockRef],
+        affected_surfaces: &[SurfaceRef],
+        patch_seconds: f64,
+        allow_unoptimized: bool,
+    ) {
+        self.generation = self.shared_code.next_generation();
+        let old_pointers = self.runtime_pointers.take();
 
         let codegen_start = Instant::now();
-        self.codegen_transaction(&new_block_ids, &affected_surfaces);
-        println!(
-            "Codegen took {}s",
-            precise_duration_seconds(&codegen_start.elapsed())
-        );
+        self.codegen_transaction(new_block_ids, affected_surfaces, allow_unoptimized);
+        let codegen_seconds = precise_duration_seconds(&codegen_start.elapsed());
+        println!("Codegen took {}s", codegen_seconds);
 
         let deploy_start = Instant::now();
-        self.deploy_transaction(&new_block_ids, &affected_surfaces);
-        println!(
-            "Deploy took {}s",
-            precise_duration_seconds(&deploy_start.elapsed())
-        );
+        self.deploy_transaction(new_block_ids, affected_surfaces);
+        let deploy_seconds = precise_duration_seconds(&deploy_start.elapsed());
+        println!("Deploy took {}s", deploy_seconds);
+
+        self.last_commit_timings = CommitTimings {
+            patch_seconds,
+            codegen_seconds,
+            deploy_seconds,
+        };
 
-        // reset the BPM and sample rate
-        Runtime::set_vector(self.library_pointers.bpm_ptr, self.bpm);
-        Runtime::set_vector(self.library_pointers.samplerate_ptr, self.sample_rate);
+        // reset the noise streams, so noise nodes in the new generation get the same streams each
+        // time the same patch is built with the same seed
+        self.globals.noise_stream = UnsafeCell::new(0);
 
         if let Some(ref pointers) = self.runtime_pointers {
             // run the new constructor
+            let _globals = self.globals.enter();
             unsafe {
                 (pointers.construct)();
             }
         }
+
+        // the old generation is destructed once the audio thread has moved on from it
+        let retired_shared_code = match self.retired_shared_code.take() {
+            Some(shared_code) => shared_code,
+            None => self.shared_code.clone(),
+        };
+        self.retired_generations.push(RetiredGeneration {
+            pointers: old_pointers,
+            shared_code: retired_shared_code,
+            modules: mem::replace(&mut self.retired_modules, Vec::new()),
+        });
+    }
+
+    /// Makes the most recently committed generation the one the audio thread runs. This is a
+    /// single atomic store, so it never waits on the audio thread. The audio thread moves the state
+    /// of blocks that haven't changed over to the new generation before it first runs it.
+    pub fn publish(&mut self) {
+        let pointers = match self.runtime_pointers {
+            Some(ref pointers) => &**pointers as *const RuntimePointers as *mut RuntimePointers,
+            None => ptr::null_mut(),
+        };
+        self.live_pointers.store(pointers, Ordering::SeqCst);
+        self.reclaim();
+    }
+
+    // Generations are reclaimed in the order they were retired, since a module retired with a
+    // newer generation might still be used by the destructor of an older one.
+    fn reclaim(&mut self) {
+        let live = self.live_pointers.load(Ordering::SeqCst);
+        let active = self.active_pointers.load(Ordering::SeqCst);
+        let last_run = self.last_run_pointers.load(Ordering::SeqCst);
+        let fading = self.fading_pointers.load(Ordering::SeqCst);
+        let reading_shared_code = self.reading_shared_code.load(Ordering::SeqCst);
+        let reclaim_count = self
+            .retired_generations
+            .iter()
+            .take_while(|generation| {
+                !generation.is_in_use(live, active, last_run, fading, reading_shared_code)
+            }).count();
+
+        let _globals = self.globals.enter();
+        for generation in self.retired_generations.drain(..reclaim_count) {
+            generation.reclaim();
+        }
     }
 
     /// Remove any objects that aren't referenced by others (and aren't the root).
@@ -491,7 +952,11 @@ impl Runtime {
         let surface_layouts = &mut self.surface_layouts;
         let block_mirs = &mut self.block_mirs;
         let block_layouts = &mut self.block_layouts;
-        let jit = &self.jit;
+        let block_keys = &mut self.block_keys;
+        let surface_keys = &mut self.surface_keys;
+        let unoptimized_blocks = &mut self.unoptimized_blocks;
+        let unoptimized_surfaces = &mut self.unoptimized_surfaces;
+        let retired_modules = &mut self.retired_modules;
 
         // we can now remove any objects that don't exist in the graph
         self.surface_modules.retain(|&key, module| {
@@ -500,7 +965,9 @@ impl Runtime {
             } else {
                 surface_mirs.remove(&key);
                 surface_layouts.remove(&key);
-                Runtime::remove_module(jit, module);
+                surface_keys.remove(&key);
+                unoptimized_surfaces.remove(&key);
+                retired_modules.push(module.name.clone());
                 false
             }
         });
@@ -510,15 +977,181 @@ impl Runtime {
             } else {
                 block_mirs.remove(&key);
                 block_layouts.remove(&key);
-                Runtime::remove_module(jit, module);
+                block_keys.remove(&key);
+                unoptimized_blocks.remove(&key);
+                retired_modules.push(module.name.clone());
                 false
             }
         });
     }
 
+    // Marks the published generation as being run, so `reclaim` won't free it from under us. This
+    // assumes only one thread (the audio thread) runs the runtime at a time.
+    fn acquire_live_pointers(&self) -> *mut RuntimePointers {
+        loop {
+            let pointers = self.live_pointers.load(Ordering::SeqCst);
+            self.active_pointers.store(pointers, Ordering::SeqCst);
+
+            // if a publish happened in between, the generation we loaded may have been reclaimed
+            if self.live_pointers.load(Ordering::SeqCst) == pointers {
+                return pointers;
+            }
+        }
+    }
+
+    fn release_live_pointers(&self) {
+        self.active_pointers.store(ptr::null_mut(), Ordering::SeqCst);
+    }
+
+    // Runs the function with the current shared code, marking it as being read so `reclaim` won't
+    // free it if the profile changes in the meantime. Generations hold on to the code they were
+    // deployed to, so the audio thread uses theirs instead. This assumes only one thread (the
+    // control thread) calls it at a time.
+    fn with_live_shared_code<T>(&self, func: impl FnOnce(&SharedCode) -> T) -> T {
+        let shared_code = loop {
+            let shared_code = self.live_shared_code.load(Ordering::SeqCst);
+            self.reading_shared_code.store(shared_code, Ordering::SeqCst);
+
+            // if the profile changed in between, the code we loaded may have been reclaimed
+            if self.live_shared_code.load(Ordering::SeqCst) == shared_code {
+                break shared_code;
+            }
+        };
+
+        let result = func(unsafe { &*shared_code });
+        self.reading_shared_code.store(ptr::null_mut(), Ordering::SeqCst);
+        result
+    }
+
+    // Called by the audio thread before running a generation. If a newer generation has been
+    // published since the last one it ran, the state of the last one is moved over. If some of the
+    // state can't be moved (because blocks were changed or removed), the last generation is
+    // crossfaded out instead, keeping its state, and the new one starts with a copy of the state
+    // that can be carried over. Blocks that are the same in both then give the same output in
+    // both, so the fade is only heard on the blocks that couldn't be carried over. The last
+    // generation isn't reclaimed until this has happened, and it isn't running any more, so nothing
+    // else is touching either generation.
+    unsafe fn switch_generation(&self, pointers: &RuntimePointers, can_crossfade: bool) {
+        let pointers_ptr = pointers as *const RuntimePointers as *mut RuntimePointers;
+        let last_run_ptr = self.last_run_pointers.load(Ordering::SeqCst);
+        if last_run_ptr == pointers_ptr {
+            return;
+        }
+
+        // a crossfade that's still running is cut short
+        self.fading_pointers.store(ptr::null_mut(), Ordering::SeqCst);
+
+        if let Some(last_run) = last_run_ptr.as_ref() {
+            let crossfade_frames = self.crossfade_frames.load(Ordering::Relaxed);
+            let should_crossfade = can_crossfade
+                && crossfade_frames > 0
+                && last_run.portals_key == pointers.portals_key
+                && !StateMap::can_move_all(&last_run.state_map, &pointers.state_map);
+
+            if should_crossfade {
+                StateMap::copy_state(
+                    &last_run.state_map,
+                    last_run.scratch_ptr as *const u8,
+                    &pointers.state_map,
+                    pointers.scratch_ptr as *mut u8,
+                );
+                self.fade_position.store(0, Ordering::Relaxed);
+                self.fade_length.store(crossfade_frames, Ordering::Relaxed);
+                self.fading_pointers.store(last_run_ptr, Ordering::SeqCst);
+            } else {
+                StateMap::swap_state(
+                    &last_run.state_map,
+                    last_run.scratch_ptr as *mut u8,
+                    &pointers.state_map,
+                    pointers.scratch_ptr as *mut u8,
+                );
+            }
+        }
+        self.last_run_pointers.store(pointers_ptr, Ordering::SeqCst);
+    }
+
+    /// Runs a single frame. Generations aren't crossfaded when running frames one at a time, since
+    /// their output isn't written anywhere, so a crossfade that's running is cut short.
     pub unsafe fn run_update(&self) {
-        if let Some(ref pointers) = self.runtime_pointers {
+        let _globals = self.globals.enter();
+        if let Some(pointers) = self.acquire_live_pointers().as_ref() {
+            let worker_pool = (*pointers.shared_code).active_worker_pool();
+            if let Some(pool) = worker_pool {
+                pool.begin_block();
+            }
+
+            self.switch_generation(pointers, false);
+            self.fading_pointers.store(ptr::null_mut(), Ordering::SeqCst);
             (pointers.update)();
+
+            if let Some(pool) = worker_pool {
+                pool.end_block();
+            }
+        }
+        self.release_live_pointers();
+    }
+
+    pub unsafe fn run_block(
+        &self,
+        frames: u32,
+        inputs: *const PortalBuffer,
+        input_count: u32,
+        outputs: *const PortalBuffer,
+        output_count: u32,
+    ) {
+        let _globals = self.globals.enter();
+        if let Some(pointers) = self.acquire_live_pointers().as_ref() {
+            // workers sleep between blocks, and are woken for the length of this one
+            let worker_pool = (*pointers.shared_code).active_worker_pool();
+            if let Some(pool) = worker_pool {
+                pool.begin_block();
+            }
+
+            self.switch_generation(pointers, true);
+            match self.fading_pointers.load(Ordering::SeqCst).as_ref() {
+                Some(fading) => self.run_crossfade_block(
+                    fading,
+                    pointers,
+                    frames,
+                    portal_buffers(inputs, input_count),
+                    portal_buffers(outputs, output_count),
+                ),
+                None => (pointers.update_block)(frames, inputs, input_count, outputs, output_count),
+            }
+
+            if let Some(pool) = worker_pool {
+                pool.end_block();
+            }
+        }
+        self.release_live_pointers();
+    }
+
+    unsafe fn run_crossfade_block(
+        &self,
+        fading: &RuntimePointers,
+        pointers: &RuntimePointers,
+        frames: u32,
+        inputs: &[PortalBuffer],
+        outputs: &[PortalBuffer],
+    ) {
+        let fade_position = self.fade_position.load(Ordering::Relaxed);
+        let fade_length = self.fade_length.load(Ordering::Relaxed);
+        (*pointers.crossfade_buffers.get()).run(
+            &fading.crossfade_generation(),
+            &pointers.crossfade_generation(),
+            frames as usize,
+            inputs,
+            outputs,
+            fade_position,
+            fade_length,
+        );
+
+        // once the fade is over, the old generation can be reclaimed
+        let fade_position = fade_position + frames as usize;
+        if fade_position >= fade_length {
+            self.fading_pointers.store(ptr::null_mut(), Ordering::SeqCst);
+        } else {
+            self.fade_position.store(fade_position, Ordering::Relaxed);
         }
     }
 
@@ -539,30 +1172,77 @@ impl Runtime {
         }
     }
 
-    fn set_vector(ptr: *mut c_void, value: f32) {
-        let vec_ptr = ptr as *mut (f32, f32);
-        unsafe {
-            (*vec_ptr).0 = value;
-            (*vec_ptr).1 = value;
-        }
-    }
-
     pub fn set_bpm(&mut self, bpm: f32) {
-        self.bpm = bpm;
-        Runtime::set_vector(self.library_pointers.bpm_ptr, bpm);
+        self.globals.bpm = [bpm, bpm];
     }
 
     pub fn get_bpm(&self) -> f32 {
-        self.bpm
+        self.globals.bpm[0]
     }
 
     pub fn set_sample_rate(&mut self, sample_rate: f32) {
-        self.sample_rate = sample_rate;
-        Runtime::set_vector(self.library_pointers.samplerate_ptr, sample_rate);
+        self.globals.sample_rate = [sample_rate, sample_rate];
+        self.update_crossfade_frames();
     }
 
     pub fn get_sample_rate(&self) -> f32 {
-        self.sample_rate
+        self.globals.sample_rate[0]
+    }
+
+    /// Sets the seed noise nodes derive their streams from. Each noise node gets its own stream
+    /// when it's constructed, so the seed applies to nodes built by later commits, and nodes whose
+    /// state is kept across a commit carry on with the stream they had. Rendering the same patch
+    /// from a fresh runtime with the same seed gives the same noise.
+    pub fn set_noise_seed(&mut self, seed: u32) {
+        self.globals.noise_seed = seed;
+        self.globals.noise_stream = UnsafeCell::new(0);
+    }
+
+    pub fn get_noise_seed(&self) -> u32 {
+        self.globals.noise_seed
+    }
+
+    /// Returns how long each phase of the last non-empty commit took.
+    pub fn get_last_commit_timings(&self) -> CommitTimings {
+        self.last_commit_timings
+    }
+
+    /// Sets how many worker threads the voices of extracted surfaces are run on, in addition to the
+    /// audio thread. With no workers everything is run on the audio thread.
+    /// Workers are shared with every runtime sharing code with this one.
+    pub fn set_worker_threads(&mut self, count: usize) {
+        self.with_live_shared_code(|shared_code| shared_code.set_worker_threads(count));
+    }
+
+    pub fn get_worker_threads(&self) -> usize {
+        self.with_live_shared_code(|shared_code| shared_code.get_worker_threads())
+    }
+
+    /// Sets how many threads blocks and surfaces are optimized and compiled on during a commit.
+    pub fn set_compile_threads(&mut self, count: usize) {
+        self.compile_threads = count.max(1);
+    }
+
+    /// Sets how long the audio thread crossfades from the old generation to a new one when it
+    /// can't move all of the old generation's state over, such as when a block is removed or its
+    /// functions change. The old generation keeps its state and runs for the length of the fade,
+    /// and the new one starts with a copy of the state of the blocks that haven't changed, except
+    /// for delays, which start empty. A length of zero switches straight over, moving the state
+    /// that can be moved. Fades only happen between generations with the same portals.
+    pub fn set_crossfade_time(&mut self, seconds: f32) {
+        self.crossfade_seconds = seconds.max(0.);
+        self.update_crossfade_frames();
+    }
+
+    fn update_crossfade_frames(&self) {
+        let frames = (self.crossfade_seconds * self.get_sample_rate()).round() as usize;
+        self.crossfade_frames.store(frames, Ordering::Relaxed);
+    }
+
+    /// With tiered compilation, commits build changed objects without optimization so they can be
+    /// heard sooner. `optimize_pending` then replaces them with optimized builds.
+    pub fn set_tiered_compilation(&mut self, tiered_compilation: bool) {
+        self.tiered_compilation = tiered_compilation;
     }
 
     pub fn is_node_extracted(&self, surface: SurfaceRef, node: usize) -> bool {
@@ -577,7 +1257,10 @@ impl Runtime {
     }
 
     pub fn convert_num(&self, result: *mut c_void, target_form: i8, num: *const c_void) {
-        unsafe { (self.library_pointers.convert_num)(result, target_form, num) }
+        let _globals = self.globals.enter();
+        self.with_live_shared_code(|shared_code| unsafe {
+            (shared_code.library_pointers().convert_num)(result, target_form, num)
+        })
     }
 
     pub fn print_mir(&self) {
@@ -594,20 +1277,46 @@ impl Runtime {
         println!("<< End MIR");
     }
 
+    /// Prints the optimized IR of every module. IR isn't kept once it's compiled, so it's built
+    /// again from the MIR.
     pub fn print_modules(&self) {
-        for module in self.block_modules.values() {
-            module.module.print_to_stderr();
+        let mut jobs = Vec::new();
+        for block in self.block_mirs.values() {
+            let debug_name = format!("block.{}.{}", block.id.id, block.id.debug_name);
+            let module = Runtime::create_module(&self.context.0, &self.target, &debug_name);
+            block::build_funcs(&module, self, block);
+            jobs.push(CompileJob::new(debug_name, &module, true));
         }
-        for module in self.surface_modules.values() {
-            module.module.print_to_stderr();
+        for surface in self.surface_mirs.values() {
+            let debug_name = format!("surface.{}.{}", surface.id.id, surface.id.debug_name);
+            let module = Runtime::create_module(&self.context.0, &self.target, &debug_name);
+            surface::build_funcs(&module, self, surface);
+            jobs.push(CompileJob::new(debug_name, &module, true));
         }
-        self.root.1.module.print_to_stderr();
+        let root_module = self.codegen_root(&self.root.0);
+        jobs.push(CompileJob::new("root".to_string(), &root_module, true));
+        object_compiler::print_optimized_modules(&jobs, self.target.profile);
+    }
+
+    pub fn get_memory_usage(&self) -> MemoryUsage {
+        let modules = self
+            .block_modules
+            .values()
+            .chain(self.surface_modules.values())
+            .chain(self.root.1.iter());
+        let mut usage = MemoryUsage::default();
+        for module in modules {
+            usage.module_count += 1;
+            usage.object_bytes += module.object_size as u64;
+            usage.released_ir_bytes += module.ir_size as u64;
+        }
+        usage
     }
 }
 
 impl ObjectCache for Runtime {
     fn context(&self) -> &Context {
-        &self.context
+        &self.context.0
     }
 
     fn target(&self) -> &TargetProperties {
@@ -629,23 +1338,56 @@ impl ObjectCache for Runtime {
     fn block_layout(&self, id: BlockRef) -> Option<&data_analyzer::BlockLayout> {
         self.block_layouts.get(&id)
     }
+
+    fn surface_key(&self, id: SurfaceRef) -> u64 {
+        self.surface_keys[&id]
+    }
+
+    fn block_key(&self, id: BlockRef) -> u64 {
+        self.block_keys[&id]
+    }
 }
 
 impl IdAllocator for Runtime {
     fn alloc_id(&mut self) -> u64 {
-        let take_id = self.next_id;
-        self.next_id += 1;
-        take_id
+        self.next_id.fetch_add(1, Ordering::Relaxed) as u64
     }
 }
 
 impl Drop for Runtime {
     fn drop(&mut self) {
+        // the audio thread must be stopped by now, so everything can be destructed
+        self.live_pointers.store(ptr::null_mut(), Ordering::SeqCst);
+        self.last_run_pointers.store(ptr::null_mut(), Ordering::SeqCst);
+        self.fading_pointers.store(ptr::null_mut(), Ordering::SeqCst);
+        self.reclaim();
+
         if let Some(ref pointers) = self.runtime_pointers {
+            let _globals = self.globals.enter();
             unsafe {
                 (pointers.destruct)();
             }
         }
+
+        // release our references to the shared code
+        let modules = self
+            .block_modules
+            .values()
+            .chain(self.surface_modules.values())
+            .chain(self.root.1.iter())
+            .map(|module| &module.name)
+            .chain(self.retired_modules.iter());
+        for module in modules {
+            self.shared_code.release_module(module);
+        }
+    }
+}
+
+unsafe fn portal_buffers<'a>(buffers: *const PortalBuffer, count: u32) -> &'a [PortalBuffer] {
+    if count == 0 {
+        &[]
+    } else {
+        slice::from_raw_parts(buffers, count as usize)
     }
 }
 
@@ -0,0 +1,71 @@
+use std::cell::{Cell, UnsafeCell};
+use std::ptr;
+
+/// The globals generated code reads from the runtime it's being run by, rather than from the
+/// library, since runtimes sharing code can run at different sample rates and tempos, and each
+/// give their noise nodes streams from their own seed. Must match the layout of the type returned
+/// by `globals::get_runtime_globals_type`.
+#[repr(C, align(8))]
+#[derive(Debug)]
+pub struct RuntimeGlobals {
+    pub sample_rate: [f32; 2],
+    pub bpm: [f32; 2],
+    pub noise_seed: u32,
+    // Taken by each noise node as it's constructed, so it's written by generated code.
+    pub noise_stream: UnsafeCell<u32>,
+}
+
+impl RuntimeGlobals {
+    pub fn new() -> Self {
+        RuntimeGlobals {
+            sample_rate: [44100., 44100.],
+            bpm: [60., 60.],
+            noise_seed: 0,
+            noise_stream: UnsafeCell::new(0),
+        }
+    }
+
+    /// Makes these the globals generated code run on this thread sees, until the returned guard is
+    /// dropped. Worker pool jobs pass the globals of the thread dispatching them on to the workers.
+    pub fn enter(&self) -> RuntimeGlobalsGuard {
+        let previous = CURRENT_GLOBALS.with(|current| current.get());
+        set_current(self as *const RuntimeGlobals as *mut RuntimeGlobals);
+        RuntimeGlobalsGuard { previous }
+    }
+}
+
+pub struct RuntimeGlobalsGuard {
+    previous: *mut RuntimeGlobals,
+}
+
+impl Drop for RuntimeGlobalsGuard {
+    fn drop(&mut self) {
+        set_current(self.previous);
+    }
+}
+
+thread_local! {
+    static CURRENT_GLOBALS: Cell<*mut RuntimeGlobals> = Cell::new(ptr::null_mut());
+
+    // Used by code run outside of a runtime, so a missing `enter` doesn't crash generated code.
+    static DEFAULT_GLOBALS: UnsafeCell<RuntimeGlobals> = UnsafeCell::new(RuntimeGlobals::new());
+}
+
+pub fn current() -> *mut RuntimeGlobals {
+    CURRENT_GLOBALS.with(|current| current.get())
+}
+
+pub fn set_current(globals: *mut RuntimeGlobals) {
+    CURRENT_GLOBALS.with(|current| current.set(globals));
+}
+
+/// Called by generated code to find the globals of the runtime running it. The JIT is given this
+/// function as a builtin when it's created.
+pub extern "C" fn maxim_get_runtime_globals() -> *mut RuntimeGlobals {
+    let globals = current();
+    if globals.is_null() {
+        DEFAULT_GLOBALS.with(|globals| globals.get())
+    } else {
+        globals
+    }
+}
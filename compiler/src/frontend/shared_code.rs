@@ -0,0 +1,305 @@
+use super::buffer_pool::{
+    maxim_free_buffer, maxim_prepare_buffer, maxim_resize_buffer, BufferPool,
+};
+use super::code_cache::CodeCache;
+use super::jit::{Jit, JitKey};
+use super::object_compiler::{compile_object, CompileJob};
+use super::runtime_globals::maxim_get_runtime_globals;
+use super::worker_pool::{maxim_dispatch_voices, WorkerPool};
+use super::Runtime;
+use codegen::{
+    controls, converters, editor, functions, globals, intrinsics, surface, values,
+    OptimizationProfile, TargetProperties,
+};
+use inkwell::context::Context;
+use inkwell::module::Module;
+use std::collections::HashMap;
+use std::mem;
+use std::os::raw::c_void;
+use std::ptr;
+use std::sync::atomic::{AtomicPtr, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex, Weak};
+
+pub const CONVERT_NUM_FUNC_NAME: &str = "maxim.editor.convert_num";
+
+const LIBRARY_MODULE_NAME: &str = "lib";
+
+#[derive(Debug)]
+pub struct LibraryPointers {
+    pub worker_pool_ptr: *mut c_void,
+    pub buffer_pool_ptr: *mut c_void,
+    pub convert_num: unsafe extern "C" fn(*mut c_void, i8, *const c_void),
+}
+
+impl LibraryPointers {
+    /// Finds the library's symbols in the JIT. Returns `None` if any of them are missing.
+    pub fn new(jit: &Jit) -> Option<Self> {
+        let get_address = |name: &str| match jit.get_symbol_address(name) as usize {
+            0 => None,
+            address => Some(address),
+        };
+
+        let worker_pool_ptr_address = get_address(globals::WORKER_POOL_GLOBAL_NAME)?;
+        let buffer_pool_ptr_address = get_address(globals::BUFFER_POOL_GLOBAL_NAME)?;
+        let convert_num_address = get_address(CONVERT_NUM_FUNC_NAME)?;
+
+        Some(LibraryPointers {
+            worker_pool_ptr: worker_pool_ptr_address as *mut c_void,
+            buffer_pool_ptr: buffer_pool_ptr_address as *mut c_void,
+            convert_num: unsafe { mem::transmute(convert_num_address) },
+        })
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+struct SharedCodeKey {
+    include_ui: bool,
+    profile: OptimizationProfile,
+}
+
+impl SharedCodeKey {
+    fn new(target: &TargetProperties) -> Self {
+        SharedCodeKey {
+            include_ui: target.include_ui,
+            profile: target.profile,
+        }
+    }
+}
+
+#[derive(Debug)]
+struct SharedModule {
+    key: JitKey,
+    references: usize,
+}
+
+lazy_static! {
+    static ref SHARED_CODE: Mutex<HashMap<SharedCodeKey, Weak<SharedCode>>> =
+        Mutex::new(HashMap::new());
+}
+
+/// A JIT and library shared by every runtime in the process built with the same target
+/// properties. Compiled objects are deployed under names that identify their content, and are
+/// reference counted so runtimes building the same objects share the same machine code.
+///
+/// Since the library is shared, so are its globals: runtimes sharing code also share the worker
+/// pool. The sample rate, BPM and noise streams are kept by each runtime, and are found by generated code through
+/// `maxim_get_runtime_globals`.
+#[derive(Debug)]
+pub struct SharedCode {
+    jit: Jit,
+    library_pointers: LibraryPointers,
+    modules: Mutex<HashMap<String, SharedModule>>,
+    next_generation: AtomicUsize,
+    worker_pool: Mutex<Option<Box<WorkerPool>>>,
+    // Pools are stopped but not freed when they're replaced, since other runtimes might still be
+    // dispatching to them.
+    retired_worker_pools: Mutex<Vec<Box<WorkerPool>>>,
+    // Boxed so the library's pointer to it stays valid.
+    buffer_pool: Box<BufferPool>,
+}
+
+unsafe impl Send for SharedCode {}
+unsafe impl Sync for SharedCode {}
+
+impl SharedCode {
+    /// Returns the shared code for runtimes with the target's properties, building it if no
+    /// runtime is using it. The library is loaded from the code cache if it's been compiled by a
+    /// previous process.
+    pub fn get(target: &TargetProperties, code_cache: Option<&CodeCache>) -> Arc<SharedCode> {
+        let key = SharedCodeKey::new(target);
+        let mut shared_codes = SHARED_CODE.lock().unwrap();
+        if let Some(shared_code) = shared_codes.get(&key).and_then(|weak| weak.upgrade()) {
+            return shared_code;
+        }
+
+        let shared_code = Arc::new(SharedCode::new(target, code_cache));
+        shared_codes.insert(key, Arc::downgrade(&shared_code));
+        shared_code
+    }
+
+    fn new(target: &TargetProperties, code_cache: Option<&CodeCache>) -> Self {
+        let jit = Jit::new();
+        jit.add_builtin(
+            globals::RUNTIME_GLOBALS_FUNC_NAME,
+            maxim_get_runtime_globals as *mut c_void,
+        );
+        jit.add_builtin(
+            surface::DISPATCH_VOICES_FUNC_NAME,
+            maxim_dispatch_voices as *mut c_void,
+        );
+        jit.add_builtin(
+            intrinsics::RESIZE_BUFFER_FUNC_NAME,
+            maxim_resize_buffer as *mut c_void,
+        );
+        jit.add_builtin(
+            intrinsics::FREE_BUFFER_FUNC_NAME,
+            maxim_free_buffer as *mut c_void,
+        );
+        jit.add_builtin(
+            intrinsics::PREPARE_BUFFER_FUNC_NAME,
+            maxim_prepare_buffer as *mut c_void,
+        );
+
+        // deploy the library to the JIT, rebuilding it if the cached one doesn't have everything
+        // this build expects
+        let cached_library = code_cache.and_then(|cache| cache.load(LIBRARY_MODULE_NAME));
+        let cached_pointers = cached_library.and_then(|object| {
+            let key = jit.deploy_object(&object);
+            let library_pointers = LibraryPointers::new(&jit);
+            if library_pointers.is_none() {
+                eprintln!("Cached library is missing symbols, rebuilding it");
+                jit.remove(key);
+            }
+            library_pointers
+        });
+        let library_pointers = match cached_pointers {
+            Some(library_pointers) => library_pointers,
+            None => {
+                // the library's IR isn't needed once it's compiled, so it's built in its own
+                // context
+                let context = Context::create();
+                let library_module = SharedCode::codegen_lib(&context, target);
+                let job = CompileJob::new(LIBRARY_MODULE_NAME.to_string(), &library_module, true);
+                let object = compile_object(job, target.profile);
+                if let Some(cache) = code_cache {
+                    cache.store(LIBRARY_MODULE_NAME, &object);
+                }
+                jit.deploy_object(&object);
+                LibraryPointers::new(&jit).expect("Built library is missing symbols")
+            }
+        };
+
+        // the pool lives as long as the library, so the pointer to it never changes
+        let buffer_pool = Box::new(BufferPool::new());
+        let buffer_pool_global = library_pointers.buffer_pool_ptr as *mut *const BufferPool;
+        unsafe {
+            *buffer_pool_global = &*buffer_pool;
+        }
+
+        SharedCode {
+            jit,
+            library_pointers,
+            modules: Mutex::new(HashMap::new()),
+            next_generation: AtomicUsize::new(1),
+            worker_pool: Mutex::new(None),
+            retired_worker_pools: Mutex::new(Vec::new()),
+            buffer_pool,
+        }
+    }
+
+    fn codegen_lib(context: &Context, target: &TargetProperties) -> Module {
+        let module = Runtime::create_module(context, target, LIBRARY_MODULE_NAME);
+        controls::build_funcs(&module, target);
+        converters::build_funcs(&module);
+        functions::build_funcs(&module, &target);
+        intrinsics::build_intrinsics(&module);
+        globals::build_globals(&module);
+        values::MidiValue::initialize(&module, context);
+        editor::build_convert_num_func(&module, &target, CONVERT_NUM_FUNC_NAME);
+        module
+    }
+
+    pub fn jit(&self) -> &Jit {
+        &self.jit
+    }
+
+    pub fn library_pointers(&self) -> &LibraryPointers {
+        &self.library_pointers
+    }
+
+    /// Returns a generation number that hasn't been used by any runtime sharing this code.
+    pub fn next_generation(&self) -> u64 {
+        self.next_generation.fetch_add(1, Ordering::Relaxed) as u64
+    }
+
+    /// Returns true if a module with the name has been deployed.
+    pub fn has_module(&self, name: &str) -> bool {
+        self.modules.lock().unwrap().contains_key(name)
+    }
+
+    /// Adds a reference to a module that's already been deployed. Returns false if there's no
+    /// module with the name, in which case it needs to be built and deployed.
+    pub fn acquire_module(&self, name: &str) -> bool {
+        if let Some(module) = self.modules.lock().unwrap().get_mut(name) {
+            module.references += 1;
+            true
+        } else {
+            false
+        }
+    }
+
+    /// Deploys a compiled object and adds a reference to it. If another runtime deployed an object
+    /// with the same name in the meantime, that one is used instead.
+    pub fn deploy_object(&self, name: &str, object: &[u8]) {
+        let mut modules = self.modules.lock().unwrap();
+        if let Some(module) = modules.get_mut(name) {
+            module.references += 1;
+            return;
+        }
+
+        modules.insert(
+            name.to_string(),
+            SharedModule {
+                key: self.jit.deploy_object(object),
+                references: 1,
+            },
+        );
+    }
+
+    /// Removes a reference to a module, removing it from the JIT if no runtime is using it.
+    pub fn release_module(&self, name: &str) {
+        let mut modules = self.modules.lock().unwrap();
+        let is_unused = {
+            let module = modules.get_mut(name).unwrap();
+            module.references -= 1;
+            module.references == 0
+        };
+
+        if is_unused {
+            let module = modules.remove(name).unwrap();
+            self.jit.remove(module.key);
+        }
+    }
+
+    /// Sets how many worker threads are used by runtimes sharing this code. The old pool is
+    /// stopped once any job running on it is finished.
+    pub fn set_worker_threads(&self, count: usize) {
+        let mut worker_pool = self.worker_pool.lock().unwrap();
+        let new_pool = if count > 0 {
+            Some(Box::new(WorkerPool::new(count)))
+        } else {
+            None
+        };
+
+        let pool_ptr = match new_pool {
+            Some(ref pool) => &**pool as *const WorkerPool as *mut WorkerPool,
+            None => ptr::null_mut(),
+        };
+        let global_ptr = self.library_pointers.worker_pool_ptr as *const AtomicPtr<WorkerPool>;
+        unsafe {
+            (*global_ptr).store(pool_ptr, Ordering::Release);
+        }
+
+        if let Some(old_pool) = mem::replace(&mut *worker_pool, new_pool) {
+            old_pool.stop();
+            self.retired_worker_pools.lock().unwrap().push(old_pool);
+        }
+    }
+
+    /// Returns the pool generated code currently dispatches to. This doesn't lock, so it can be
+    /// called on the audio thread. Replaced pools are kept until the code is dropped, so the
+    /// reference stays valid.
+    pub fn active_worker_pool(&self) -> Option<&WorkerPool> {
+        let global_ptr = self.library_pointers.worker_pool_ptr as *const AtomicPtr<WorkerPool>;
+        unsafe { (*global_ptr).load(Ordering::Acquire).as_ref() }
+    }
+
+    pub fn get_worker_threads(&self) -> usize {
+        self.worker_pool
+            .lock()
+            .unwrap()
+            .as_ref()
+            .map(|pool| pool.worker_count())
+            .unwrap_or(0)
+    }
+}
@@ -0,0 +1,255 @@
+use codegen::values::ARRAY_CAPACITY;
+use codegen::ObjectCache;
+use inkwell::targets::TargetData;
+use mir::{block, BlockRef, NodeData, SurfaceRef};
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{Hash, Hasher};
+use std::ptr;
+
+// The scratch data of one instance of a block in a generation's scratch global.
+#[derive(Debug, Clone, Copy)]
+struct BlockState {
+    // Identifies the instance: the block, and the voice it's in for each extracted surface it's
+    // inside. Extracted surfaces get new IDs each time they're built, so they aren't part of it.
+    key: u64,
+    // Identifies the layout of the data. Data is only moved between instances with the same layout.
+    layout_key: u64,
+    // Whether the data can be copied to another generation while this one keeps running, which it
+    // can't if it owns anything.
+    is_copyable: bool,
+    offset: usize,
+    size: usize,
+}
+
+/// Where the scratch data of each block instance is in a generation's scratch global, so the state
+/// of instances that are in both an old and a new generation can be moved over when the new one
+/// starts running. Blocks that are added, or whose controls or functions change, start from their
+/// constructed state.
+///
+/// When an old generation is crossfaded out, it keeps its state, and the new one starts with a copy
+/// of the state of the instances that can be copied (see `copy_state`), so only the instances that
+/// couldn't be carried over sound different in the two.
+///
+/// Only scratch data is moved, since that's owned by the generated code (function and control
+/// state, like oscillator phases and delay buffers). Shared data is owned by the editor, which
+/// writes it to each new generation itself.
+#[derive(Debug, Default)]
+pub struct StateMap {
+    // Sorted by key, so two maps can be matched up in a single pass.
+    states: Vec<BlockState>,
+}
+
+impl StateMap {
+    pub fn new(cache: &ObjectCache, root_surface: SurfaceRef) -> Self {
+        let target_data = cache.target().machine.get_data();
+        let mut states = Vec::new();
+
+        // the root surface's scratch is at the start of the scratch global
+        add_surface_states(cache, &target_data, root_surface, 0, 0, &mut states);
+        states.sort_by_key(|state| state.key);
+        StateMap { states }
+    }
+
+    /// Returns true if every block instance in the old generation has an instance with the same
+    /// layout in the new one, so switching over with `swap_state` doesn't lose any state.
+    pub fn can_move_all(old_map: &StateMap, new_map: &StateMap) -> bool {
+        let mut new_states = new_map.states.iter().peekable();
+        for old_state in &old_map.states {
+            while new_states
+                .peek()
+                .map_or(false, |new_state| new_state.key < old_state.key)
+            {
+                new_states.next();
+            }
+
+            match new_states.peek() {
+                Some(new_state)
+                    if new_state.key == old_state.key
+                        && new_state.layout_key == old_state.layout_key => {}
+                _ => return false,
+            }
+        }
+        true
+    }
+
+    /// Copies the state of each block instance in the old generation to the same instance in the
+    /// new one, leaving the old generation's state as it was. Instances that own data (like delay
+    /// buffers) can't be shared by two generations, so they're left with their constructed state.
+    /// The new generation's constructed state for copied instances doesn't own anything either, so
+    /// overwriting it doesn't leak.
+    ///
+    /// Neither generation can be running. This doesn't allocate or lock, so it's safe to call from
+    /// the audio thread.
+    pub unsafe fn copy_state(
+        old_map: &StateMap,
+        old_scratch: *const u8,
+        new_map: &StateMap,
+        new_scratch: *mut u8,
+    ) {
+        StateMap::for_each_match(old_map, new_map, &mut |old_state, new_state| {
+            if new_state.is_copyable {
+                ptr::copy_nonoverlapping(
+                    old_scratch.add(old_state.offset),
+                    new_scratch.add(new_state.offset),
+                    new_state.size,
+                );
+            }
+        });
+    }
+
+    /// Moves the state of each block instance in the old generation to the same instance in the
+    /// new one, by swapping their scratch data. The old generation is left with the state the new
+    /// one was constructed with, which is freed when the old one is destructed, so nothing is
+    /// leaked or freed twice.
+    ///
+    /// Neither generation can be running. This doesn't allocate or lock, so it's safe to call from
+    /// the audio thread.
+    pub unsafe fn swap_state(
+        old_map: &StateMap,
+        old_scratch: *mut u8,
+        new_map: &StateMap,
+        new_scratch: *mut u8,
+    ) {
+        StateMap::for_each_match(old_map, new_map, &mut |old_state, new_state| {
+            ptr::swap_nonoverlapping(
+                old_scratch.add(old_state.offset),
+                new_scratch.add(new_state.offset),
+                new_state.size,
+            );
+        });
+    }
+
+    // Calls the function with each block instance that's in both maps with the same layout.
+    fn for_each_match(
+        old_map: &StateMap,
+        new_map: &StateMap,
+        func: &mut FnMut(&BlockState, &BlockState),
+    ) {
+        let mut old_states = old_map.states.iter().peekable();
+        for new_state in &new_map.states {
+            while old_states
+                .peek()
+                .map_or(false, |old_state| old_state.key < new_state.key)
+            {
+                old_states.next();
+            }
+
+            let old_state = match old_states.peek() {
+                Some(old_state) => *old_state,
+                None => return,
+            };
+            if old_state.key == new_state.key && old_state.layout_key == new_state.layout_key {
+                func(old_state, new_state);
+            }
+        }
+    }
+}
+
+fn instance_key(voice_key: u64, block: BlockRef) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    voice_key.hash(&mut hasher);
+    block.hash(&mut hasher);
+    hasher.finish()
+}
+
+fn voice_path_key(parent_voice_key: u64, voice: u64) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    parent_voice_key.hash(&mut hasher);
+    voice.hash(&mut hasher);
+    hasher.finish()
+}
+
+// A block's scratch layout is decided by the types of its controls and the functions it calls.
+fn layout_key(cache: &ObjectCache, block: BlockRef) -> u64 {
+    let control_types: Vec<_> = cache
+        .block_mir(block)
+        .unwrap()
+        .controls
+        .iter()
+        .map(|control| control.control_type)
+        .collect();
+    let functions = &cache.block_layout(block).unwrap().functions;
+
+    let mut hasher = DefaultHasher::new();
+    format!("{:?} {:?}", control_types, functions).hash(&mut hasher);
+    hasher.finish()
+}
+
+// Delays own the buffers they get from the buffer pool, which would be freed twice if two
+// generations had them.
+fn is_copyable(cache: &ObjectCache, block: BlockRef) -> bool {
+    !cache
+        .block_layout(block)
+        .unwrap()
+        .functions
+        .iter()
+        .any(|function| match function {
+            block::Function::Delay => true,
+            _ => false,
+        })
+}
+
+fn add_surface_states(
+    cache: &ObjectCache,
+    target_data: &TargetData,
+    surface: SurfaceRef,
+    scratch_offset: usize,
+    voice_key: u64,
+    states: &mut Vec<BlockState>,
+) {
+    let surface_mir = cache.surface_mir(surface).unwrap();
+    let surface_layout = cache.surface_layout(surface).unwrap();
+
+    for (node_index, node) in surface_mir.nodes.iter().enumerate() {
+        let node_offset = scratch_offset + target_data
+            .offset_of_element(
+                &surface_layout.scratch_struct,
+                surface_layout.node_scratch_index(node_index) as u32,
+            ).unwrap() as usize;
+
+        match node.data {
+            NodeData::Dummy => {}
+            NodeData::Custom(block) => {
+                let size =
+                    target_data.get_abi_size(&cache.block_layout(block).unwrap().scratch_struct);
+                if size > 0 {
+                    states.push(BlockState {
+                        key: instance_key(voice_key, block),
+                        layout_key: layout_key(cache, block),
+                        is_copyable: is_copyable(cache, block),
+                        offset: node_offset,
+                        size: size as usize,
+                    });
+                }
+            }
+            // the group's scratch is first in the node's scratch, followed by its shared data
+            NodeData::Group(subsurface) => add_surface_states(
+                cache,
+                target_data,
+                subsurface,
+                node_offset,
+                voice_key,
+                states,
+            ),
+            // the scratch of each voice is in an array at the start of the node's scratch
+            NodeData::ExtractGroup {
+                surface: subsurface,
+                ..
+            } => {
+                let voice_stride = target_data
+                    .get_abi_size(&cache.surface_layout(subsurface).unwrap().scratch_struct)
+                    as usize;
+                for voice in 0..ARRAY_CAPACITY as usize {
+                    add_surface_states(
+                        cache,
+                        target_data,
+                        subsurface,
+                        node_offset + voice * voice_stride,
+                        voice_path_key(voice_key, voice as u64),
+                        states,
+                    );
+                }
+            }
+        }
+    }
+}
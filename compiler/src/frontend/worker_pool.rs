@@ -0,0 +1,366 @@
+use super::runtime_globals::{self, RuntimeGlobals};
+use codegen::values::ARRAY_CAPACITY;
+use std::cell::{Cell, UnsafeCell};
+use std::fmt;
+use std::os::raw::c_void;
+use std::sync::atomic::{self, AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread;
+
+/// A generated update function, called with a pointer to the pointers of the surface it updates.
+pub type UpdateFunc = unsafe extern "C" fn(*mut c_void);
+
+// Jobs are dispatched every sample, which is far more often than a sleeping thread can be woken,
+// so workers spin while a block is being run. After this many spins without a job they start
+// yielding so they don't starve other threads.
+const SPINS_BEFORE_YIELD: usize = 1 << 14;
+
+// Once no blocks are being run, workers spin this many times in case another one starts straight
+// away before going to sleep.
+const SPINS_BEFORE_SLEEP: usize = 1 << 10;
+
+// The job's epoch, task count and next unclaimed task are packed into one word, so a task is
+// claimed with a single atomic operation and a worker that's late to a job can't claim a task from
+// the one that replaced it.
+const TASK_BITS: usize = 8;
+const TASK_MASK: usize = (1 << TASK_BITS) - 1;
+const MAX_TASKS: usize = TASK_MASK;
+
+fn claim_next_task(claim: usize) -> usize {
+    claim & TASK_MASK
+}
+
+fn claim_task_count(claim: usize) -> usize {
+    (claim >> TASK_BITS) & TASK_MASK
+}
+
+fn claim_epoch(claim: usize) -> usize {
+    claim >> (TASK_BITS * 2)
+}
+
+fn pack_claim(epoch: usize, task_count: usize) -> usize {
+    (epoch << (TASK_BITS * 2)) | (task_count << TASK_BITS)
+}
+
+thread_local! {
+    // Jobs can be nested (an extracted surface inside a voice of another one), in which case the
+    // inner job is run on the thread running the outer one.
+    static IS_RUNNING_JOB: Cell<bool> = Cell::new(false);
+}
+
+// A job is the same update function run on different voices, which can run in any order.
+struct Job {
+    update: Option<UpdateFunc>,
+    pointers: *mut u8,
+    stride: usize,
+    voice_indices: [u8; ARRAY_CAPACITY as usize],
+    count: usize,
+    // The globals of the runtime that dispatched the job, which workers run its tasks with.
+    globals: *mut RuntimeGlobals,
+}
+
+impl Job {
+    unsafe fn run_voice(&self, task: usize) {
+        let pointers = self
+            .pointers
+            .add(self.voice_indices[task] as usize * self.stride);
+        (self.update.unwrap())(pointers as *mut c_void);
+    }
+}
+
+struct PoolState {
+    // Only written by the dispatching thread once every task of the previous job has been claimed
+    // and finished, so it's never read while it's being written.
+    job: UnsafeCell<Job>,
+    // The packed epoch, task count and next task of the current job.
+    claim: AtomicUsize,
+    // Number of tasks of the current job that have finished running.
+    finished_tasks: AtomicUsize,
+    // Number of blocks runtimes are running with the pool. Workers only sleep while there are none.
+    active_blocks: AtomicUsize,
+    // Set by each worker before it goes to sleep.
+    sleeping_workers: Vec<AtomicBool>,
+    // Set while a thread is dispatching a job. Runtimes sharing code also share a pool, so several
+    // audio threads can try to use it at once.
+    is_busy: AtomicBool,
+    is_stopping: AtomicBool,
+}
+
+unsafe impl Send for PoolState {}
+unsafe impl Sync for PoolState {}
+
+impl fmt::Debug for PoolState {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "PoolState")
+    }
+}
+
+impl PoolState {
+    // Tasks are claimed one at a time, so a thread that finishes its task early takes the next one
+    // instead of waiting for the others. Returns true if any tasks were run.
+    unsafe fn run_tasks(&self) -> bool {
+        let mut has_run_task = false;
+        let mut claim = self.claim.load(Ordering::Acquire);
+        while claim_next_task(claim) < claim_task_count(claim) {
+            match self.claim.compare_exchange_weak(
+                claim,
+                claim + 1,
+                Ordering::Acquire,
+                Ordering::Acquire,
+            ) {
+                Ok(_) => {
+                    // the job can't be replaced until this task has finished
+                    let job = &*self.job.get();
+                    runtime_globals::set_current(job.globals);
+                    job.run_voice(claim_next_task(claim));
+                    self.finished_tasks.fetch_add(1, Ordering::Release);
+                    has_run_task = true;
+                    claim = self.claim.load(Ordering::Acquire);
+                }
+                Err(current_claim) => claim = current_claim,
+            }
+        }
+        has_run_task
+    }
+}
+
+/// Runs the voices of extracted surfaces across a set of worker threads. The dispatching thread
+/// runs tasks too, and doesn't return until every task has been run. It only waits for tasks
+/// workers have claimed, so a worker that isn't scheduled in time doesn't hold it up. Tasks never
+/// write to the same values, so the output doesn't depend on how tasks are split between threads.
+/// If the pool is already running a job from another thread, tasks are run on the dispatching
+/// thread instead of waiting.
+///
+/// Voices are dispatched every sample, so the audio thread waits on the workers every sample, and
+/// a worker that's preempted while running a voice stalls it. Runtimes don't have a pool unless
+/// they're given worker threads, which is left to the user until benchmarks show it's a gain.
+///
+/// Workers are only awake while a runtime is running a block with `begin_block`, and sleep between
+/// blocks so an idle pool doesn't use any CPU time.
+#[derive(Debug)]
+pub struct WorkerPool {
+    state: Arc<PoolState>,
+    worker_count: usize,
+    worker_threads: Vec<thread::Thread>,
+    workers: Mutex<Vec<thread::JoinHandle<()>>>,
+}
+
+impl WorkerPool {
+    pub fn new(worker_count: usize) -> Self {
+        let state = Arc::new(PoolState {
+            job: UnsafeCell::new(Job {
+                update: None,
+                pointers: ::std::ptr::null_mut(),
+                stride: 0,
+                voice_indices: [0; ARRAY_CAPACITY as usize],
+                count: 0,
+                globals: ::std::ptr::null_mut(),
+            }),
+            claim: AtomicUsize::new(pack_claim(0, 0)),
+            finished_tasks: AtomicUsize::new(0),
+            active_blocks: AtomicUsize::new(0),
+            sleeping_workers: (0..worker_count).map(|_| AtomicBool::new(false)).collect(),
+            is_busy: AtomicBool::new(false),
+            is_stopping: AtomicBool::new(false),
+        });
+
+        let workers: Vec<_> = (0..worker_count)
+            .map(|worker_index| {
+                let worker_state = state.clone();
+                thread::Builder::new()
+                    .name(format!("maxim worker {}", worker_index))
+                    .spawn(move || WorkerPool::run_worker(&worker_state, worker_index))
+                    .unwrap()
+            }).collect();
+
+        WorkerPool {
+            state,
+            worker_count,
+            worker_threads: workers
+                .iter()
+                .map(|worker| worker.thread().clone())
+                .collect(),
+            workers: Mutex::new(workers),
+        }
+    }
+
+    pub fn worker_count(&self) -> usize {
+        self.worker_count
+    }
+
+    /// Waits for any running job to finish and stops the workers. The pool can still be
+    /// dispatched to afterwards, but tasks will be run on the dispatching thread.
+    pub fn stop(&self) {
+        if self.state.is_stopping.load(Ordering::Relaxed) {
+            return;
+        }
+
+        // the pool is never released, so nothing else can be dispatched to the workers
+        while self
+            .state
+            .is_busy
+            .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
+            .is_err()
+        {
+            thread::yield_now();
+        }
+
+        self.state.is_stopping.store(true, Ordering::SeqCst);
+        for worker in &self.worker_threads {
+            worker.unpark();
+        }
+        for worker in self.workers.lock().unwrap().drain(..) {
+            worker.join().unwrap();
+        }
+    }
+
+    /// Wakes the workers, if they're asleep, before a runtime runs a block. Each call must be
+    /// matched by a call to `end_block` once the block is done. Doesn't lock or allocate, so it can
+    /// be called on the audio thread.
+    pub fn begin_block(&self) {
+        if self.state.active_blocks.fetch_add(1, Ordering::SeqCst) == 0 {
+            for (worker, is_sleeping) in
+                self.worker_threads.iter().zip(&self.state.sleeping_workers)
+            {
+                if is_sleeping.swap(false, Ordering::SeqCst) {
+                    worker.unpark();
+                }
+            }
+        }
+    }
+
+    /// Lets the workers go back to sleep once no runtime is running a block.
+    pub fn end_block(&self) {
+        self.state.active_blocks.fetch_sub(1, Ordering::SeqCst);
+    }
+
+    fn run_worker(state: &PoolState, worker_index: usize) {
+        IS_RUNNING_JOB.with(|is_running| is_running.set(true));
+
+        let is_sleeping = &state.sleeping_workers[worker_index];
+        let mut spin_count = 0;
+        loop {
+            if state.is_stopping.load(Ordering::SeqCst) {
+                return;
+            }
+
+            if unsafe { state.run_tasks() } {
+                spin_count = 0;
+                continue;
+            }
+
+            spin_count += 1;
+            if state.active_blocks.load(Ordering::SeqCst) > 0 {
+                if spin_count < SPINS_BEFORE_YIELD {
+                    atomic::spin_loop_hint();
+                } else {
+                    thread::yield_now();
+                }
+            } else if spin_count < SPINS_BEFORE_SLEEP {
+                atomic::spin_loop_hint();
+            } else {
+                // The flag is set before the block count is checked, and `begin_block` changes
+                // them in the opposite order, so either this sees the new block or `begin_block`
+                // sees the flag and wakes the worker.
+                is_sleeping.store(true, Ordering::SeqCst);
+                if state.active_blocks.load(Ordering::SeqCst) == 0
+                    && !state.is_stopping.load(Ordering::SeqCst)
+                {
+                    thread::park();
+                }
+                is_sleeping.store(false, Ordering::SeqCst);
+                spin_count = 0;
+            }
+        }
+    }
+
+    // Returns true if the job should be run on the calling thread instead of being dispatched. If
+    // this returns false, the pool has been claimed for the job.
+    fn should_run_inline(&self, task_count: usize) -> bool {
+        // it's not worth waking the workers for a single task
+        task_count <= 1
+            || task_count > MAX_TASKS
+            || self.worker_count == 0
+            || IS_RUNNING_JOB.with(|is_running| is_running.get())
+            || self
+                .state
+                .is_busy
+                .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
+                .is_err()
+    }
+
+    unsafe fn dispatch(&self, job: Job) {
+        // every task of the previous job has been claimed, so workers can't read the job until
+        // the new claim is published
+        let task_count = job.count;
+        let epoch = claim_epoch(self.state.claim.load(Ordering::Relaxed)).wrapping_add(1);
+        *self.state.job.get() = job;
+        self.state.finished_tasks.store(0, Ordering::Relaxed);
+        self.state
+            .claim
+            .store(pack_claim(epoch, task_count), Ordering::Release);
+
+        IS_RUNNING_JOB.with(|is_running| is_running.set(true));
+        self.state.run_tasks();
+        IS_RUNNING_JOB.with(|is_running| is_running.set(false));
+
+        // wait for the tasks workers claimed to finish, so the next job can be written safely
+        while self.state.finished_tasks.load(Ordering::Acquire) != task_count {
+            atomic::spin_loop_hint();
+        }
+        self.state.is_busy.store(false, Ordering::Release);
+    }
+
+    /// Runs the update function for each voice with a bit set in the bitmap. Voice pointers are
+    /// `stride` bytes apart.
+    pub unsafe fn dispatch_voices(
+        &self,
+        update: UpdateFunc,
+        voices: *mut u8,
+        stride: usize,
+        bitmap: u32,
+    ) {
+        let mut voice_indices = [0; ARRAY_CAPACITY as usize];
+        let mut count = 0;
+        for voice_index in 0..ARRAY_CAPACITY {
+            if bitmap & (1 << voice_index) != 0 {
+                voice_indices[count] = voice_index;
+                count += 1;
+            }
+        }
+
+        if self.should_run_inline(count) {
+            for &voice_index in &voice_indices[..count] {
+                update(voices.add(voice_index as usize * stride) as *mut c_void);
+            }
+            return;
+        }
+
+        self.dispatch(Job {
+            update: Some(update),
+            pointers: voices,
+            stride,
+            voice_indices,
+            count,
+            globals: runtime_globals::current(),
+        });
+    }
+}
+
+impl Drop for WorkerPool {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+/// Called by generated code to run the voices of an extracted surface on a worker pool. The JIT
+/// is given this function as a builtin when it's created.
+pub unsafe extern "C" fn maxim_dispatch_voices(
+    pool: *const WorkerPool,
+    update: UpdateFunc,
+    voices: *mut c_void,
+    stride: u64,
+    bitmap: u32,
+) {
+    (*pool).dispatch_voices(update, voices as *mut u8, stride as usize, bitmap);
+}
@@ -7,6 +7,7 @@ extern crate regex;
 extern crate lazy_static;
 
 mod compile_error;
+mod ffi;
 
 pub mod ast;
 pub mod codegen;
@@ -3,8 +3,10 @@
 #include <QtCore/QFileInfo>
 #include <QtCore/QStandardPaths>
 #include <QtWidgets/QMessageBox>
+#include <algorithm>
 
 #include "../AxiomEditor.h"
+#include "../compiler/interface/Runtime.h"
 #include "../model/ModelRoot.h"
 #include "../model/Project.h"
 #include "../model/objects/RootSurface.h"
@@ -24,6 +26,10 @@ const char *AxiomBackend::LEGAL_COPYRIGHT = VER_LEGALCOPYRIGHT_STR;
 const char *AxiomBackend::LEGAL_TRADEMARKS = VER_LEGALTRADEMARKS1_STR;
 const char *AxiomBackend::PRODUCT_NAME = VER_PRODUCTNAME_STR;
 
+AudioBackend::AudioBackend() {
+    queuedEvents.reserve(MAX_QUEUED_EVENTS);
+}
+
 NumValue **AudioBackend::getAudioPortal(size_t portalId) const {
     if (portalId >= portalValues.size()) return nullptr;
     return (NumValue **) &portalValues[portalId];
@@ -54,9 +60,8 @@ QByteArray AudioBackend::serialize(std::optional<std::function<void(QDataStream
     QByteArray buffer;
     QDataStream stream(&buffer, QIODevice::WriteOnly);
 
-    auto project = _editor->window()->project();
-    AxiomModel::ProjectSerializer::serialize(project, stream,
-                                             [project](QDataStream &stream) { stream << project->linkedFile(); });
+    AxiomModel::ProjectSerializer::serialize(_project, stream,
+                                             [this](QDataStream &stream) { stream << _project->linkedFile(); });
     if (serializeCustomCallback) {
         (*serializeCustomCallback)(stream);
     }
@@ -112,15 +117,16 @@ void AudioBackend::deserialize(QByteArray *data,
 }
 
 void AudioBackend::setBpm(float bpm) {
-    _editor->window()->runtime()->setBpm(bpm);
+    _runtime->setBpm(bpm);
 }
 
 void AudioBackend::setSampleRate(float sampleRate) {
-    _editor->window()->runtime()->setSampleRate(sampleRate);
+    _runtime->setSampleRate(sampleRate);
 }
 
 void AudioBackend::queueMidiEvent(uint64_t deltaFrames, size_t portalId, AxiomBackend::MidiEvent event) {
-    queuedEvents.push_back({deltaFrames, portalId, event});
+    // if the queue is full the event is dropped, since we can't allocate here
+    incomingEvents.push({currentSample.load(std::memory_order_relaxed) + deltaFrames, portalId, event});
 }
 
 void AudioBackend::clearMidi(size_t portalId) {
@@ -130,38 +136,128 @@ void AudioBackend::clearMidi(size_t portalId) {
 void AudioBackend::clearNotes(size_t portalId) {}
 
 std::lock_guard<std::mutex> AudioBackend::lockRuntime() {
-    return _editor->window()->project()->mainRoot().lockRuntime();
+    return _project->mainRoot().lockRuntime();
 }
 
 uint64_t AudioBackend::beginGenerate() {
-    // decrement all deltaFrames from last time
-    for (auto &event : queuedEvents) {
-        if (event.deltaFrames > generatedSamples) {
-            event.deltaFrames -= generatedSamples;
-        } else {
-            event.deltaFrames = 0;
+    // control changes from the UI are applied at the start of each block, and the values the UI displays are
+    // captured afterwards so they include them
+    auto &root = _project->mainRoot();
+    root.applyRuntimeWrites();
+    root.captureRuntimeSnapshot();
+
+    pendingMidiPortals.clear();
+
+    // move newly queued events into the sorted list
+    while (auto incomingEvent = incomingEvents.pop()) {
+        if (queuedEvents.size() == queuedEvents.capacity()) {
+            // reclaim the space used by events that have already been input, or drop the event if there's none
+            queuedEvents.erase(queuedEvents.begin(), queuedEvents.begin() + queuedEventsStart);
+            queuedEventsStart = 0;
+            if (queuedEvents.size() == queuedEvents.capacity()) continue;
         }
 
-        if (event.deltaFrames == 0) {
-            (*getMidiPortal(event.portalId))->pushEvent(event.event);
+        // events at the same time stay in the order they were queued
+        auto insertPos = std::upper_bound(
+            queuedEvents.begin() + queuedEventsStart, queuedEvents.end(), incomingEvent->time,
+            [](uint64_t time, const QueuedEvent &event) { return time < event.time; });
+        queuedEvents.insert(insertPos, *incomingEvent);
+    }
 
-            // note: deque doesn't invalidate iterators when removing items from start or end, so this is safe to do.
-            queuedEvents.pop_front();
+    // input all events that are due, leaving any that don't fit in their portal for the next frame
+    auto now = currentSample.load(std::memory_order_relaxed);
+    while (queuedEventsStart < queuedEvents.size() && queuedEvents[queuedEventsStart].time <= now) {
+        const auto &event = queuedEvents[queuedEventsStart];
+        auto portal = getMidiPortal(event.portalId);
+        if (portal && *portal) {
+            if ((*portal)->count >= MidiValue::MAX_EVENTS) break;
+
+            (*portal)->pushEvent(event.event);
+            if (std::find(pendingMidiPortals.begin(), pendingMidiPortals.end(), event.portalId) ==
+                pendingMidiPortals.end()) {
+                pendingMidiPortals.push_back(event.portalId);
+            }
         }
+        queuedEventsStart++;
     }
-    generatedSamples = 0;
 
     // return number of samples to next event
-    if (queuedEvents.empty()) {
+    if (queuedEventsStart == queuedEvents.size()) {
+        queuedEvents.clear();
+        queuedEventsStart = 0;
         return UINT64_MAX;
+    } else if (queuedEvents[queuedEventsStart].time <= now) {
+        // events that didn't fit are input after the next frame
+        return 1;
     } else {
-        return queuedEvents[0].deltaFrames;
+        return queuedEvents[queuedEventsStart].time - now;
     }
 }
 
 void AudioBackend::generate() {
-    generatedSamples++;
-    _editor->window()->runtime()->runUpdate();
+    currentSample.fetch_add(1, std::memory_order_relaxed);
+    _runtime->runUpdate();
+}
+
+void AudioBackend::bindAudioInput(size_t portalId, const float *left, const float *right, NumForm form) {
+    if (portalId >= inputBuffers.size()) return;
+    inputBuffers[portalId] = {portalValues[portalId], const_cast<float *>(left), const_cast<float *>(right),
+                              (uint8_t) form};
+}
+
+void AudioBackend::bindAudioOutput(size_t portalId, float *left, float *right) {
+    if (portalId >= outputBuffers.size()) return;
+    outputBuffers[portalId] = {portalValues[portalId], left, right, 0};
+}
+
+void AudioBackend::unbindAudioInput(size_t portalId) {
+    if (portalId >= inputBuffers.size()) return;
+    inputBuffers[portalId] = {};
+}
+
+void AudioBackend::unbindAudioOutput(size_t portalId) {
+    if (portalId >= outputBuffers.size()) return;
+    outputBuffers[portalId] = {};
+}
+
+void AudioBackend::generateBlock(uint64_t frames) {
+    if (frames == 0) return;
+
+    auto runFrames = [this](uint64_t offset, uint64_t count) {
+        // build the list of bound portals, offset to the first frame we're generating. The lists have enough capacity
+        // reserved that this never allocates.
+        activeInputBuffers.clear();
+        activeOutputBuffers.clear();
+        for (const auto &buffer : inputBuffers) {
+            if (buffer.portal) {
+                activeInputBuffers.push_back({buffer.portal, buffer.left + offset, buffer.right + offset, buffer.form});
+            }
+        }
+        for (const auto &buffer : outputBuffers) {
+            if (buffer.portal) {
+                activeOutputBuffers.push_back({buffer.portal, buffer.left + offset, buffer.right + offset, 0});
+            }
+        }
+
+        _runtime->runBlock((uint32_t) count, activeInputBuffers.data(), activeInputBuffers.size(),
+                          activeOutputBuffers.data(), activeOutputBuffers.size());
+    };
+
+    // MIDI events only exist for a single frame, so if any were pushed we need to clear them after the first frame
+    uint64_t offset = 0;
+    if (!pendingMidiPortals.empty()) {
+        runFrames(0, 1);
+        for (auto portalId : pendingMidiPortals) {
+            clearMidi(portalId);
+        }
+        pendingMidiPortals.clear();
+        offset = 1;
+    }
+
+    if (offset < frames) {
+        runFrames(offset, frames - offset);
+    }
+    currentSample.fetch_add(frames, std::memory_order_relaxed);
 }
 
 void AudioBackend::previewEvent(AxiomBackend::MidiEvent event) {}
@@ -174,8 +270,8 @@ bool AudioBackend::canFiddleAutomation() const {
 
 void AudioBackend::internalUpdateConfiguration() {
     std::vector<ConfigurationPortal> newPortals;
-    assert(_editor->window()->project()->rootSurface()->compileMeta());
-    auto &compileMeta = *_editor->window()->project()->rootSurface()->compileMeta();
+    assert(_project->rootSurface()->compileMeta());
+    auto &compileMeta = *_project->rootSurface()->compileMeta();
 
     for (const auto &surfacePortal : compileMeta.portals) {
         PortalType newType;
@@ -210,9 +306,16 @@ void AudioBackend::internalUpdateConfiguration() {
     portalValues.clear();
     portalValues.reserve(newPortals.size());
     for (const auto &newPortal : newPortals) {
-        portalValues.push_back(_editor->window()->runtime()->getPortalPtr(newPortal._key));
+        portalValues.push_back(_runtime->getPortalPtr(newPortal._key));
     }
 
+    // portal indices may have changed, so reset buffer bindings and reserve space for generateBlock to use
+    inputBuffers.assign(newPortals.size(), {});
+    outputBuffers.assign(newPortals.size(), {});
+    activeInputBuffers.reserve(newPortals.size());
+    activeOutputBuffers.reserve(newPortals.size());
+    pendingMidiPortals.reserve(newPortals.size());
+
     // no point continuing if the portals are the same
     if (hasCurrent && newPortals == currentPortals) {
         return;
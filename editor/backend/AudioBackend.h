@@ -1,16 +1,26 @@
 #pragma once
 
 #include <QtCore/QByteArray>
-#include <deque>
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <optional>
 
+#include "../compiler/interface/Frontend.h"
 #include "../model/Value.h"
 #include "AudioConfiguration.h"
+#include "common/MpscQueue.h"
 
 class AxiomEditor;
 
+namespace AxiomModel {
+    class Project;
+}
+
+namespace MaximCompiler {
+    class Runtime;
+}
+
 namespace AxiomBackend {
     using NumValue = AxiomModel::NumValue;
     using NumForm = AxiomModel::FormType;
@@ -28,6 +38,8 @@ namespace AxiomBackend {
 
     class AudioBackend {
     public:
+        AudioBackend();
+
         // Accessors for audio inputs and outputs
         // Note: the pointer returned is always valid as long as the portal ID is, however the target pointer may change
         // at any time from the UI thread.
@@ -55,9 +67,10 @@ namespace AxiomBackend {
             QByteArray *data,
             std::optional<std::function<void(QDataStream &, uint32_t)>> deserializeCustomCallback = std::nullopt);
 
-        // Queues a MIDI event to be input in a certain number of samples time. Should be called from the audio thread.
-        // You should call clearMidi after the first generated sample (at least) to clear the MIDI portals that had
-        // data queued.
+        // Queues a MIDI event to be input in a certain number of samples time, counted from the next sample to be
+        // generated. Can be called from any thread without locking the runtime. A fixed number of events can be queued
+        // at once, after which events are dropped. When using `generate`, you should call clearMidi after the first
+        // generated sample (at least) to clear the MIDI portals that had data queued.
         void queueMidiEvent(uint64_t deltaFrames, size_t portalId, MidiEvent event);
         void clearMidi(size_t portalId);
 
@@ -70,7 +83,8 @@ namespace AxiomBackend {
 
         // Signals that you're about to start a batch of `generate` calls. The value returned signals the max number of
         // samples (i.e `generate` calls) until you should call `beginGenerate` again. This is used, for example, for
-        // the internal queuing of MIDI events. Should be called from the audio thread.
+        // the internal queuing of MIDI events. Control changes made in the editor are also applied here, and values
+        // shown in the editor are snapshotted. Should be called from the audio thread with the runtime locked.
         // Note: the return value of this function will _always_ be greater than 0.
         uint64_t beginGenerate();
 
@@ -78,6 +92,25 @@ namespace AxiomBackend {
         // be written to. Should be called from the audio thread. Make sure the runtime is locked when calling!
         void generate();
 
+        // Binds a pair of channel buffers to an audio input or output portal, to be used by `generateBlock`. Samples
+        // are read directly from input channels before each frame is simulated, and written directly to output channels
+        // after, so host buffers can be bound without copying. The same buffer can be bound as an input and an output
+        // to process in-place. Inputs are given the specified form. Channels must hold at least as many samples as the
+        // number of frames passed to `generateBlock`. Bindings are reset when the IO configuration changes. Should be
+        // called from the audio thread.
+        void bindAudioInput(size_t portalId, const float *left, const float *right,
+                            NumForm form = NumForm::OSCILLATOR);
+        void bindAudioOutput(size_t portalId, float *left, float *right);
+        void unbindAudioInput(size_t portalId);
+        void unbindAudioOutput(size_t portalId);
+
+        // Simulates the internal graph for a block of frames, reading from and writing to the bound audio buffers. This
+        // is equivalent to calling `generate` once per frame, but avoids calling into the runtime for every sample.
+        // MIDI portals that had events pushed by `beginGenerate` are cleared after the first frame, so `clearMidi`
+        // doesn't need to be called. `frames` should be at most the value returned from `beginGenerate`. Should be
+        // called from the audio thread. Make sure the runtime is locked when calling!
+        void generateBlock(uint64_t frames);
+
         // To be implemented by the audio backend, called from the UI thread when the IO configuration changes.
         // Note that this is not always called when the runtime is rebuilt, only if the rebuild results in a change in
         // configuration. The runtime will be locked while in this method.
@@ -111,24 +144,41 @@ namespace AxiomBackend {
 
         // Called internally. Not stable APIs.
         void setEditor(AxiomEditor *editor) { _editor = editor; }
+        void internalAttachProject(AxiomModel::Project *project, MaximCompiler::Runtime *runtime) {
+            _project = project;
+            _runtime = runtime;
+        }
         void internalUpdateConfiguration();
         size_t internalRemapPortal(uint64_t id);
 
     private:
         struct QueuedEvent {
-            uint64_t deltaFrames;
+            uint64_t time;
             size_t portalId;
             MidiEvent event;
         };
 
+        static constexpr size_t MAX_QUEUED_EVENTS = 1024;
+
         bool hasCurrent = false;
         std::vector<ConfigurationPortal> currentPortals;
 
-        AxiomEditor *_editor;
+        AxiomEditor *_editor = nullptr;
+        AxiomModel::Project *_project = nullptr;
+        MaximCompiler::Runtime *_runtime = nullptr;
         std::vector<void *> portalValues;
-
-        // todo: use a circular buffer instead of a deque here
-        std::deque<QueuedEvent> queuedEvents;
-        size_t generatedSamples = 0;
+        std::vector<MaximFrontend::PortalBuffer> inputBuffers;
+        std::vector<MaximFrontend::PortalBuffer> outputBuffers;
+        std::vector<MaximFrontend::PortalBuffer> activeInputBuffers;
+        std::vector<MaximFrontend::PortalBuffer> activeOutputBuffers;
+        std::vector<size_t> pendingMidiPortals;
+
+        // Events are pushed to `incomingEvents` from any thread, then moved into `queuedEvents` by the audio thread,
+        // which is kept sorted by time (in samples since the backend was created). Events before `queuedEventsStart`
+        // have already been input. `queuedEvents` has space for MAX_QUEUED_EVENTS reserved, so it never allocates.
+        AxiomCommon::MpscQueue<QueuedEvent, MAX_QUEUED_EVENTS> incomingEvents;
+        std::vector<QueuedEvent> queuedEvents;
+        size_t queuedEventsStart = 0;
+        std::atomic<uint64_t> currentSample = 0;
     };
 }
@@ -0,0 +1,249 @@
+#include "MidiFile.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <algorithm>
+#include <cstring>
+
+using namespace AxiomRender;
+
+namespace {
+    // SMF tempo events are in microseconds per quarter note, this is 120 BPM
+    constexpr uint32_t DEFAULT_TEMPO = 500000;
+
+    struct RawEvent {
+        uint64_t tick;
+        uint8_t status;
+        uint8_t data1;
+        uint8_t data2;
+        uint32_t tempo;
+    };
+
+    class Reader {
+    public:
+        Reader(const uint8_t *data, size_t size) : _data(data), _size(size) {}
+
+        bool atEnd() const { return _pos >= _size; }
+
+        size_t pos() const { return _pos; }
+
+        bool read(uint8_t *out) {
+            if (_pos >= _size) return false;
+            *out = _data[_pos++];
+            return true;
+        }
+
+        bool peek(uint8_t *out) const {
+            if (_pos >= _size) return false;
+            *out = _data[_pos];
+            return true;
+        }
+
+        bool readBigEndian(size_t bytes, uint32_t *out) {
+            if (_size - _pos < bytes) return false;
+            *out = 0;
+            for (size_t i = 0; i < bytes; i++) {
+                *out = (*out << 8) | _data[_pos++];
+            }
+            return true;
+        }
+
+        bool readVarLen(uint32_t *out) {
+            *out = 0;
+
+            // variable-length quantities are at most four bytes
+            for (auto i = 0; i < 4; i++) {
+                uint8_t byte;
+                if (!read(&byte)) return false;
+                *out = (*out << 7) | (byte & 0x7F);
+                if (!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+
+        bool skip(size_t bytes) {
+            if (_size - _pos < bytes) return false;
+            _pos += bytes;
+            return true;
+        }
+
+        bool readTag(const char *tag) {
+            if (_size - _pos < 4 || memcmp(_data + _pos, tag, 4) != 0) return false;
+            _pos += 4;
+            return true;
+        }
+
+    private:
+        const uint8_t *_data;
+        size_t _size;
+        size_t _pos = 0;
+    };
+
+    bool readTrack(Reader &reader, std::vector<RawEvent> *events, uint64_t *endTick) {
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+
+        while (!reader.atEnd()) {
+            uint32_t delta;
+            if (!reader.readVarLen(&delta)) return false;
+            tick += delta;
+
+            uint8_t status;
+            if (!reader.peek(&status)) return false;
+            if (status & 0x80) {
+                reader.skip(1);
+            } else if (runningStatus) {
+                status = runningStatus;
+            } else {
+                return false;
+            }
+
+            if (status == 0xFF) {
+                // meta event, only tempo changes and the end of the track matter
+                uint8_t type;
+                uint32_t length;
+                if (!reader.read(&type) || !reader.readVarLen(&length)) return false;
+
+                if (type == 0x51 && length == 3) {
+                    uint32_t tempo;
+                    if (!reader.readBigEndian(3, &tempo)) return false;
+                    events->push_back({tick, status, 0, 0, tempo});
+                } else if (!reader.skip(length)) {
+                    return false;
+                }
+
+                if (type == 0x2F) break;
+            } else if (status == 0xF0 || status == 0xF7) {
+                // sysex events are ignored
+                uint32_t length;
+                if (!reader.readVarLen(&length) || !reader.skip(length)) return false;
+            } else if (status > 0xF0) {
+                // other system messages aren't valid in a file
+                return false;
+            } else {
+                runningStatus = status;
+
+                uint8_t data1 = 0, data2 = 0;
+                auto type = status & 0xF0;
+                auto hasSecondByte = type != 0xC0 && type != 0xD0;
+                if (!reader.read(&data1) || (hasSecondByte && !reader.read(&data2))) return false;
+                events->push_back({tick, status, data1, data2, 0});
+            }
+        }
+
+        *endTick = std::max(*endTick, tick);
+        return true;
+    }
+
+    std::optional<AxiomBackend::MidiEvent> convertEvent(const RawEvent &event) {
+        AxiomBackend::MidiEvent remappedEvent;
+        remappedEvent.channel = (uint8_t)(event.status & 0x0F);
+
+        switch (event.status & 0xF0) {
+        case 0x80: // note off
+            remappedEvent.event = AxiomBackend::MidiEventType::NOTE_OFF;
+            remappedEvent.note = event.data1;
+            return remappedEvent;
+        case 0x90: // note on, files commonly use a velocity of zero as a note off
+            remappedEvent.event =
+                event.data2 ? AxiomBackend::MidiEventType::NOTE_ON : AxiomBackend::MidiEventType::NOTE_OFF;
+            remappedEvent.note = event.data1;
+            remappedEvent.param = (uint8_t)(event.data2 * 2); // MIDI velocity is 0-127, we need 0-255
+            return remappedEvent;
+        case 0xA0: // polyphonic aftertouch
+            remappedEvent.event = AxiomBackend::MidiEventType::POLYPHONIC_AFTERTOUCH;
+            remappedEvent.note = event.data1;
+            remappedEvent.param = (uint8_t)(event.data2 * 2); // MIDI aftertouch pressure is 0-127, we need 0-255
+            return remappedEvent;
+        case 0xD0: // channel aftertouch
+            remappedEvent.event = AxiomBackend::MidiEventType::CHANNEL_AFTERTOUCH;
+            remappedEvent.param = (uint8_t)(event.data1 * 2); // MIDI aftertouch pressure is 0-127, we need 0-255
+            return remappedEvent;
+        case 0xE0: // pitch wheel
+        {
+            remappedEvent.event = AxiomBackend::MidiEventType::PITCH_WHEEL;
+
+            // Pitch is 0-0x3FFF stored across the two bytes, we need 0-255
+            auto pitch = ((uint16_t) event.data2 << 7) | (uint16_t) event.data1;
+            remappedEvent.param = (uint8_t)(pitch / 16383.f * 255.f);
+            return remappedEvent;
+        }
+        default:
+            return std::nullopt;
+        }
+    }
+}
+
+std::optional<MidiFile> MidiFile::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return std::nullopt;
+    auto contents = file.readAll();
+    file.close();
+
+    Reader reader((const uint8_t *) contents.constData(), (size_t) contents.size());
+
+    uint32_t headerLength, format, trackCount, division;
+    if (!reader.readTag("MThd") || !reader.readBigEndian(4, &headerLength) || headerLength < 6 ||
+        !reader.readBigEndian(2, &format) || !reader.readBigEndian(2, &trackCount) ||
+        !reader.readBigEndian(2, &division) || !reader.skip(headerLength - 6)) {
+        return std::nullopt;
+    }
+
+    // format 2 files contain independent sequences, which don't make sense to play at once
+    if (format > 1 || division == 0) return std::nullopt;
+
+    std::vector<RawEvent> rawEvents;
+    uint64_t endTick = 0;
+    uint32_t readTrackCount = 0;
+    while (readTrackCount < trackCount && !reader.atEnd()) {
+        auto isTrack = reader.readTag("MTrk");
+        uint32_t chunkLength;
+        if ((!isTrack && !reader.skip(4)) || !reader.readBigEndian(4, &chunkLength)) return std::nullopt;
+
+        auto chunkStart = reader.pos();
+        if (!reader.skip(chunkLength)) return std::nullopt;
+
+        // unknown chunks must be ignored
+        if (!isTrack) continue;
+
+        Reader trackReader((const uint8_t *) contents.constData() + chunkStart, chunkLength);
+        if (!readTrack(trackReader, &rawEvents, &endTick)) return std::nullopt;
+        readTrackCount++;
+    }
+
+    // merge the tracks, keeping events at the same tick in the order they appear
+    std::stable_sort(rawEvents.begin(), rawEvents.end(),
+                     [](const RawEvent &a, const RawEvent &b) { return a.tick < b.tick; });
+
+    // SMPTE divisions have a fixed number of ticks per second, otherwise it depends on the tempo
+    auto isSmpte = (division & 0x8000) != 0;
+    auto smpteTicksPerSecond = (double) -(int8_t)(division >> 8) * (double) (division & 0xFF);
+    auto ticksPerQuarter = (double) division;
+
+    MidiFile midiFile;
+    uint32_t tempo = DEFAULT_TEMPO;
+    uint64_t lastTick = 0;
+    double lastTime = 0;
+    auto tickToTime = [&](uint64_t tick) {
+        auto deltaTicks = (double) (tick - lastTick);
+        if (isSmpte) return lastTime + deltaTicks / smpteTicksPerSecond;
+        return lastTime + deltaTicks * tempo / (ticksPerQuarter * 1000000.);
+    };
+
+    for (const auto &rawEvent : rawEvents) {
+        auto time = tickToTime(rawEvent.tick);
+        lastTick = rawEvent.tick;
+        lastTime = time;
+
+        if (rawEvent.status == 0xFF) {
+            if (rawEvent.tempo == 0) continue;
+            tempo = rawEvent.tempo;
+            midiFile.tempoChanges.push_back({time, 60000000.f / tempo});
+        } else if (auto event = convertEvent(rawEvent)) {
+            midiFile.events.push_back({time, *event});
+        }
+    }
+    midiFile.length = tickToTime(endTick);
+
+    return midiFile;
+}
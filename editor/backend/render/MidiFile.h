@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <optional>
+#include <vector>
+
+#include "../AudioBackend.h"
+
+namespace AxiomRender {
+
+    // A Standard MIDI File, with all tracks merged into a single list of events timed in seconds.
+    class MidiFile {
+    public:
+        struct Event {
+            double time;
+            AxiomBackend::MidiEvent event;
+        };
+
+        struct TempoChange {
+            double time;
+            float bpm;
+        };
+
+        std::vector<Event> events;
+        std::vector<TempoChange> tempoChanges;
+
+        // The time of the last event in the file (including meta events such as end of track), in seconds.
+        double length = 0;
+
+        // Loads a format 0 or format 1 file. Returns an empty optional if the file can't be read or isn't valid.
+        static std::optional<MidiFile> load(const QString &path);
+    };
+}
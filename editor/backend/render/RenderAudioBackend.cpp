@@ -0,0 +1,79 @@
+#include "RenderAudioBackend.h"
+
+#include <QtCore/QFile>
+#include <algorithm>
+#include <iostream>
+
+#include "../../model/Project.h"
+#include "../../model/serialize/ProjectSerializer.h"
+
+using namespace AxiomBackend;
+using namespace AxiomRender;
+
+void RenderAudioBackend::handleConfigurationChange(const AudioConfiguration &configuration) {
+    midiInputPortal = -1;
+    audioOutputPortal = -1;
+    for (size_t i = 0; i < configuration.portals.size(); i++) {
+        const auto &portal = configuration.portals[i];
+        if (audioOutputPortal == -1 && portal.type == PortalType::OUTPUT && portal.value == PortalValue::AUDIO) {
+            audioOutputPortal = (ssize_t) i;
+        } else if (midiInputPortal == -1 && portal.type == PortalType::INPUT && portal.value == PortalValue::MIDI) {
+            midiInputPortal = (ssize_t) i;
+        }
+
+        if (audioOutputPortal != -1 && midiInputPortal != -1) {
+            break;
+        }
+    }
+}
+
+DefaultConfiguration RenderAudioBackend::createDefaultConfiguration() {
+    return DefaultConfiguration({DefaultPortal(PortalType::OUTPUT, PortalValue::AUDIO, "Speakers")});
+}
+
+void RenderAudioBackend::render(float *left, float *right, uint64_t frames) {
+    auto lock = lockRuntime();
+
+    uint64_t processPos = 0;
+    while (processPos < frames) {
+        auto sampleAmount = std::min(beginGenerate(), frames - processPos);
+        auto leftOutput = left + processPos;
+        auto rightOutput = right + processPos;
+        if (audioOutputPortal != -1) {
+            bindAudioOutput((size_t) audioOutputPortal, leftOutput, rightOutput);
+        } else {
+            std::fill_n(leftOutput, sampleAmount, 0.f);
+            std::fill_n(rightOutput, sampleAmount, 0.f);
+        }
+        generateBlock(sampleAmount);
+
+        processPos += sampleAmount;
+    }
+}
+
+std::unique_ptr<AxiomModel::Project> AxiomRender::loadProject(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Couldn't open project " << path.toStdString() << std::endl;
+        return nullptr;
+    }
+
+    QDataStream stream(&file);
+    uint32_t readVersion = 0;
+    auto project = AxiomModel::ProjectSerializer::deserialize(
+        stream, &readVersion, [](AxiomModel::Library *) {}, [path](QDataStream &, uint32_t) { return path; });
+
+    if (!project) {
+        if (readVersion) {
+            std::cerr << "Project " << path.toStdString()
+                      << " was created with an incompatible version of Axiom (expected version between "
+                      << AxiomModel::ProjectSerializer::minSchemaVersion << " and "
+                      << AxiomModel::ProjectSerializer::schemaVersion << ", actual version " << readVersion << ")"
+                      << std::endl;
+        } else {
+            std::cerr << "Project " << path.toStdString() << " is an invalid project file (bad magic header)"
+                      << std::endl;
+        }
+    }
+    return project;
+}
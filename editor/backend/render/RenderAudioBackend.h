@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <memory>
+
+#include "../AudioBackend.h"
+
+namespace AxiomModel {
+    class Project;
+}
+
+namespace AxiomRender {
+
+    // A backend that isn't connected to any audio device, used to render projects offline. Like the standalone
+    // backend, only the first MIDI input and first audio output portals are used.
+    class RenderAudioBackend : public AxiomBackend::AudioBackend {
+    public:
+        ssize_t midiInputPortal = -1;
+        ssize_t audioOutputPortal = -1;
+
+        void handleConfigurationChange(const AxiomBackend::AudioConfiguration &configuration) override;
+
+        AxiomBackend::DefaultConfiguration createDefaultConfiguration() override;
+
+        bool doesSaveInternally() const override { return false; }
+
+        std::string getPortalLabel(size_t portalIndex) const override { return "?"; }
+
+        // Renders a block of frames from the audio output into the channel buffers, inputting any queued MIDI events
+        // on the way. Locks the runtime while rendering.
+        void render(float *left, float *right, uint64_t frames);
+    };
+
+    // Loads a project file without importing any libraries embedded in it, printing an error and returning null if
+    // it can't be loaded.
+    std::unique_ptr<AxiomModel::Project> loadProject(const QString &path);
+}
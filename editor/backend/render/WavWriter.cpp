@@ -0,0 +1,92 @@
+#include "WavWriter.h"
+
+#include <QtCore/QtEndian>
+#include <cstring>
+
+using namespace AxiomRender;
+
+namespace {
+    constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+    constexpr uint32_t HEADER_SIZE = 58;
+
+    void writeTag(char *&out, const char *tag) {
+        memcpy(out, tag, 4);
+        out += 4;
+    }
+
+    void writeU16(char *&out, uint16_t value) {
+        qToLittleEndian(value, out);
+        out += 2;
+    }
+
+    void writeU32(char *&out, uint32_t value) {
+        qToLittleEndian(value, out);
+        out += 4;
+    }
+}
+
+WavWriter::WavWriter(QString path, uint32_t sampleRate, uint16_t channelCount)
+    : _file(std::move(path)), _sampleRate(sampleRate), _channelCount(channelCount) {}
+
+WavWriter::~WavWriter() {
+    if (_file.isOpen()) close();
+}
+
+bool WavWriter::open() {
+    return _file.open(QIODevice::WriteOnly | QIODevice::Truncate) && writeHeader();
+}
+
+bool WavWriter::write(const float *samples, uint64_t frameCount) {
+    auto sampleCount = frameCount * _channelCount;
+    _buffer.resize(sampleCount * sizeof(float));
+
+    auto out = _buffer.data();
+    for (uint64_t i = 0; i < sampleCount; i++) {
+        uint32_t sampleBits;
+        memcpy(&sampleBits, &samples[i], sizeof(float));
+        writeU32(out, sampleBits);
+    }
+
+    auto byteCount = (qint64) _buffer.size();
+    if (_file.write(_buffer.data(), byteCount) != byteCount) return false;
+
+    _frameCount += frameCount;
+    return true;
+}
+
+bool WavWriter::close() {
+    auto success = _file.seek(0) && writeHeader();
+    _file.close();
+    return success;
+}
+
+bool WavWriter::writeHeader() {
+    auto bytesPerFrame = (uint32_t)(_channelCount * sizeof(float));
+    auto dataSize = (uint32_t)(_frameCount * bytesPerFrame);
+
+    // float files need the extended format chunk and a fact chunk, for readers that are strict about it
+    char header[HEADER_SIZE];
+    auto out = header;
+    writeTag(out, "RIFF");
+    writeU32(out, HEADER_SIZE - 8 + dataSize);
+    writeTag(out, "WAVE");
+
+    writeTag(out, "fmt ");
+    writeU32(out, 18);
+    writeU16(out, WAVE_FORMAT_IEEE_FLOAT);
+    writeU16(out, _channelCount);
+    writeU32(out, _sampleRate);
+    writeU32(out, _sampleRate * bytesPerFrame);
+    writeU16(out, (uint16_t) bytesPerFrame);
+    writeU16(out, 32);
+    writeU16(out, 0);
+
+    writeTag(out, "fact");
+    writeU32(out, 4);
+    writeU32(out, (uint32_t) _frameCount);
+
+    writeTag(out, "data");
+    writeU32(out, dataSize);
+
+    return _file.write(header, HEADER_SIZE) == HEADER_SIZE;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+#include <vector>
+
+namespace AxiomRender {
+
+    // Writes interleaved 32-bit float samples to a WAV file. The header is written when the file is opened and its
+    // sizes are filled in when it's closed, so samples can be written as they're rendered.
+    class WavWriter {
+    public:
+        WavWriter(QString path, uint32_t sampleRate, uint16_t channelCount);
+
+        ~WavWriter();
+
+        bool open();
+
+        bool write(const float *samples, uint64_t frameCount);
+
+        bool close();
+
+    private:
+        QFile _file;
+        uint32_t _sampleRate;
+        uint16_t _channelCount;
+        uint64_t _frameCount = 0;
+        std::vector<char> _buffer;
+
+        bool writeHeader();
+    };
+}
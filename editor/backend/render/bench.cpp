@@ -0,0 +1,294 @@
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QProcess>
+#include <QtCore/QTemporaryFile>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../../compiler/interface/Frontend.h"
+#include "../../compiler/interface/Runtime.h"
+#include "../../model/ModelRoot.h"
+#include "../../model/Project.h"
+#include "RenderAudioBackend.h"
+
+using namespace AxiomRender;
+
+// Each project is benchmarked in a separate process, so the peak memory usage is for that project alone and a crash
+// in one doesn't lose the results of the others.
+static const char *CHILD_OPTION = "bench-child";
+
+static uint64_t getPeakResidentBytes() {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef Q_OS_DARWIN
+    return (uint64_t) usage.ru_maxrss;
+#else
+    return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+struct BenchOptions {
+    uint32_t sampleRate;
+    uint64_t blockSize;
+    double seconds;
+    std::vector<uint32_t> voiceCounts;
+    std::vector<uint32_t> workerThreadCounts;
+};
+
+static std::optional<QJsonObject> benchProject(const QString &path, uint32_t voiceCount, uint32_t workerThreads,
+                                               const BenchOptions &options) {
+    // a new runtime is used for each run, so voices and state from previous runs can't affect the results
+    RenderAudioBackend backend;
+    MaximCompiler::Runtime runtime(false, MaximFrontend::OptimizationProfile::SPEED);
+    runtime.setWorkerThreads(workerThreads);
+
+    auto project = loadProject(path);
+    if (!project) return std::nullopt;
+
+    auto buildStartTime = std::chrono::high_resolution_clock::now();
+    project->attachBackend(&backend);
+    backend.internalAttachProject(project.get(), &runtime);
+    project->mainRoot().attachRuntime(&runtime);
+    auto buildEndTime = std::chrono::high_resolution_clock::now();
+    auto commitTimings = runtime.getLastCommitTimings();
+    auto memoryUsage = runtime.getMemoryUsage();
+
+    backend.setSampleRate((float) options.sampleRate);
+    backend.setBpm(120);
+
+    // hold down a note for each voice
+    if (backend.midiInputPortal != -1) {
+        for (uint32_t voiceIndex = 0; voiceIndex < voiceCount; voiceIndex++) {
+            AxiomBackend::MidiEvent event;
+            event.event = AxiomBackend::MidiEventType::NOTE_ON;
+            event.note = (uint8_t)((36 + voiceIndex) % 128);
+            event.param = 200;
+            backend.queueMidiEvent(0, (size_t) backend.midiInputPortal, event);
+        }
+    }
+
+    std::vector<float> leftBuffer(options.blockSize);
+    std::vector<float> rightBuffer(options.blockSize);
+
+    // render a short time first so the measurement doesn't include note attacks or first-touch page faults
+    auto warmupFrames = (uint64_t)(options.sampleRate / 10);
+    for (uint64_t renderedFrames = 0; renderedFrames < warmupFrames; renderedFrames += options.blockSize) {
+        backend.render(leftBuffer.data(), rightBuffer.data(), options.blockSize);
+    }
+
+    auto totalFrames = (uint64_t)(options.seconds * options.sampleRate);
+    uint64_t renderedFrames = 0;
+    auto renderStartTime = std::chrono::high_resolution_clock::now();
+    while (renderedFrames < totalFrames) {
+        auto blockFrames = std::min(options.blockSize, totalFrames - renderedFrames);
+        backend.render(leftBuffer.data(), rightBuffer.data(), blockFrames);
+        renderedFrames += blockFrames;
+    }
+    auto renderEndTime = std::chrono::high_resolution_clock::now();
+
+    auto renderNanoseconds = std::chrono::duration<double, std::nano>(renderEndTime - renderStartTime).count();
+    auto nanosecondsPerSample = renderedFrames ? renderNanoseconds / renderedFrames : 0;
+
+    // voices past the capacity of a group, or notes the project doesn't play, don't count
+    auto &root = project->mainRoot();
+    root.updateRuntimeSnapshot();
+    uint32_t activeVoices = 0;
+    for (const auto &node : root.nodes().sequence()) {
+        if (node->isExtracted()) activeVoices = std::max(activeVoices, node->activeVoiceCount());
+    }
+
+    QJsonObject commitObject;
+    commitObject["patchSeconds"] = commitTimings.patchSeconds;
+    commitObject["codegenSeconds"] = commitTimings.codegenSeconds;
+    commitObject["deploySeconds"] = commitTimings.deploySeconds;
+
+    QJsonObject codeObject;
+    codeObject["modules"] = (qint64) memoryUsage.moduleCount;
+    codeObject["objectBytes"] = (qint64) memoryUsage.objectBytes;
+    codeObject["releasedIrBytes"] = (qint64) memoryUsage.releasedIrBytes;
+
+    QJsonObject result;
+    result["requestedVoices"] = (qint64) voiceCount;
+    result["workerThreads"] = (qint64) workerThreads;
+    result["activeVoices"] = (qint64) activeVoices;
+    result["hasMidiInput"] = backend.midiInputPortal != -1;
+    result["hasAudioOutput"] = backend.audioOutputPortal != -1;
+    result["buildSeconds"] = std::chrono::duration<double>(buildEndTime - buildStartTime).count();
+    result["commit"] = commitObject;
+    result["code"] = codeObject;
+    result["renderedSamples"] = (qint64) renderedFrames;
+    result["nanosecondsPerSample"] = nanosecondsPerSample;
+    result["realtimeFactor"] = nanosecondsPerSample ? 1e9 / (nanosecondsPerSample * options.sampleRate) : 0;
+    return result;
+}
+
+static int runChild(const QString &projectPath, const QString &resultPath, const BenchOptions &options) {
+    MaximFrontend::maxim_initialize();
+
+    // each voice count is run with each number of worker threads, so the results show whether the workers help
+    QJsonArray runs;
+    for (auto voiceCount : options.voiceCounts) {
+        for (auto workerThreads : options.workerThreadCounts) {
+            auto run = benchProject(projectPath, voiceCount, workerThreads, options);
+            if (!run) return 1;
+            runs.append(*run);
+        }
+    }
+
+    QJsonObject result;
+    result["runs"] = runs;
+    result["peakResidentBytes"] = (qint64) getPeakResidentBytes();
+
+    QFile resultFile(resultPath);
+    if (!resultFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) return 1;
+    resultFile.write(QJsonDocument(result).toJson(QJsonDocument::Compact));
+    return 0;
+}
+
+static QStringList findProjects(const QStringList &paths) {
+    QStringList projects;
+    for (const auto &path : paths) {
+        QDir dir(path);
+        if (dir.exists()) {
+            for (const auto &entry : dir.entryInfoList({"*.axp"}, QDir::Files, QDir::Name)) {
+                projects.append(entry.filePath());
+            }
+        } else {
+            projects.append(path);
+        }
+    }
+    return projects;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("Axiom");
+    QCoreApplication::setApplicationVersion(AXIOM_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Benchmarks building and rendering Axiom projects, and writes the results as JSON.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(
+        "projects", "Project files or directories of projects to benchmark. Defaults to the bundled examples.",
+        "[projects...]");
+
+    QCommandLineOption outputOption({"o", "output"}, "File to write results to, instead of standard output.",
+                                    "file");
+    QCommandLineOption sampleRateOption({"r", "sample-rate"}, "Sample rate to render at.", "hz", "44100");
+    QCommandLineOption blockSizeOption("block-size", "Number of frames rendered in each block.", "frames", "512");
+    QCommandLineOption secondsOption({"s", "seconds"}, "Seconds of audio to render in each run.", "seconds", "5");
+    QCommandLineOption voicesOption("voices", "Comma-separated numbers of voices to hold down in each run.",
+                                    "counts", "1,8,32");
+    QCommandLineOption workerThreadsOption(
+        "worker-threads",
+        "Comma-separated numbers of extra threads to render the voices of extracted groups on in each run.", "counts",
+        "0");
+    QCommandLineOption childOption(CHILD_OPTION, "Internal.", "result");
+    childOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({outputOption, sampleRateOption, blockSizeOption, secondsOption, voicesOption,
+                       workerThreadsOption, childOption});
+    parser.process(application);
+
+    BenchOptions options;
+    options.sampleRate = parser.value(sampleRateOption).toUInt();
+    options.blockSize = (uint64_t) parser.value(blockSizeOption).toULongLong();
+    options.seconds = parser.value(secondsOption).toDouble();
+    for (const auto &voiceCount : parser.value(voicesOption).split(',', QString::SkipEmptyParts)) {
+        options.voiceCounts.push_back(voiceCount.toUInt());
+    }
+    for (const auto &workerThreads : parser.value(workerThreadsOption).split(',', QString::SkipEmptyParts)) {
+        options.workerThreadCounts.push_back(workerThreads.toUInt());
+    }
+    if (options.sampleRate == 0 || options.blockSize == 0 || options.voiceCounts.empty() ||
+        options.workerThreadCounts.empty()) {
+        std::cerr << "Sample rate, block size and voice counts must be positive numbers, and a worker thread count is "
+                     "needed"
+                  << std::endl;
+        return 1;
+    }
+
+    if (parser.isSet(childOption)) {
+        return runChild(parser.positionalArguments().value(0), parser.value(childOption), options);
+    }
+
+    auto projectPaths = parser.positionalArguments();
+    auto projects = findProjects(projectPaths.empty() ? QStringList{AXIOM_EXAMPLES_DIR} : projectPaths);
+    if (projects.empty()) {
+        std::cerr << "No projects to benchmark" << std::endl;
+        return 1;
+    }
+
+    auto succeeded = true;
+    QJsonArray projectResults;
+    for (const auto &projectPath : projects) {
+        std::cerr << "Benchmarking " << projectPath.toStdString() << std::endl;
+
+        QTemporaryFile resultFile;
+        resultFile.open();
+
+        // pass our options through to the child, the runtime's own logging is discarded
+        QStringList childArguments{projectPath, "--" + QString(CHILD_OPTION), resultFile.fileName()};
+        for (const auto &option :
+             {sampleRateOption, blockSizeOption, secondsOption, voicesOption, workerThreadsOption}) {
+            childArguments << "--" + option.names().last() << parser.value(option);
+        }
+
+        QProcess childProcess;
+        childProcess.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        childProcess.setStandardOutputFile(QProcess::nullDevice());
+        childProcess.start(QCoreApplication::applicationFilePath(), childArguments);
+        childProcess.waitForFinished(-1);
+
+        QJsonObject projectResult;
+        if (childProcess.exitStatus() == QProcess::NormalExit && childProcess.exitCode() == 0) {
+            projectResult = QJsonDocument::fromJson(resultFile.readAll()).object();
+        } else {
+            projectResult["error"] = "Benchmark process failed";
+            succeeded = false;
+        }
+        projectResult["project"] = QFileInfo(projectPath).fileName();
+        projectResults.append(projectResult);
+    }
+
+    QJsonObject results;
+    results["version"] = QCoreApplication::applicationVersion();
+    results["sampleRate"] = (qint64) options.sampleRate;
+    results["blockSize"] = (qint64) options.blockSize;
+    results["projects"] = projectResults;
+    auto resultsJson = QJsonDocument(results).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile outputFile(parser.value(outputOption));
+        if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::cerr << "Couldn't open " << parser.value(outputOption).toStdString() << " for writing" << std::endl;
+            return 1;
+        }
+        outputFile.write(resultsJson);
+    } else {
+        std::cout << resultsJson.toStdString();
+    }
+
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include "../../compiler/interface/Frontend.h"
+#include "../../compiler/interface/Runtime.h"
+#include "../../model/ModelRoot.h"
+#include "../../model/Project.h"
+#include "MidiFile.h"
+#include "RenderAudioBackend.h"
+#include "WavWriter.h"
+
+using namespace AxiomRender;
+
+int main(int argc, char *argv[]) {
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("Axiom");
+    QCoreApplication::setApplicationVersion(AXIOM_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders an Axiom project to a WAV file as fast as possible, without the editor.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("project", "The project file to render.");
+    parser.addPositionalArgument("output", "The WAV file to write.");
+
+    QCommandLineOption midiOption({"m", "midi"}, "Standard MIDI File to play into the project's MIDI input.", "file");
+    QCommandLineOption sampleRateOption({"r", "sample-rate"}, "Sample rate to render at.", "hz", "44100");
+    QCommandLineOption bpmOption({"b", "bpm"}, "Tempo, overriding any tempo in the MIDI file.", "bpm");
+    QCommandLineOption lengthOption({"l", "length"},
+                                    "Seconds to render. Defaults to the MIDI file's length plus the tail.", "seconds");
+    QCommandLineOption tailOption({"t", "tail"}, "Seconds to keep rendering after the MIDI file ends.", "seconds",
+                                  "2");
+    QCommandLineOption blockSizeOption("block-size", "Number of frames rendered in each block.", "frames", "512");
+    QCommandLineOption workerThreadsOption(
+        "worker-threads", "Number of extra threads to render the voices of extracted groups on.", "count",
+        "0");
+    parser.addOptions(
+        {midiOption, sampleRateOption, bpmOption, lengthOption, tailOption, blockSizeOption, workerThreadsOption});
+    parser.process(application);
+
+    auto positionalArguments = parser.positionalArguments();
+    if (positionalArguments.size() != 2) {
+        parser.showHelp(1);
+    }
+
+    auto sampleRate = parser.value(sampleRateOption).toUInt();
+    auto blockSize = (uint64_t) parser.value(blockSizeOption).toULongLong();
+    auto tail = parser.value(tailOption).toDouble();
+    if (sampleRate == 0 || blockSize == 0) {
+        std::cerr << "Sample rate and block size must be positive numbers" << std::endl;
+        return 1;
+    }
+
+    std::optional<MidiFile> midiFile;
+    if (parser.isSet(midiOption)) {
+        midiFile = MidiFile::load(parser.value(midiOption));
+        if (!midiFile) {
+            std::cerr << "Couldn't read MIDI file " << parser.value(midiOption).toStdString() << std::endl;
+            return 1;
+        }
+    } else if (!parser.isSet(lengthOption)) {
+        std::cerr << "A length must be provided when there's no MIDI file" << std::endl;
+        return 1;
+    }
+
+    auto length = parser.isSet(lengthOption) ? parser.value(lengthOption).toDouble() : midiFile->length + tail;
+    auto totalFrames = (uint64_t) std::ceil(length * sampleRate);
+
+    MaximFrontend::maxim_initialize();
+
+    // the backend and runtime are declared before the project so they outlive it
+    RenderAudioBackend backend;
+    MaximCompiler::Runtime runtime(false, MaximFrontend::OptimizationProfile::SPEED);
+    runtime.setWorkerThreads(parser.value(workerThreadsOption).toUInt());
+    runtime.setCompileThreads(std::max(1u, std::thread::hardware_concurrency()));
+
+    auto project = loadProject(positionalArguments[0]);
+    if (!project) return 1;
+
+    auto buildStartTime = std::chrono::high_resolution_clock::now();
+    project->attachBackend(&backend);
+    backend.internalAttachProject(project.get(), &runtime);
+    project->mainRoot().attachRuntime(&runtime, project->optimizationProfile());
+    auto buildEndTime = std::chrono::high_resolution_clock::now();
+
+    if (backend.audioOutputPortal == -1) {
+        std::cerr << "Project doesn't have an audio output" << std::endl;
+        return 1;
+    }
+    if (midiFile && backend.midiInputPortal == -1) {
+        std::cerr << "Warning: project doesn't have a MIDI input, the MIDI file will be ignored" << std::endl;
+    }
+
+    WavWriter writer(positionalArguments[1], sampleRate, 2);
+    if (!writer.open()) {
+        std::cerr << "Couldn't open " << positionalArguments[1].toStdString() << " for writing" << std::endl;
+        return 1;
+    }
+
+    std::vector<MidiFile::Event> events;
+    std::vector<MidiFile::TempoChange> tempoChanges;
+    if (midiFile && backend.midiInputPortal != -1) events = std::move(midiFile->events);
+    if (midiFile && !parser.isSet(bpmOption)) tempoChanges = std::move(midiFile->tempoChanges);
+    auto toFrame = [sampleRate](double time) { return (uint64_t) std::llround(time * sampleRate); };
+
+    backend.setSampleRate((float) sampleRate);
+    backend.setBpm(parser.isSet(bpmOption) ? parser.value(bpmOption).toFloat() : 120);
+
+    std::vector<float> leftBuffer(blockSize);
+    std::vector<float> rightBuffer(blockSize);
+    std::vector<float> interleavedBuffer(blockSize * 2);
+    size_t nextEvent = 0;
+    size_t nextTempoChange = 0;
+    uint64_t renderedFrames = 0;
+
+    auto renderStartTime = std::chrono::high_resolution_clock::now();
+    while (renderedFrames < totalFrames) {
+        auto blockFrames = std::min(blockSize, totalFrames - renderedFrames);
+
+        // tempo changes are applied between blocks, so blocks are split at them
+        while (nextTempoChange < tempoChanges.size() &&
+               toFrame(tempoChanges[nextTempoChange].time) <= renderedFrames) {
+            backend.setBpm(tempoChanges[nextTempoChange].bpm);
+            nextTempoChange++;
+        }
+        if (nextTempoChange < tempoChanges.size()) {
+            blockFrames = std::min(blockFrames, toFrame(tempoChanges[nextTempoChange].time) - renderedFrames);
+        }
+
+        // only the events in this block are queued, since the backend can only hold a limited number at once
+        while (nextEvent < events.size() && toFrame(events[nextEvent].time) < renderedFrames + blockFrames) {
+            auto eventFrame = std::max(toFrame(events[nextEvent].time), renderedFrames);
+            backend.queueMidiEvent(eventFrame - renderedFrames, (size_t) backend.midiInputPortal,
+                                   events[nextEvent].event);
+            nextEvent++;
+        }
+
+        backend.render(leftBuffer.data(), rightBuffer.data(), blockFrames);
+
+        for (uint64_t frame = 0; frame < blockFrames; frame++) {
+            interleavedBuffer[frame * 2] = leftBuffer[frame];
+            interleavedBuffer[frame * 2 + 1] = rightBuffer[frame];
+        }
+        if (!writer.write(interleavedBuffer.data(), blockFrames)) {
+            std::cerr << "Failed writing to " << positionalArguments[1].toStdString() << std::endl;
+            return 1;
+        }
+
+        renderedFrames += blockFrames;
+    }
+    auto renderEndTime = std::chrono::high_resolution_clock::now();
+
+    if (!writer.close()) {
+        std::cerr << "Failed writing to " << positionalArguments[1].toStdString() << std::endl;
+        return 1;
+    }
+
+    auto buildSeconds = std::chrono::duration<double>(buildEndTime - buildStartTime).count();
+    auto renderSeconds = std::chrono::duration<double>(renderEndTime - renderStartTime).count();
+    auto audioSeconds = (double) renderedFrames / sampleRate;
+    std::cout << "Built project in " << buildSeconds << "s" << std::endl;
+    std::cout << "Rendered " << audioSeconds << "s of audio in " << renderSeconds << "s ("
+              << renderedFrames / renderSeconds << " samples/s, " << audioSeconds / renderSeconds << "x realtime)"
+              << std::endl;
+
+    return 0;
+}
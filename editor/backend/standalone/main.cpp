@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "../../AxiomApplication.h"
@@ -14,23 +15,20 @@ class StandaloneAudioBackend : public AudioBackend {
 public:
     ssize_t midiInputPortal = -1;
     ssize_t audioOutputPortal = -1;
-    NumValue **outputPortal = nullptr;
 
     void handleConfigurationChange(const AudioConfiguration &configuration) override {
         // we only care about the first MIDI input and first number output portal
         midiInputPortal = -1;
         audioOutputPortal = -1;
-        outputPortal = nullptr;
         for (size_t i = 0; i < configuration.portals.size(); i++) {
             const auto &portal = configuration.portals[i];
-            if (outputPortal == nullptr && portal.type == PortalType::OUTPUT && portal.value == PortalValue::AUDIO) {
-                audioOutputPortal = i;
-                outputPortal = getAudioPortal(i);
+            if (audioOutputPortal == -1 && portal.type == PortalType::OUTPUT && portal.value == PortalValue::AUDIO) {
+                audioOutputPortal = (ssize_t) i;
             } else if (midiInputPortal == -1 && portal.type == PortalType::INPUT && portal.value == PortalValue::MIDI) {
                 midiInputPortal = (ssize_t) i;
             }
 
-            if (outputPortal != nullptr && midiInputPortal != -1) {
+            if (audioOutputPortal != -1 && midiInputPortal != -1) {
                 break;
             }
         }
@@ -51,7 +49,6 @@ public:
 
     void previewEvent(AxiomBackend::MidiEvent event) override {
         if (midiInputPortal == -1) return;
-        auto lock = lockRuntime();
         queueMidiEvent(0, (size_t) midiInputPortal, event);
     }
 
@@ -70,28 +67,24 @@ public:
         auto backend = (StandaloneAudioBackend *) userData;
         uint64_t processPos = 0;
 
-        auto outputNums = (float *) outputBuffer;
+        // the stream is non-interleaved, so we get a separate buffer for each channel that the runtime can write to
+        auto outputChannels = (float **) outputBuffer;
 
         auto sampleFrames64 = (uint64_t) framesPerBuffer;
         while (processPos < sampleFrames64) {
             auto lock = backend->lockRuntime();
-            auto sampleAmount = backend->beginGenerate();
+            auto sampleAmount = std::min(backend->beginGenerate(), sampleFrames64 - processPos);
             auto endProcessPos = processPos + sampleAmount;
-            if (endProcessPos > sampleFrames64) endProcessPos = sampleFrames64;
 
-            for (auto i = processPos; i < endProcessPos; i++) {
-                backend->generate();
-
-                if (backend->outputPortal) {
-                    auto outputNum = **backend->outputPortal;
-                    *outputNums++ = outputNum.left;
-                    *outputNums++ = outputNum.right;
-                }
-
-                if (backend->midiInputPortal != -1 && i == processPos) {
-                    backend->clearMidi((size_t) backend->midiInputPortal);
-                }
+            auto leftOutput = outputChannels[0] + processPos;
+            auto rightOutput = outputChannels[1] + processPos;
+            if (backend->audioOutputPortal != -1) {
+                backend->bindAudioOutput((size_t) backend->audioOutputPortal, leftOutput, rightOutput);
+            } else {
+                std::fill_n(leftOutput, sampleAmount, 0.f);
+                std::fill_n(rightOutput, sampleAmount, 0.f);
             }
+            backend->generateBlock(sampleAmount);
 
             processPos = endProcessPos;
         }
@@ -107,7 +100,8 @@ public:
         checkError(Pa_OpenDefaultStream(&stream,
                                         0, // no inputs
                                         2, // stereo output
-                                        paFloat32, 44100, paFramesPerBufferUnspecified, paCallback, this));
+                                        paFloat32 | paNonInterleaved, 44100, paFramesPerBufferUnspecified,
+                                        paCallback, this));
         checkError(Pa_StartStream(stream));
     }
 
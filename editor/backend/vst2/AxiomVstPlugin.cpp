@@ -1,5 +1,7 @@
 #include "AxiomVstPlugin.h"
 
+#include <algorithm>
+
 using namespace AxiomBackend;
 
 AxiomCommon::LazyInitializer<AxiomApplication> application;
@@ -48,40 +50,32 @@ void AxiomVstPlugin::processReplacing(float **inputs, float **outputs, VstInt32
     uint64_t processPos = 0;
     while (processPos < sampleFrames64) {
         auto lock = backend.lockRuntime();
-        auto sampleAmount = backend.beginGenerate();
+        auto sampleAmount = std::min(backend.beginGenerate(), sampleFrames64 - processPos);
         auto endProcessPos = processPos + sampleAmount;
-        if (endProcessPos > sampleFrames64) endProcessPos = sampleFrames64;
-
-        for (auto i = processPos; i < endProcessPos; i++) {
-            for (size_t inputIndex = 0; inputIndex < expectedInputCount; inputIndex++) {
-                const auto &input = backend.audioInputs[inputIndex];
-                if (input) {
-                    auto &inputNum = **input->value;
-                    inputNum.left = inputs[inputIndex * 2][i];
-                    inputNum.right = inputs[inputIndex * 2 + 1][i];
-                    inputNum.form = AxiomBackend::NumForm::OSCILLATOR;
-                }
-            }
 
-            backend.generate();
-
-            for (size_t outputIndex = 0; outputIndex < expectedOutputCount; outputIndex++) {
-                const auto &output = backend.audioOutputs[outputIndex];
-                auto leftIndex = outputIndex * 2;
-                auto rightIndex = leftIndex + 1;
-
-                if (output) {
-                    auto outputNum = **output->value;
-                    outputs[leftIndex][i] = outputNum.left;
-                    outputs[rightIndex][i] = outputNum.right;
-                } else {
-                    outputs[leftIndex][i] = 0;
-                    outputs[rightIndex][i] = 0;
-                }
+        // the runtime reads and writes the host's buffers directly, so we just need to bind them to the portals
+        for (size_t inputIndex = 0; inputIndex < expectedInputCount; inputIndex++) {
+            const auto &input = backend.audioInputs[inputIndex];
+            if (input) {
+                backend.bindAudioInput(input->portalIndex, inputs[inputIndex * 2] + processPos,
+                                       inputs[inputIndex * 2 + 1] + processPos);
+            }
+        }
+        for (size_t outputIndex = 0; outputIndex < expectedOutputCount; outputIndex++) {
+            const auto &output = backend.audioOutputs[outputIndex];
+            if (output) {
+                backend.bindAudioOutput(output->portalIndex, outputs[outputIndex * 2] + processPos,
+                                        outputs[outputIndex * 2 + 1] + processPos);
             }
+        }
+
+        backend.generateBlock(sampleAmount);
 
-            if (backend.midiInputPortal != -1 && i == processPos) {
-                backend.clearMidi((size_t) backend.midiInputPortal);
+        // outputs without a portal are cleared after generating, since hosts may process in-place
+        for (size_t outputIndex = 0; outputIndex < expectedOutputCount; outputIndex++) {
+            if (!backend.audioOutputs[outputIndex]) {
+                std::fill_n(outputs[outputIndex * 2] + processPos, sampleAmount, 0.f);
+                std::fill_n(outputs[outputIndex * 2 + 1] + processPos, sampleAmount, 0.f);
             }
         }
 
@@ -45,18 +45,51 @@ namespace MaximFrontend {
         void *ui;
     };
 
+    struct PortalBuffer {
+        void *portal;
+        float *left;
+        float *right;
+        uint8_t form;
+    };
+
+    // How generated code is optimized. Must match `OptimizationProfile` in the compiler.
+    enum class OptimizationProfile : uint8_t { SIZE, BALANCED, SPEED };
+
+    struct CommitTimings {
+        double patchSeconds;
+        double codegenSeconds;
+        double deploySeconds;
+    };
+
+    struct MemoryUsage {
+        uint64_t moduleCount;
+        uint64_t objectBytes;
+        uint64_t releasedIrBytes;
+    };
+
     extern "C" {
     void maxim_initialize();
 
-    MaximRuntime *maxim_create_runtime(bool includeUi, bool minSize);
+    MaximRuntime *maxim_create_runtime(bool includeUi, uint8_t profile, const char *codeCachePath);
     void maxim_destroy_runtime(MaximRuntime *);
 
     uint64_t maxim_allocate_id(MaximRuntimeRef *runtime);
     void maxim_run_update(MaximRuntimeRef *runtime);
+    void maxim_run_block(MaximRuntimeRef *runtime, uint32_t frames, const PortalBuffer *inputs, uint32_t input_count,
+                         const PortalBuffer *outputs, uint32_t output_count);
     void maxim_set_bpm(MaximRuntimeRef *runtime, float bpm);
     float maxim_get_bpm(MaximRuntimeRef *runtime);
     void maxim_set_sample_rate(MaximRuntimeRef *runtime, float sample_rate);
     float maxim_get_sample_rate(MaximRuntimeRef *runtime);
+    CommitTimings maxim_get_last_commit_timings(MaximRuntimeRef *runtime);
+    MemoryUsage maxim_get_memory_usage(MaximRuntimeRef *runtime);
+    void maxim_set_worker_threads(MaximRuntimeRef *runtime, uint32_t count);
+    uint32_t maxim_get_worker_threads(MaximRuntimeRef *runtime);
+    void maxim_set_compile_threads(MaximRuntimeRef *runtime, uint32_t count);
+    void maxim_set_crossfade_time(MaximRuntimeRef *runtime, float seconds);
+    void maxim_set_noise_seed(MaximRuntimeRef *runtime, uint32_t seed);
+    void maxim_set_tiered_compilation(MaximRuntimeRef *runtime, bool tieredCompilation);
+    bool maxim_optimize_pending(MaximRuntimeRef *runtime);
     bool maxim_is_node_extracted(MaximRuntimeRef *runtime, uint64_t surface, size_t node);
     void maxim_convert_num(MaximRuntimeRef *runtime, void *result, uint8_t targetForm, const void *input);
 
@@ -73,6 +106,8 @@ namespace MaximFrontend {
 
     MaximTransaction *maxim_create_transaction();
     void maxim_destroy_transaction(MaximTransaction *);
+    void maxim_merge_transaction(MaximTransactionRef *transaction, MaximTransaction *newer);
+    void maxim_transaction_set_optimization_profile(MaximTransactionRef *transaction, uint8_t profile);
     void maxim_print_transaction_to_stdout(MaximTransactionRef *);
 
     MaximVarType *maxim_vartype_num();
@@ -123,6 +158,7 @@ namespace MaximFrontend {
     bool maxim_control_get_read(MaximBlockControlRef *control);
 
     void maxim_commit(MaximRuntimeRef *runtime, MaximTransaction *transaction);
+    void maxim_publish(MaximRuntimeRef *runtime);
 
     size_t maxim_get_function_table_size();
     const char *maxim_get_function_table_entry(size_t index);
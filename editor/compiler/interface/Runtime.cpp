@@ -4,8 +4,13 @@
 
 using namespace MaximCompiler;
 
-Runtime::Runtime(bool includeUi, bool minSize)
-    : OwnedObject(MaximFrontend::maxim_create_runtime(includeUi, minSize), &MaximFrontend::maxim_destroy_runtime) {}
+Runtime::Runtime(bool includeUi, MaximFrontend::OptimizationProfile profile)
+    : OwnedObject(MaximFrontend::maxim_create_runtime(includeUi, (uint8_t) profile, nullptr),
+                  &MaximFrontend::maxim_destroy_runtime) {}
+
+Runtime::Runtime(bool includeUi, MaximFrontend::OptimizationProfile profile, const std::string &codeCachePath)
+    : OwnedObject(MaximFrontend::maxim_create_runtime(includeUi, (uint8_t) profile, codeCachePath.c_str()),
+                  &MaximFrontend::maxim_destroy_runtime) {}
 
 uint64_t Runtime::nextId() {
     return MaximFrontend::maxim_allocate_id(get());
@@ -15,6 +20,11 @@ void Runtime::runUpdate() {
     MaximFrontend::maxim_run_update(get());
 }
 
+void Runtime::runBlock(uint32_t frames, const MaximFrontend::PortalBuffer *inputs, size_t inputCount,
+                       const MaximFrontend::PortalBuffer *outputs, size_t outputCount) {
+    MaximFrontend::maxim_run_block(get(), frames, inputs, (uint32_t) inputCount, outputs, (uint32_t) outputCount);
+}
+
 void Runtime::setBpm(float bpm) {
     MaximFrontend::maxim_set_bpm(get(), bpm);
 }
@@ -31,10 +41,50 @@ float Runtime::getSampleRate() {
     return MaximFrontend::maxim_get_sample_rate(get());
 }
 
+MaximFrontend::CommitTimings Runtime::getLastCommitTimings() {
+    return MaximFrontend::maxim_get_last_commit_timings(get());
+}
+
+MaximFrontend::MemoryUsage Runtime::getMemoryUsage() {
+    return MaximFrontend::maxim_get_memory_usage(get());
+}
+
+void Runtime::setWorkerThreads(uint32_t count) {
+    MaximFrontend::maxim_set_worker_threads(get(), count);
+}
+
+uint32_t Runtime::getWorkerThreads() {
+    return MaximFrontend::maxim_get_worker_threads(get());
+}
+
+void Runtime::setCompileThreads(uint32_t count) {
+    MaximFrontend::maxim_set_compile_threads(get(), count);
+}
+
+void Runtime::setCrossfadeTime(float seconds) {
+    MaximFrontend::maxim_set_crossfade_time(get(), seconds);
+}
+
+void Runtime::setNoiseSeed(uint32_t seed) {
+    MaximFrontend::maxim_set_noise_seed(get(), seed);
+}
+
+void Runtime::setTieredCompilation(bool tieredCompilation) {
+    MaximFrontend::maxim_set_tiered_compilation(get(), tieredCompilation);
+}
+
+bool Runtime::optimizePending() {
+    return MaximFrontend::maxim_optimize_pending(get());
+}
+
 void Runtime::commit(MaximCompiler::Transaction transaction) {
     MaximFrontend::maxim_commit(get(), transaction.release());
 }
 
+void Runtime::publish() {
+    MaximFrontend::maxim_publish(get());
+}
+
 bool Runtime::isNodeExtracted(uint64_t surface, size_t node) {
     return MaximFrontend::maxim_is_node_extracted(get(), surface, node);
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #include "OwnedObject.h"
 #include "Transaction.h"
 #include "editor/model/Value.h"
@@ -8,12 +10,19 @@ namespace MaximCompiler {
 
     class Runtime : public OwnedObject {
     public:
-        Runtime(bool includeUi, bool minSize);
+        Runtime(bool includeUi, MaximFrontend::OptimizationProfile profile);
+
+        // Stores compiled code in the directory, so it can be loaded instead of rebuilt the next time the same library,
+        // blocks and surfaces are needed, including by later processes.
+        Runtime(bool includeUi, MaximFrontend::OptimizationProfile profile, const std::string &codeCachePath);
 
         uint64_t nextId();
 
         void runUpdate();
 
+        void runBlock(uint32_t frames, const MaximFrontend::PortalBuffer *inputs, size_t inputCount,
+                      const MaximFrontend::PortalBuffer *outputs, size_t outputCount);
+
         void setBpm(float bpm);
 
         float getBpm();
@@ -22,8 +31,42 @@ namespace MaximCompiler {
 
         float getSampleRate();
 
+        // Returns how long each phase of the last commit took.
+        MaximFrontend::CommitTimings getLastCommitTimings();
+
+        // Reports how much memory the code the runtime is using takes, and how much was saved by releasing its IR.
+        MaximFrontend::MemoryUsage getMemoryUsage();
+
+        // Sets how many worker threads voices of extracted groups are spread across, in addition to the audio thread.
+        // Zero runs every voice on the audio thread. Must be called with the runtime locked.
+        void setWorkerThreads(uint32_t count);
+
+        uint32_t getWorkerThreads();
+
+        // Sets how many threads code is optimized and compiled on during a commit.
+        void setCompileThreads(uint32_t count);
+
+        // Sets how long the audio thread crossfades from old code to new code when a commit can't keep all of the
+        // old code's state, such as when a node is removed. Zero switches over immediately.
+        void setCrossfadeTime(float seconds);
+
+        // Sets the seed noise nodes built by later commits use, so renders of the same project are repeatable.
+        void setNoiseSeed(uint32_t seed);
+
+        // With tiered compilation, commits build changed code without optimization so edits are heard sooner.
+        // `optimizePending` replaces it with optimized code.
+        void setTieredCompilation(bool tieredCompilation);
+
+        // Builds optimized code to replace anything that was committed unoptimized, as a new generation that is
+        // published like a commit. Returns false if there was nothing to optimize, in which case nothing was built.
+        bool optimizePending();
+
+        // Builds the transaction into a new generation, without affecting the code the audio thread is running.
         void commit(Transaction transaction);
 
+        // Switches the audio thread over to the last committed generation.
+        void publish();
+
         bool isNodeExtracted(uint64_t surface, size_t node);
 
         AxiomModel::NumValue convertNum(AxiomModel::FormType targetForm, const AxiomModel::NumValue &value);
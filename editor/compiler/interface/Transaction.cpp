@@ -19,6 +19,14 @@ void Transaction::buildBlock(MaximCompiler::Block block) {
     MaximFrontend::maxim_build_block(get(), block.release());
 }
 
+void Transaction::merge(MaximCompiler::Transaction newer) {
+    MaximFrontend::maxim_merge_transaction(get(), newer.release());
+}
+
+void Transaction::setOptimizationProfile(MaximFrontend::OptimizationProfile profile) {
+    MaximFrontend::maxim_transaction_set_optimization_profile(get(), (uint8_t) profile);
+}
+
 void Transaction::printToStdout() const {
     MaximFrontend::maxim_print_transaction_to_stdout(get());
 }
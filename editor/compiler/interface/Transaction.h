@@ -3,6 +3,7 @@
 #include <string>
 
 #include "Block.h"
+#include "Frontend.h"
 #include "OwnedObject.h"
 #include "RootRef.h"
 #include "SurfaceRef.h"
@@ -19,6 +20,11 @@ namespace MaximCompiler {
 
         void buildBlock(Block block);
 
+        void merge(Transaction newer);
+
+        // Rebuilds everything with the profile when the transaction is committed, if it's not already in use.
+        void setOptimizationProfile(MaximFrontend::OptimizationProfile profile);
+
         void printToStdout() const;
     };
 }
@@ -0,0 +1,115 @@
+#include "CompileWorker.h"
+
+#include "editor/compiler/interface/Runtime.h"
+
+using namespace AxiomModel;
+
+CompileWorker::CompileWorker(MaximCompiler::Runtime *runtime)
+    : _runtime(runtime), _optimizeTime(std::chrono::steady_clock::now() + OPTIMIZE_DELAY),
+      _thread(&CompileWorker::run, this) {}
+
+CompileWorker::~CompileWorker() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _condition.notify_one();
+    _thread.join();
+}
+
+std::shared_ptr<CompileWorker::CommitPromise> CompileWorker::commit(MaximCompiler::Transaction transaction) {
+    auto promise = std::make_shared<CommitPromise>();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_pendingTransaction) {
+            _pendingTransaction->merge(std::move(transaction));
+        } else {
+            _pendingTransaction = std::move(transaction);
+        }
+        _pendingPromises.push_back(promise);
+    }
+    _condition.notify_one();
+    return promise;
+}
+
+void CompileWorker::run() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto hasWork = [this]() { return _isStopping || (_pendingTransaction && !_isHandlingResult); };
+        if (_optimizeTime && !_isHandlingResult) {
+            _condition.wait_until(lock, *_optimizeTime, hasWork);
+        } else {
+            _condition.wait(lock, [this, &hasWork]() { return hasWork() || (_optimizeTime && !_isHandlingResult); });
+        }
+        if (_isStopping) return;
+
+        if (!_pendingTransaction) {
+            if (!_optimizeTime || _isHandlingResult || std::chrono::steady_clock::now() < *_optimizeTime) continue;
+
+            // nothing's been edited for a while, so code built without optimization can be replaced
+            _optimizeTime.reset();
+            _isHandlingResult = true;
+            lock.unlock();
+
+            if (_runtime->optimizePending()) {
+                QMetaObject::invokeMethod(&_receiver, [this]() { finishOptimize(); }, Qt::QueuedConnection);
+            } else {
+                lock.lock();
+                _isHandlingResult = false;
+            }
+            continue;
+        }
+
+        auto transaction = std::move(*_pendingTransaction);
+        _pendingTransaction.reset();
+        auto promises = std::move(_pendingPromises);
+        _pendingPromises.clear();
+        _isHandlingResult = true;
+        _optimizeTime = std::chrono::steady_clock::now() + OPTIMIZE_DELAY;
+        lock.unlock();
+
+        _runtime->commit(std::move(transaction));
+
+        // if the receiver has been destroyed by the time this is handled, Qt drops the call
+        QMetaObject::invokeMethod(&_receiver, [this, promises]() { finishCommit(promises); }, Qt::QueuedConnection);
+    }
+}
+
+void CompileWorker::finishCommit(const std::vector<std::shared_ptr<CommitPromise>> &promises) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // If more transactions were queued while we were compiling, the model has already moved past this commit, so its
+    // pointers wouldn't match. Leave the old code running and resolve these promises once the newer commit is done.
+    if (_pendingTransaction) {
+        _pendingPromises.insert(_pendingPromises.begin(), promises.begin(), promises.end());
+        _isHandlingResult = false;
+        lock.unlock();
+        _condition.notify_one();
+        return;
+    }
+    lock.unlock();
+
+    for (const auto &promise : promises) {
+        promise->resolve(_runtime);
+    }
+
+    lock.lock();
+    _isHandlingResult = false;
+    lock.unlock();
+    _condition.notify_one();
+}
+
+void CompileWorker::finishOptimize() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // as with commits, the optimized code is left unpublished if there are newer transactions to build on top of it
+    if (!_pendingTransaction) {
+        lock.unlock();
+        optimized();
+        lock.lock();
+    }
+
+    _isHandlingResult = false;
+    lock.unlock();
+    _condition.notify_one();
+}
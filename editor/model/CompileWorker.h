@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "common/Event.h"
+#include "common/Promise.h"
+#include "editor/compiler/interface/Transaction.h"
+
+namespace MaximCompiler {
+    class Runtime;
+}
+
+namespace AxiomModel {
+
+    // Commits transactions to a runtime on a background thread, so codegen and optimization don't block the UI.
+    // Transactions queued while a commit is running are merged and committed together. Each commit's promise is
+    // resolved on the UI thread once the runtime holds the new code, unless newer transactions were queued in the
+    // meantime, in which case it's resolved along with them.
+    //
+    // Once no transactions have been queued for a while, anything the runtime built unoptimized (with tiered
+    // compilation) is rebuilt with full optimization, and `optimized` is emitted on the UI thread when it's ready.
+    class CompileWorker {
+    public:
+        using CommitPromise = AxiomCommon::Promise<MaximCompiler::Runtime *>;
+
+        static constexpr std::chrono::milliseconds OPTIMIZE_DELAY = std::chrono::milliseconds(500);
+
+        AxiomCommon::Event<> optimized;
+
+        explicit CompileWorker(MaximCompiler::Runtime *runtime);
+
+        ~CompileWorker();
+
+        std::shared_ptr<CommitPromise> commit(MaximCompiler::Transaction transaction);
+
+    private:
+        MaximCompiler::Runtime *_runtime;
+
+        // lives on the UI thread, so results can be posted to it
+        QObject _receiver;
+
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::optional<MaximCompiler::Transaction> _pendingTransaction;
+        std::vector<std::shared_ptr<CommitPromise>> _pendingPromises;
+
+        // the runtime can't be touched by the worker while the UI thread is handling a result
+        bool _isHandlingResult = false;
+        std::optional<std::chrono::steady_clock::time_point> _optimizeTime;
+        bool _isStopping = false;
+
+        std::thread _thread;
+
+        void run();
+
+        void finishCommit(const std::vector<std::shared_ptr<CommitPromise>> &promises);
+
+        void finishOptimize();
+    };
+}
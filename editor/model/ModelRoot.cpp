@@ -1,6 +1,8 @@
 #include "ModelRoot.h"
 
+#include <cassert>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 
 #include "../backend/AudioBackend.h"
@@ -33,12 +35,22 @@ RootSurface *ModelRoot::rootSurface() {
     return rootSurface;
 }
 
-void ModelRoot::attachRuntime(MaximCompiler::Runtime *runtime) {
+void ModelRoot::attachRuntime(MaximCompiler::Runtime *runtime,
+                              std::optional<MaximFrontend::OptimizationProfile> profile) {
     _runtime = runtime;
 
     MaximCompiler::Transaction buildTransaction;
+    if (profile) {
+        buildTransaction.setOptimizationProfile(*profile);
+    }
     rootSurface()->attachRuntime(_runtime, &buildTransaction);
-    applyTransaction(std::move(buildTransaction));
+
+    // The initial build is committed synchronously, so the project is live as soon as it's loaded even if nothing is
+    // processing UI events (e.g. a plugin host loading a project with the editor closed).
+    _runtime->commit(std::move(buildTransaction));
+    finishTransaction();
+    _compileWorker = std::make_unique<CompileWorker>(_runtime);
+    _compileWorker->optimized.connect(this, &ModelRoot::finishTransaction);
 
     // clear the dirty state of everything, since we've just compiled them
     auto poolSequence = pool().sequence().sequence();
@@ -53,6 +65,66 @@ std::lock_guard<std::mutex> ModelRoot::lockRuntime() {
     return std::lock_guard(_runtimeLock);
 }
 
+void ModelRoot::queueRuntimeWrite(void *dest, const void *src, size_t size) {
+    assert(size <= MAX_RUNTIME_WRITE_SIZE);
+
+    RuntimeWrite write;
+    write.dest = dest;
+    write.size = size;
+    memcpy(write.data, src, size);
+
+    // if the queue is full the audio thread isn't keeping up (or isn't running), so apply the writes ourselves
+    while (!_runtimeWrites.push(write)) {
+        auto lock = lockRuntime();
+        applyRuntimeWrites();
+    }
+    _queuedWriteCount++;
+}
+
+bool ModelRoot::hasPendingRuntimeWrites() const {
+    return _snapshots[_frontSnapshot].appliedWriteCount < _queuedWriteCount;
+}
+
+void ModelRoot::applyRuntimeWrites() {
+    while (auto write = _runtimeWrites.pop()) {
+        memcpy(write->dest, write->data, write->size);
+        _appliedWriteCount.fetch_add(1, std::memory_order_release);
+    }
+}
+
+RuntimeValueHandle ModelRoot::watchRuntimeValue(const void *src, size_t size) {
+    // keep values 8-byte aligned so they can be read in place
+    auto offset = _pendingSnapshotSize;
+    _pendingSnapshotSize += (size + 7) & ~(size_t) 7;
+    _pendingWatchedValues.push_back({src, size, offset});
+
+    return {_snapshotLayout + 1, offset};
+}
+
+void ModelRoot::updateRuntimeSnapshot() {
+    if (_middleSnapshot.load(std::memory_order_relaxed) & SNAPSHOT_FRESH_FLAG) {
+        _frontSnapshot = _middleSnapshot.exchange(_frontSnapshot, std::memory_order_acq_rel) & SNAPSHOT_INDEX_MASK;
+    }
+}
+
+const void *ModelRoot::readRuntimeValue(RuntimeValueHandle handle) const {
+    const auto &snapshot = _snapshots[_frontSnapshot];
+    if (handle.layout != _snapshotLayout || !snapshot.isValid) return nullptr;
+    return snapshot.data.data() + handle.offset;
+}
+
+void ModelRoot::captureRuntimeSnapshot() {
+    auto &snapshot = _snapshots[_backSnapshot];
+    for (const auto &value : _watchedValues) {
+        memcpy(snapshot.data.data() + value.offset, value.src, value.size);
+    }
+    snapshot.appliedWriteCount = _appliedWriteCount.load(std::memory_order_relaxed);
+    snapshot.isValid = true;
+
+    _backSnapshot =
+        _middleSnapshot.exchange(_backSnapshot | SNAPSHOT_FRESH_FLAG, std::memory_order_acq_rel) & SNAPSHOT_INDEX_MASK;
+}
+
 void ModelRoot::setHistory(AxiomModel::HistoryList history) {
     _history = std::move(history);
     _history.stackChanged.connect(this, &ModelRoot::compileDirtyItems);
@@ -87,23 +159,57 @@ void ModelRoot::compileDirtyItems() {
     modified();
 }
 
-void ModelRoot::applyTransaction(MaximCompiler::Transaction transaction) {
-    auto lock = lockRuntime();
+std::shared_ptr<CompileWorker::CommitPromise> ModelRoot::applyTransaction(MaximCompiler::Transaction transaction) {
+    if (!_compileWorker) {
+        configurationChanged();
 
-    if (_runtime) {
-        auto allObjects = AxiomCommon::dynamicCast<ModelObject *>(_pool.sequence().sequence());
-        for (const auto &obj : allObjects) {
-            obj->saveState();
-        }
+        auto promise = std::make_shared<CompileWorker::CommitPromise>();
+        promise->resolve(_runtime);
+        return promise;
+    }
+
+    auto promise = _compileWorker->commit(std::move(transaction));
+    promise->then(this, [this](MaximCompiler::Runtime *) { finishTransaction(); });
+    return promise;
+}
 
-        _runtime->commit(std::move(transaction));
-        rootSurface()->updateRuntimePointers(_runtime, _runtime->getRootPtr());
+void ModelRoot::finishTransaction() {
+    // The new code was built and gets its state restored while the audio thread keeps running the old code, so we only
+    // need the lock to switch over and update the backend's portal pointers.
+    // Any writes still queued for the old code are applied first so the state we save is up to date, and writes
+    // restoring the new state are applied before switching over. Nothing can be left in the queue afterwards, since
+    // the old code's memory is freed once it's no longer running.
+    {
+        auto lock = lockRuntime();
+        applyRuntimeWrites();
+    }
 
-        for (const auto &obj : allObjects) {
-            obj->restoreState();
-        }
+    auto allObjects = AxiomCommon::dynamicCast<ModelObject *>(_pool.sequence().sequence());
+    for (const auto &obj : allObjects) {
+        obj->saveState();
+    }
+
+    // objects watch the values they read back while their pointers are updated
+    _pendingWatchedValues.clear();
+    _pendingSnapshotSize = 0;
+    rootSurface()->updateRuntimePointers(_runtime, _runtime->getRootPtr());
+
+    for (const auto &obj : allObjects) {
+        obj->restoreState();
+    }
+
+    auto lock = lockRuntime();
+    applyRuntimeWrites();
+
+    // existing snapshots have the old layout, so they're thrown away
+    _watchedValues.swap(_pendingWatchedValues);
+    _snapshotLayout++;
+    for (auto &snapshot : _snapshots) {
+        snapshot.data.resize(_pendingSnapshotSize);
+        snapshot.isValid = false;
     }
 
+    _runtime->publish();
     configurationChanged();
 }
 
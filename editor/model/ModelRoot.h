@@ -1,10 +1,16 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <vector>
 
+#include "CompileWorker.h"
 #include "HistoryList.h"
 #include "Pool.h"
+#include "common/MpscQueue.h"
 #include "common/WatchSequence.h"
 #include "editor/compiler/interface/Transaction.h"
 
@@ -32,6 +38,15 @@ namespace AxiomModel {
 
     class RootSurface;
 
+    // Refers to a value registered with `ModelRoot::watchRuntimeValue`. Handles are invalidated when runtime pointers
+    // are next updated, at which point the value must be watched again.
+    struct RuntimeValueHandle {
+        uint64_t layout = 0;
+        size_t offset = 0;
+
+        explicit operator bool() const { return layout != 0; }
+    };
+
     class ModelRoot : public AxiomCommon::TrackedObject {
     public:
         template<class CollectionType>
@@ -43,6 +58,8 @@ namespace AxiomModel {
         using ControlCollection = AxiomCommon::RefWatchSequence<ModelRootCollection<Control *>>;
         using ConnectionCollection = AxiomCommon::RefWatchSequence<ModelRootCollection<Connection *>>;
 
+        static constexpr size_t MAX_RUNTIME_WRITE_SIZE = 256;
+
         AxiomCommon::Event<> modified;
         AxiomCommon::Event<> configurationChanged;
 
@@ -68,23 +85,74 @@ namespace AxiomModel {
 
         ConnectionCollection connections() { return AxiomCommon::refWatchSequence(&_connections); }
 
-        void attachRuntime(MaximCompiler::Runtime *runtime);
+        // Builds everything on the runtime. If a profile is provided, the initial build switches the runtime to it.
+        void attachRuntime(MaximCompiler::Runtime *runtime,
+                           std::optional<MaximFrontend::OptimizationProfile> profile = std::nullopt);
 
         MaximCompiler::Runtime *runtime() const { return _runtime; }
 
         std::lock_guard<std::mutex> lockRuntime();
 
+        // Queues a write to runtime memory (such as a control's value) from the UI thread. Writes are applied in order
+        // by the audio thread at the start of the next block, so it never sees a value that's half written.
+        void queueRuntimeWrite(void *dest, const void *src, size_t size);
+
+        // Returns true if there are queued writes that aren't reflected in the current runtime snapshot yet, in which
+        // case values read back from it may be stale.
+        bool hasPendingRuntimeWrites() const;
+
+        // Applies all queued runtime writes. The runtime must be locked.
+        void applyRuntimeWrites();
+
+        // Registers a value in runtime memory that the UI wants to read (such as a control's value). Watched values are
+        // copied into a snapshot by the audio thread between blocks, so the UI never reads memory the audio thread is
+        // writing to. Should only be called while runtime pointers are being updated.
+        RuntimeValueHandle watchRuntimeValue(const void *src, size_t size);
+
+        // Switches to the latest snapshot taken by the audio thread, if there's a newer one. Values read afterwards are
+        // all from the same point in time.
+        void updateRuntimeSnapshot();
+
+        // Returns a pointer to the value in the current snapshot, or null if the value isn't in it.
+        const void *readRuntimeValue(RuntimeValueHandle handle) const;
+
+        // Copies all watched values into a new snapshot. Called by the audio thread with the runtime locked.
+        void captureRuntimeSnapshot();
+
         void setHistory(HistoryList history);
 
         void applyDirtyItemsTo(MaximCompiler::Transaction *transaction);
 
         void compileDirtyItems();
 
-        void applyTransaction(MaximCompiler::Transaction transaction);
+        // Queues the transaction to be compiled in the background. The returned promise is resolved once the new code
+        // is live.
+        std::shared_ptr<CompileWorker::CommitPromise> applyTransaction(MaximCompiler::Transaction transaction);
 
         void destroy();
 
     private:
+        struct RuntimeWrite {
+            void *dest;
+            size_t size;
+            alignas(8) uint8_t data[MAX_RUNTIME_WRITE_SIZE];
+        };
+
+        struct WatchedValue {
+            const void *src;
+            size_t size;
+            size_t offset;
+        };
+
+        struct RuntimeSnapshot {
+            std::vector<uint8_t> data;
+            uint64_t appliedWriteCount = 0;
+            bool isValid = false;
+        };
+
+        static constexpr uint8_t SNAPSHOT_INDEX_MASK = 0b11;
+        static constexpr uint8_t SNAPSHOT_FRESH_FLAG = 0b100;
+
         Pool _pool;
         HistoryList _history;
         ModelRootCollection<NodeSurface *> _nodeSurfaces;
@@ -95,5 +163,23 @@ namespace AxiomModel {
 
         std::mutex _runtimeLock;
         MaximCompiler::Runtime *_runtime = nullptr;
+        std::unique_ptr<CompileWorker> _compileWorker;
+
+        AxiomCommon::MpscQueue<RuntimeWrite, 256> _runtimeWrites;
+        uint64_t _queuedWriteCount = 0;
+        std::atomic<uint64_t> _appliedWriteCount = 0;
+
+        // Snapshots are triple-buffered: the audio thread fills the back snapshot and swaps it with the middle one, and
+        // the UI swaps the middle one with the front snapshot when it's fresh, so neither side ever waits on the other.
+        std::vector<WatchedValue> _watchedValues;
+        std::vector<WatchedValue> _pendingWatchedValues;
+        size_t _pendingSnapshotSize = 0;
+        uint64_t _snapshotLayout = 1;
+        std::array<RuntimeSnapshot, 3> _snapshots;
+        uint8_t _backSnapshot = 0;
+        std::atomic<uint8_t> _middleSnapshot = 1;
+        uint8_t _frontSnapshot = 2;
+
+        void finishTransaction();
     };
 }
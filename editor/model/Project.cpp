@@ -78,8 +78,10 @@ Project::Project(const AxiomBackend::DefaultConfiguration &defaultConfiguration)
     }
 }
 
-Project::Project(QString linkedFile, std::unique_ptr<AxiomModel::ModelRoot> mainRoot)
-    : _mainRoot(std::move(mainRoot)), _linkedFile(std::move(linkedFile)), _rootSurface(_mainRoot->rootSurface()) {
+Project::Project(QString linkedFile, std::unique_ptr<AxiomModel::ModelRoot> mainRoot,
+                 MaximFrontend::OptimizationProfile optimizationProfile)
+    : _mainRoot(std::move(mainRoot)), _linkedFile(std::move(linkedFile)), _optimizationProfile(optimizationProfile),
+      _rootSurface(_mainRoot->rootSurface()) {
     addRootListeners();
 }
 
@@ -101,6 +103,15 @@ void Project::setIsDirty(bool isDirty) {
     }
 }
 
+void Project::setOptimizationProfile(MaximFrontend::OptimizationProfile profile) {
+    if (profile != _optimizationProfile) {
+        _optimizationProfile = profile;
+
+        // the profile is saved with the project, so this counts as a change
+        rootModified();
+    }
+}
+
 void Project::addRootListeners() {
     _mainRoot->modified.connect(this, &Project::rootModified);
     _mainRoot->configurationChanged.connect(this, &Project::rootConfigurationChanged);
@@ -5,6 +5,7 @@
 #include <optional>
 
 #include "common/Event.h"
+#include "editor/compiler/interface/Frontend.h"
 
 namespace AxiomBackend {
     class DefaultConfiguration;
@@ -23,7 +24,8 @@ namespace AxiomModel {
 
         explicit Project(const AxiomBackend::DefaultConfiguration &defaultConfiguration);
 
-        Project(QString linkedFile, std::unique_ptr<ModelRoot> mainRoot);
+        Project(QString linkedFile, std::unique_ptr<ModelRoot> mainRoot,
+                MaximFrontend::OptimizationProfile optimizationProfile);
 
         ~Project() override;
 
@@ -43,10 +45,17 @@ namespace AxiomModel {
 
         AxiomBackend::AudioBackend *backend() const { return _backend; }
 
+        // The profile the project's code is optimized with. It's saved with the project, but it's up to whoever
+        // attaches a runtime to build with it.
+        MaximFrontend::OptimizationProfile optimizationProfile() const { return _optimizationProfile; }
+
+        void setOptimizationProfile(MaximFrontend::OptimizationProfile profile);
+
     private:
         std::unique_ptr<ModelRoot> _mainRoot;
         QString _linkedFile;
         bool _isDirty = false;
+        MaximFrontend::OptimizationProfile _optimizationProfile = MaximFrontend::OptimizationProfile::SPEED;
 
         AxiomBackend::AudioBackend *_backend = nullptr;
         RootSurface *_rootSurface;
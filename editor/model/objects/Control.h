@@ -120,9 +120,13 @@ namespace AxiomModel {
         void setRuntimePointers(std::optional<MaximFrontend::ControlPointers> runtimePointers) {
             _runtimePointers = std::move(runtimePointers);
 
+            watchRuntimeValues();
             restoreState();
         }
 
+        // Called when the control's runtime pointers change, to watch any runtime values the control reads back.
+        virtual void watchRuntimeValues() {}
+
     private:
         ControlSurface *_surface;
         ControlType _controlType;
@@ -44,8 +44,15 @@ void ExtractControl::setActiveSlots(AxiomModel::ExtractControl::ActiveSlotFlags
     }
 }
 
+void ExtractControl::watchRuntimeValues() {
+    // only the flags are read back, so the items don't need to be copied
+    _valueHandle = runtimePointers()
+                       ? root()->watchRuntimeValue(&((ArrayValue *) runtimePointers()->value)->flags, sizeof(uint32_t))
+                       : RuntimeValueHandle();
+}
+
 void ExtractControl::doRuntimeUpdate() {
-    if (!runtimePointers()) return;
-    auto arr = (ArrayValue *) runtimePointers()->value;
-    setActiveSlots(arr->flags);
+    if (auto flags = (const uint32_t *) root()->readRuntimeValue(_valueHandle)) {
+        setActiveSlots(*flags);
+    }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../ModelRoot.h"
 #include "Control.h"
 #include "common/Event.h"
 
@@ -27,9 +28,12 @@ namespace AxiomModel {
 
         void setActiveSlots(ActiveSlotFlags activeSlots);
 
+        void watchRuntimeValues() override;
+
         void doRuntimeUpdate() override;
 
     private:
         ActiveSlotFlags _activeSlots;
+        RuntimeValueHandle _valueHandle;
     };
 }
@@ -1,13 +1,28 @@
 #include "GraphControl.h"
 
+#include "../ModelRoot.h"
+#include "../PoolOperators.h"
+
 using namespace AxiomModel;
 
+static_assert(sizeof(GraphControlCurveState) <= ModelRoot::MAX_RUNTIME_WRITE_SIZE,
+              "Graph control state must fit in a runtime write");
+
 GraphControl::GraphControl(const QUuid &uuid, const QUuid &parentUuid, QPoint pos, QSize size, bool selected,
                            QString name, bool showName, const QUuid &exposerUuid, const QUuid &exposingUuid,
                            std::unique_ptr<GraphControlCurveState> savedState, AxiomModel::ModelRoot *root)
     : Control(ControlType::GRAPH, ConnectionWire::WireType::NUM, QSize(4, 4), uuid, parentUuid, pos, size, selected,
               std::move(name), showName, exposerUuid, exposingUuid, root),
-      _savedState(std::move(savedState)) {}
+      _curveState(std::move(savedState)) {
+    // exposed controls share the curve state of the control they expose, which is looked up once here instead of
+    // every time the state is accessed
+    if (!exposingUuid.isNull()) {
+        findLater(root->controls(), exposingUuid)->then([this](Control *exposing) {
+            _exposingControl = static_cast<GraphControl *>(exposing);
+            exposing->removed.connect(this, [this]() { _exposingControl = nullptr; });
+        });
+    }
+}
 
 std::unique_ptr<GraphControl> GraphControl::create(const QUuid &uuid, const QUuid &parentUuid, QPoint pos, QSize size,
                                                    bool selected, QString name, bool showName, const QUuid &exposerUuid,
@@ -22,9 +37,17 @@ QString GraphControl::debugName() {
     return "GraphControl ' " + name() + "'";
 }
 
+void GraphControl::watchRuntimeValues() {
+    _timeStateHandle = runtimePointers()
+                           ? root()->watchRuntimeValue(runtimePointers()->data, sizeof(GraphControlTimeState))
+                           : RuntimeValueHandle();
+}
+
 void GraphControl::doRuntimeUpdate() {
     // hash the current state so we can compare it
     auto currentState = getCurveState();
+    if (!currentState) return;
+
     size_t newStateHash = 17;
     newStateHash = newStateHash * 31 + std::hash<uint8_t>()(currentState->curveCount);
     newStateHash = newStateHash * 31 + std::hash<float>()(currentState->curveStartVals[0]);
@@ -52,19 +75,15 @@ void GraphControl::doRuntimeUpdate() {
     }
 }
 
-GraphControlTimeState *GraphControl::getTimeState() const {
-    if (runtimePointers()) {
-        return (GraphControlTimeState *) runtimePointers()->data;
-    } else {
-        return nullptr;
-    }
+const GraphControlTimeState *GraphControl::getTimeState() const {
+    return (const GraphControlTimeState *) root()->readRuntimeValue(_timeStateHandle);
 }
 
 GraphControlCurveState *GraphControl::getCurveState() const {
-    if (runtimePointers()) {
-        return (GraphControlCurveState *) runtimePointers()->shared;
+    if (exposingUuid().isNull()) {
+        return _curveState.get();
     } else {
-        return _savedState.get();
+        return _exposingControl ? _exposingControl->getCurveState() : nullptr;
     }
 }
 
@@ -123,6 +142,7 @@ void GraphControl::insertPoint(uint8_t index, float time, float val, float tensi
     controlState->curveTension[index] = tension;
     controlState->curveStates[index + 1] = curveState;
     controlState->curveCount++;
+    writeCurveState();
 }
 
 void GraphControl::movePoint(uint8_t index, float time, float value) {
@@ -131,14 +151,17 @@ void GraphControl::movePoint(uint8_t index, float time, float value) {
     if (index > 0) {
         controlState->curveEndPositions[index - 1] = time;
     }
+    writeCurveState();
 }
 
 void GraphControl::setPointTag(uint8_t index, uint8_t tag) {
     getCurveState()->curveStates[index] = tag;
+    writeCurveState();
 }
 
 void GraphControl::setCurveTension(uint8_t index, float tension) {
     getCurveState()->curveTension[index] = tension;
+    writeCurveState();
 }
 
 void GraphControl::removePoint(uint8_t index) {
@@ -158,20 +181,24 @@ void GraphControl::removePoint(uint8_t index) {
     memmove(&controlState->curveStates[index], &controlState->curveStates[index + 1],
             sizeof(controlState->curveStates[0]) * moveItems);
     controlState->curveCount--;
+    writeCurveState();
 }
 
-void GraphControl::saveState() {
-    if (runtimePointers()) {
-        auto controlState = (GraphControlCurveState *) runtimePointers()->shared;
-        _savedState = std::make_unique<GraphControlCurveState>();
-        memcpy(_savedState.get(), controlState, sizeof(*controlState));
+void GraphControl::restoreState() {
+    if (!runtimePointers()) return;
+
+    // if we weren't given a state, start with what the runtime was constructed with
+    if (exposingUuid().isNull() && !_curveState) {
+        _curveState = std::make_unique<GraphControlCurveState>();
+        memcpy(_curveState.get(), runtimePointers()->shared, sizeof(*_curveState));
     }
+
+    writeCurveState();
 }
 
-void GraphControl::restoreState() {
-    if (_savedState && runtimePointers()) {
-        auto controlState = (GraphControlCurveState *) runtimePointers()->shared;
-        memcpy(controlState, _savedState.get(), sizeof(*controlState));
-        _savedState.reset();
+void GraphControl::writeCurveState() {
+    auto curveState = getCurveState();
+    if (runtimePointers() && curveState) {
+        root()->queueRuntimeWrite(runtimePointers()->shared, curveState, sizeof(*curveState));
     }
 }
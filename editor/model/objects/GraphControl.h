@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../ModelRoot.h"
 #include "Control.h"
 
 namespace AxiomModel {
@@ -38,9 +39,11 @@ namespace AxiomModel {
 
         QString debugName() override;
 
+        void watchRuntimeValues() override;
+
         void doRuntimeUpdate() override;
 
-        GraphControlTimeState *getTimeState() const;
+        const GraphControlTimeState *getTimeState() const;
 
         GraphControlCurveState *getCurveState() const;
 
@@ -64,8 +67,6 @@ namespace AxiomModel {
 
         void removePoint(uint8_t index);
 
-        void saveState() override;
-
         void restoreState() override;
 
     private:
@@ -73,7 +74,15 @@ namespace AxiomModel {
         float _scroll = 0;
         size_t _lastStateHash = 0;
         uint32_t _lastTime = 0;
+        RuntimeValueHandle _timeStateHandle;
+
+        // The UI's copy of the curve state, which is written to the runtime whenever it changes. The runtime never
+        // modifies the curve state, so this is always up to date.
+        std::unique_ptr<GraphControlCurveState> _curveState;
+
+        // The control this one exposes, if it's been added to the model.
+        GraphControl *_exposingControl = nullptr;
 
-        std::unique_ptr<GraphControlCurveState> _savedState;
+        void writeCurveState();
     };
 }
@@ -13,6 +13,8 @@
 #include "PortalNode.h"
 #include "editor/compiler/interface/Runtime.h"
 
+#include <bitset>
+
 using namespace AxiomModel;
 
 Node::Node(NodeType nodeType, const QUuid &uuid, const QUuid &parentUuid, QPoint pos, QSize size, bool selected,
@@ -142,15 +144,25 @@ void Node::doSizeAction() {
 void Node::updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr) {
     if (compileMeta()) {
         setExtracted(runtime->isNodeExtracted(surface()->getRuntimeId(), compileMeta()->mirIndex));
-        _activeBitmap = runtime->getExtractedBitmaskPtr(surface()->getRuntimeId(), surfacePtr, compileMeta()->mirIndex);
+        auto activeBitmap =
+            runtime->getExtractedBitmaskPtr(surface()->getRuntimeId(), surfacePtr, compileMeta()->mirIndex);
+        _activeBitmapHandle =
+            activeBitmap ? root()->watchRuntimeValue(activeBitmap, sizeof(uint32_t)) : RuntimeValueHandle();
     }
 }
 
 void Node::doRuntimeUpdate() {
-    if (_activeBitmap) {
-        setActive(static_cast<bool>(*_activeBitmap & 1));
-    } else
+    if (!_activeBitmapHandle) {
         setActive(true);
+    } else if (auto activeBitmap = (const uint32_t *) root()->readRuntimeValue(_activeBitmapHandle)) {
+        setActive(static_cast<bool>(*activeBitmap & 1));
+    }
+}
+
+uint32_t Node::activeVoiceCount() const {
+    if (!_activeBitmapHandle) return 0;
+    auto activeBitmap = (const uint32_t *) root()->readRuntimeValue(_activeBitmapHandle);
+    return activeBitmap ? (uint32_t) std::bitset<32>(*activeBitmap).count() : 0;
 }
 
 void Node::remove() {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../ModelObject.h"
+#include "../ModelRoot.h"
 #include "../grid/GridItem.h"
 #include "common/Event.h"
 #include "common/Promise.h"
@@ -55,6 +56,9 @@ namespace AxiomModel {
 
         void setActive(bool active);
 
+        // The number of voices of an extracted node that were active in the last runtime snapshot.
+        uint32_t activeVoiceCount() const;
+
         void setInErrorState(bool inErrorState);
 
         bool isInErrorState() const { return _isInErrorState; }
@@ -93,7 +97,7 @@ namespace AxiomModel {
         std::shared_ptr<AxiomCommon::Promise<ControlSurface *>> _controls;
         QRect sizeStartRect;
         std::optional<NodeCompileMeta> _compileMeta;
-        uint32_t *_activeBitmap = nullptr;
+        RuntimeValueHandle _activeBitmapHandle;
         bool _isActive = true;
         bool _isInErrorState = false;
     };
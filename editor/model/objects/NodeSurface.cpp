@@ -97,6 +97,9 @@ void NodeSurface::doRuntimeUpdate() {
     _grid.tryFlush();
     _wireGrid.tryFlush();
 
+    // read every value from the same snapshot
+    root()->updateRuntimeSnapshot();
+
     for (const auto &node : nodes().sequence()) {
         if (auto controls = node->controls().value()) {
             for (const auto &control : (*controls)->controls().sequence()) {
@@ -69,16 +69,26 @@ void NumControl::setValue(NumValue value) {
     restoreState();
 }
 
+void NumControl::watchRuntimeValues() {
+    _valueHandle = runtimePointers() ? root()->watchRuntimeValue(runtimePointers()->value, sizeof(NumValue))
+                                     : RuntimeValueHandle();
+}
+
 void NumControl::doRuntimeUpdate() {
     saveState();
 }
 
 void NumControl::saveState() {
-    if (runtimePointers()) setInternalValue(*(NumValue *) runtimePointers()->value);
+    // if we've got a value the runtime hasn't seen yet, ours is newer
+    if (root()->hasPendingRuntimeWrites()) return;
+
+    if (auto value = (const NumValue *) root()->readRuntimeValue(_valueHandle)) {
+        setInternalValue(*value);
+    }
 }
 
 void NumControl::restoreState() {
-    if (runtimePointers()) *(NumValue *) runtimePointers()->value = _value;
+    if (runtimePointers()) root()->queueRuntimeWrite(runtimePointers()->value, &_value, sizeof(_value));
 }
 
 void NumControl::setInternalValue(NumValue value) {
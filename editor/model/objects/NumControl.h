@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../ModelRoot.h"
 #include "../Value.h"
 #include "Control.h"
 #include "common/Event.h"
@@ -39,6 +40,8 @@ namespace AxiomModel {
 
         const NumValue &value() const { return _value; }
 
+        void watchRuntimeValues() override;
+
         void doRuntimeUpdate() override;
 
         void saveState() override;
@@ -53,6 +56,7 @@ namespace AxiomModel {
         float _maxValue;
         uint32_t _step;
         NumValue _value;
+        RuntimeValueHandle _valueHandle;
 
         void setInternalValue(NumValue value);
     };
@@ -29,6 +29,7 @@ void ProjectSerializer::serialize(AxiomModel::Project *project, QDataStream &str
     writeHeader(stream, projectSchemaMagic);
     writeLinkedFile(stream);
     ModelObjectSerializer::serializeRoot(&project->mainRoot(), true, stream);
+    stream << (uint8_t) project->optimizationProfile();
 }
 
 std::unique_ptr<Project> ProjectSerializer::deserialize(QDataStream &stream, uint32_t *versionOut,
@@ -43,7 +44,6 @@ std::unique_ptr<Project> ProjectSerializer::deserialize(QDataStream &stream, uin
 
     auto linkedFile = getLinkedFile(stream, version);
     auto modelRoot = ModelObjectSerializer::deserializeRoot(stream, true, false, version);
-    auto project = std::make_unique<Project>(linkedFile, std::move(modelRoot));
 
     // Before schema version 5, the module library was included in the project file. To ensure modules aren't lost,
     // merge the library in.
@@ -52,5 +52,17 @@ std::unique_ptr<Project> ProjectSerializer::deserialize(QDataStream &stream, uin
         importLibrary(library.get());
     }
 
-    return project;
+    // Projects from before schema version 6 don't have a profile, and keep the default.
+    auto optimizationProfile = MaximFrontend::OptimizationProfile::SPEED;
+    if (version >= 6) {
+        uint8_t profile;
+        stream >> profile;
+
+        // Unknown profiles (e.g. from a corrupted file) keep the default.
+        if (profile <= (uint8_t) MaximFrontend::OptimizationProfile::SPEED) {
+            optimizationProfile = (MaximFrontend::OptimizationProfile) profile;
+        }
+    }
+
+    return std::make_unique<Project>(linkedFile, std::move(modelRoot), optimizationProfile);
 }
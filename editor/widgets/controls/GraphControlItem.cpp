@@ -274,17 +274,18 @@ void GraphControlPointKnob::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
     if (!isDragging) return;
 
     item->setShowSnapMarks(true);
-    auto controlState = item->control->getCurveState();
 
     auto mouseDelta = event->scenePos() - dragStartMousePos;
     auto yScale = maxY - minY;
-    controlState->curveStartVals[index] = std::clamp(dragStartYVal - (float) (mouseDelta.y() / yScale), 0.f, 1.f);
+    auto newValue = std::clamp(dragStartYVal - (float) (mouseDelta.y() / yScale), 0.f, 1.f);
 
+    auto newTime = dragStartTime;
     if (index != 0) {
         auto timeDelta = mouseDelta.x() / scale;
-        controlState->curveEndPositions[index - 1] = std::clamp(
-            (float) (round((dragStartTime + timeDelta) / snapSeconds) * snapSeconds), minSeconds, maxSeconds);
+        newTime = std::clamp((float) (round((dragStartTime + timeDelta) / snapSeconds) * snapSeconds), minSeconds,
+                             maxSeconds);
     }
+    item->control->movePoint(index, newTime, newValue);
 }
 
 void GraphControlPointKnob::mouseReleaseEvent(QGraphicsSceneMouseEvent *event) {
@@ -476,7 +477,7 @@ void GraphControlTensionKnob::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
 
     auto deltaY = event->scenePos().y() - dragStartMouseY;
     auto newTension = std::clamp(dragStartTension + deltaY / movementRange, -1., 1.);
-    control->getCurveState()->curveTension[index] = (float) newTension;
+    control->setCurveTension(index, (float) newTension);
 }
 
 void GraphControlTensionKnob::mouseReleaseEvent(QGraphicsSceneMouseEvent *event) {
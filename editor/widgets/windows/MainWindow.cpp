@@ -6,14 +6,17 @@
 #include <QtCore/QStandardPaths>
 #include <QtCore/QStringBuilder>
 #include <QtCore/QTimer>
+#include <QtWidgets/QActionGroup>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QMenuBar>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QPlainTextEdit>
 #include <QtWidgets/QPushButton>
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <thread>
 
 #include "../GlobalActions.h"
 #include "../InteractiveImport.h"
@@ -35,7 +38,14 @@
 using namespace AxiomGui;
 
 MainWindow::MainWindow(AxiomBackend::AudioBackend *backend)
-    : _backend(backend), _runtime(true, true), libraryLock(globalLibraryLockPath()) {
+    : _backend(backend), _runtime(true, MaximFrontend::OptimizationProfile::SPEED, codeCachePath()),
+      libraryLock(globalLibraryLockPath()) {
+    // edits are heard as soon as they're built, and optimized once editing pauses
+    _runtime.setTieredCompilation(true);
+    _runtime.setCompileThreads(std::max(1u, std::thread::hardware_concurrency()));
+    // edits that reset part of the graph fade over instead of clicking
+    _runtime.setCrossfadeTime(0.02f);
+
     setCentralWidget(nullptr);
     setWindowTitle(tr(VER_PRODUCTNAME_STR));
     setWindowIcon(QIcon(":/application.ico"));
@@ -121,6 +131,36 @@ MainWindow::MainWindow(AxiomBackend::AudioBackend *backend)
     _viewMenu = menuBar()->addMenu(tr("&View"));
     _viewMenu->addAction(_modulePanel->toggleViewAction());
 
+    // code is optimized for speed by default, since it's being played live. The profile is saved with the project, so
+    // the checked action is updated when a project is opened.
+    auto buildMenu = menuBar()->addMenu(tr("&Build"));
+    _profileGroup = new QActionGroup(this);
+    auto addProfileAction = [this, buildMenu](const QString &name, MaximFrontend::OptimizationProfile profile) {
+        auto action = buildMenu->addAction(name);
+        action->setCheckable(true);
+        action->setChecked(profile == MaximFrontend::OptimizationProfile::SPEED);
+        action->setData((int) profile);
+        _profileGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, profile]() { setOptimizationProfile(profile); });
+    };
+    addProfileAction(tr("Optimize for &Size"), MaximFrontend::OptimizationProfile::SIZE);
+    addProfileAction(tr("Optimize for &Balance"), MaximFrontend::OptimizationProfile::BALANCED);
+    addProfileAction(tr("Optimize for S&peed"), MaximFrontend::OptimizationProfile::SPEED);
+    buildMenu->addSeparator();
+
+    // voices of extracted groups can be spread across extra threads, which are shared by every instance
+    // running in the same process
+    auto workerThreadsMenu = buildMenu->addMenu(tr("&Worker Threads"));
+    auto workerThreadsGroup = new QActionGroup(this);
+    auto maxWorkerThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    for (uint32_t count = 0; count <= maxWorkerThreads; count++) {
+        auto action = workerThreadsMenu->addAction(count == 0 ? tr("&None") : QString::number(count));
+        action->setCheckable(true);
+        action->setChecked(count == _runtime.getWorkerThreads());
+        workerThreadsGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, count]() { _runtime.setWorkerThreads(count); });
+    }
+
     auto helpMenu = menuBar()->addMenu(tr("&Help"));
     helpMenu->addAction(GlobalActions::helpAbout);
 
@@ -249,7 +289,11 @@ void MainWindow::setProject(std::unique_ptr<AxiomModel::Project> project) {
 
     // attach the backend and our runtime
     _project->attachBackend(_backend);
-    _project->mainRoot().attachRuntime(runtime());
+    _backend->internalAttachProject(_project.get(), runtime());
+    _project->mainRoot().attachRuntime(runtime(), _project->optimizationProfile());
+    for (auto action : _profileGroup->actions()) {
+        action->setChecked(action->data().toInt() == (int) _project->optimizationProfile());
+    }
 
     // find root surface and show it
     auto defaultSurface =
@@ -272,6 +316,10 @@ void MainWindow::setProject(std::unique_ptr<AxiomModel::Project> project) {
     _project->isDirtyChanged.connect([this](bool isDirty) { updateWindowTitle(_project->linkedFile(), isDirty); });
 }
 
+std::string MainWindow::codeCachePath() {
+    return QDir(QString::fromStdString(AxiomBackend::AudioBackend::getDataPath())).filePath("code-cache").toStdString();
+}
+
 QString MainWindow::globalLibraryLockPath() {
     return QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("library.lock");
 }
@@ -488,6 +536,14 @@ void MainWindow::exportProject() {
     project()->rootSurface()->restoreValue();*/
 }
 
+void MainWindow::setOptimizationProfile(MaximFrontend::OptimizationProfile profile) {
+    _project->setOptimizationProfile(profile);
+
+    MaximCompiler::Transaction transaction;
+    transaction.setOptimizationProfile(profile);
+    _project->mainRoot().applyTransaction(std::move(transaction));
+}
+
 void MainWindow::importLibrary() {
     auto selectedFile = QFileDialog::getOpenFileName(this, "Import Library", QString(),
                                                      tr("Axiom Library Files (*.axl);;All Files (*.*)"));
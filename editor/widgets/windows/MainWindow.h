@@ -11,6 +11,8 @@
 #include "editor/compiler/interface/Runtime.h"
 #include "editor/model/Project.h"
 
+class QActionGroup;
+
 namespace AxiomModel {
     class Project;
 
@@ -47,6 +49,8 @@ namespace AxiomGui {
 
         void setProject(std::unique_ptr<AxiomModel::Project> project);
 
+        static std::string codeCachePath();
+
         static QString globalLibraryLockPath();
 
         static QString globalLibraryFilePath();
@@ -85,6 +89,10 @@ namespace AxiomGui {
 
         void exportProject();
 
+        // Rebuilds the project with the profile, and stores it in the project. The new code is swapped in once it's
+        // built, like any other change.
+        void setOptimizationProfile(MaximFrontend::OptimizationProfile profile);
+
         void importLibrary();
 
         void exportLibrary();
@@ -101,6 +109,7 @@ namespace AxiomGui {
         std::unique_ptr<HistoryPanel> _historyPanel;
         std::unique_ptr<ModuleBrowserPanel> _modulePanel;
         QMenu *_viewMenu;
+        QActionGroup *_profileGroup;
         QLockFile libraryLock;
         bool isLibraryLocked = false;
         QTimer saveDebounceTimer;